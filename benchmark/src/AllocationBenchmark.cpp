@@ -0,0 +1,157 @@
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "Benchmark.h"
+#include "Model.h"
+
+static std::atomic<size_t> allocationCount(0);
+
+// Every heap allocation of the benchmark goes through these, including the ones of the standard library.
+void* operator new(size_t size) {
+	allocationCount++;
+	void* memory = std::malloc(size > 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+static const unsigned int GRID_SIDES[] = { 32, 128, 512, 1024 };
+
+static const VertexFormat FORMATS[] = { VertexFormat::FLOAT32, VertexFormat::QUANTIZED16 };
+static const char* FORMAT_NAMES[] = { "FLOAT32", "QUANTIZED16" };
+
+/**
+	Creates a scene with a single mesh: a grid of side * side vertices.
+ */
+static aiScene* createGridScene(unsigned int side) {
+
+	aiMesh* mesh = new aiMesh();
+	mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+	mesh->mNumVertices = side * side;
+	mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+	mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+	mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+	mesh->mNumUVComponents[0] = 2;
+	for (unsigned int y = 0; y < side; y++) {
+		for (unsigned int x = 0; x < side; x++) {
+			unsigned int i = y * side + x;
+			// aiVector3D has no copy assignment operator, so the components are set in place.
+			mesh->mVertices[i].Set((float)x, 0.0f, (float)y);
+			mesh->mNormals[i].Set(0.0f, 1.0f, 0.0f);
+			mesh->mTextureCoords[0][i].Set((float)x / side, (float)y / side, 0.0f);
+		}
+	}
+
+	mesh->mNumFaces = (side - 1) * (side - 1) * 2;
+	mesh->mFaces = new aiFace[mesh->mNumFaces];
+	unsigned int face = 0;
+	for (unsigned int y = 0; y + 1 < side; y++) {
+		for (unsigned int x = 0; x + 1 < side; x++) {
+			unsigned int corner = y * side + x;
+			unsigned int quad[2][3] = {
+				{ corner, corner + side, corner + 1 },
+				{ corner + 1, corner + side, corner + side + 1 }
+			};
+			for (int t = 0; t < 2; t++) {
+				aiFace& triangle = mesh->mFaces[face++];
+				triangle.mNumIndices = 3;
+				triangle.mIndices = new unsigned int[3];
+				for (int c = 0; c < 3; c++) {
+					triangle.mIndices[c] = quad[t][c];
+				}
+			}
+		}
+	}
+	mesh->mMaterialIndex = 0;
+
+	aiScene* scene = new aiScene();
+	scene->mNumMeshes = 1;
+	scene->mMeshes = new aiMesh*[1];
+	scene->mMeshes[0] = mesh;
+	scene->mNumMaterials = 1;
+	scene->mMaterials = new aiMaterial*[1];
+	scene->mMaterials[0] = new aiMaterial();
+	return scene;
+}
+
+/**
+	Converts the scene's mesh and uploads it, counting the allocations of each step.
+ */
+static void importMesh(const aiScene* scene, VertexFormat format, std::vector<Mesh>& meshes, size_t& outProcessAllocations, size_t& outUploadAllocations) {
+
+	size_t start = allocationCount.load();
+	MeshData meshData = Model::processMesh(scene->mMeshes[0], scene);
+	size_t processed = allocationCount.load();
+	meshes.emplace_back(std::move(meshData), std::vector<Texture>(), format);
+	size_t uploaded = allocationCount.load();
+
+	outProcessAllocations = processed - start;
+	outUploadAllocations = uploaded - processed;
+}
+
+int runAllocationBenchmark(const std::vector<std::string>&) {
+
+	const unsigned int sideCount = sizeof(GRID_SIDES) / sizeof(GRID_SIDES[0]);
+	const unsigned int formatCount = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+	std::vector<aiScene*> scenes;
+	for (unsigned int s = 0; s < sideCount; s++) {
+		scenes.push_back(createGridScene(GRID_SIDES[s]));
+	}
+
+	// Room for every mesh up front, so the vector of meshes doesn't count as a growing allocation.
+	std::vector<Mesh> meshes;
+	meshes.reserve(sideCount * formatCount + formatCount);
+
+	// The scratch arena grows to the largest mesh once, and is reused from then on.
+	for (unsigned int f = 0; f < formatCount; f++) {
+		size_t processAllocations;
+		size_t uploadAllocations;
+		importMesh(scenes.back(), FORMATS[f], meshes, processAllocations, uploadAllocations);
+	}
+
+	std::cout << std::left << std::setw(14) << "format" << std::setw(12) << "vertices" << std::setw(12) << "indices"
+		<< std::setw(14) << "processMesh" << std::setw(10) << "Mesh" << "\n";
+
+	bool constant = true;
+	for (unsigned int f = 0; f < formatCount; f++) {
+		size_t firstProcessAllocations = 0;
+		size_t firstUploadAllocations = 0;
+		for (unsigned int s = 0; s < sideCount; s++) {
+			size_t processAllocations;
+			size_t uploadAllocations;
+			importMesh(scenes[s], FORMATS[f], meshes, processAllocations, uploadAllocations);
+
+			const aiMesh* mesh = scenes[s]->mMeshes[0];
+			std::cout << std::left << std::setw(14) << FORMAT_NAMES[f] << std::setw(12) << mesh->mNumVertices << std::setw(12) << mesh->mNumFaces * 3
+				<< std::setw(14) << processAllocations << std::setw(10) << uploadAllocations << "\n";
+
+			if (s == 0) {
+				firstProcessAllocations = processAllocations;
+				firstUploadAllocations = uploadAllocations;
+			}
+			else if (processAllocations != firstProcessAllocations || uploadAllocations != firstUploadAllocations) {
+				constant = false;
+			}
+		}
+	}
+
+	for (aiScene* scene : scenes) {
+		delete scene;
+	}
+
+	std::cout << (constant ? "allocations don't depend on the vertex count" : "allocations grow with the vertex count") << std::endl;
+	return constant ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Benchmark.h"
+#include "OpenGLErrorHandling.h"
+
+#define MAJOR_OPENGL_VERSION 3
+#define MINOR_OPENGL_VERSION 3
+
+/**
+	A benchmark that can be run from the command line.
+ */
+struct BenchmarkEntry {
+	const char* name;
+	const char* usage;
+	int (*run)(const std::vector<std::string>& args);
+};
+
+static const BenchmarkEntry BENCHMARKS[] = {
+	{ "alloc", "alloc", runAllocationBenchmark },
+	{ "load", "load <runs> [--cold] [--optimize] [--lods <levels>] [--clusters] [--shared] [--compress] [--gpu-sync] <model>...", runLoadBenchmark },
+	{ "instancing", "instancing [instances] [frames] [model]", runInstancingBenchmark },
+	{ "bvh", "bvh [items] [queries]", runBvhBenchmark },
+	{ "compress", "compress [--runs <runs>] <image>...", runCompressionBenchmark },
+	{ "upload", "upload [textures] [size] [per frame] [model]", runUploadBenchmark },
+};
+
+/**
+	Prints the available benchmarks and their arguments.
+ */
+void printUsage();
+
+int main(int argc, char** argv) {
+
+	if (argc < 2) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::string name = argv[1];
+	std::vector<std::string> args(argv + 2, argv + argc);
+	for (const BenchmarkEntry& benchmark : BENCHMARKS) {
+		if (name == benchmark.name) {
+			try {
+				BenchmarkContext context;
+				return benchmark.run(args);
+			}
+			catch (const BenchmarkContext::ContextCreationFailure& e) {
+				std::cout << "failed to create the OpenGL context" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	printUsage();
+	return EXIT_FAILURE;
+}
+
+void printUsage() {
+	std::cout << "usage: benchmark <name> [arguments]\nbenchmarks:\n";
+	for (const BenchmarkEntry& benchmark : BENCHMARKS) {
+		std::cout << "\t" << benchmark.usage << "\n";
+	}
+	std::cout << std::flush;
+}
+
+double getPercentile(const std::vector<double>& sortedSamples, double fraction) {
+	size_t rank = (size_t)std::ceil(fraction * sortedSamples.size());
+	return sortedSamples[std::min(std::max(rank, (size_t)1), sortedSamples.size()) - 1];
+}
+
+BenchmarkContext::BenchmarkContext() {
+
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, MAJOR_OPENGL_VERSION);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, MINOR_OPENGL_VERSION);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	window = glfwCreateWindow(1, 1, "benchmark", nullptr, nullptr);
+	if (window == nullptr) {
+		glfwTerminate();
+		throw ContextCreationFailure();
+	}
+	glfwMakeContextCurrent(window);
+
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		throw ContextCreationFailure();
+	}
+}
+
+BenchmarkContext::~BenchmarkContext() {
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
+
+RenderTarget::RenderTarget(int width, int height) {
+	GLCall(glGenFramebuffers(1, &FBO));
+	GLCall(glGenRenderbuffers(1, &ColorRBO));
+	GLCall(glGenRenderbuffers(1, &DepthRBO));
+
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, ColorRBO));
+	GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height));
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, DepthRBO));
+	GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, FBO));
+	GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ColorRBO));
+	GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, DepthRBO));
+	GLCall(glViewport(0, 0, width, height));
+}
+
+RenderTarget::~RenderTarget() {
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	GLCall(glDeleteFramebuffers(1, &FBO));
+	GLCall(glDeleteRenderbuffers(1, &ColorRBO));
+	GLCall(glDeleteRenderbuffers(1, &DepthRBO));
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include <gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "SceneBvh.h"
+#include "ThreadPool.h"
+
+#define DEFLT_ITEM_COUNT	100000
+#define DEFLT_QUERY_COUNT	1000
+#define BUILD_RUNS			5
+
+// The fraction of the items moved before refitting.
+#define MOVED_FRACTION		0.01f
+// The average distance between the items of the synthetic scene.
+#define ITEM_SPACING		10.0f
+#define MIN_ITEM_SIZE		0.5f
+#define MAX_ITEM_SIZE		4.0f
+// The farthest a moved item goes.
+#define MOVE_DISTANCE		5.0f
+
+// The radius of the proximity queries and the length of the picking rays, in item spacings.
+#define QUERY_RADIUS		2.0f
+#define RAY_LENGTH			50.0f
+
+/**
+	A scene of items of random sizes spread uniformly in a cube, like the meshes of a large level.
+ */
+static std::vector<BoundingBox> createScene(unsigned int itemCount, float sceneSize, std::mt19937& random) {
+	std::uniform_real_distribution<float> position(0.0f, sceneSize);
+	std::uniform_real_distribution<float> size(MIN_ITEM_SIZE, MAX_ITEM_SIZE);
+	std::vector<BoundingBox> items(itemCount);
+	for (BoundingBox& item : items) {
+		glm::vec3 center(position(random), position(random), position(random));
+		glm::vec3 halfSize = glm::vec3(size(random), size(random), size(random)) * 0.5f;
+		item = { center - halfSize, center + halfSize };
+	}
+	return items;
+}
+
+template <typename Function>
+static double timeMilliseconds(Function function) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Function>
+static double timeMedian(unsigned int runs, Function function) {
+	std::vector<double> samples;
+	for (unsigned int i = 0; i < runs; i++) {
+		samples.push_back(timeMilliseconds(function));
+	}
+	std::sort(samples.begin(), samples.end());
+	return getPercentile(samples, 0.5);
+}
+
+static void printRow(const char* name, double bvhMilliseconds, double bruteForceMilliseconds, unsigned int queryCount) {
+	std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+		<< std::setw(14) << bvhMilliseconds * 1000.0 / queryCount << std::setw(14) << bruteForceMilliseconds * 1000.0 / queryCount
+		<< std::setprecision(1) << std::setw(10) << bruteForceMilliseconds / bvhMilliseconds << "x\n";
+}
+
+int runBvhBenchmark(const std::vector<std::string>& args) {
+
+	unsigned int itemCount = args.size() > 0 ? (unsigned int)std::max(std::atoi(args[0].c_str()), 1) : DEFLT_ITEM_COUNT;
+	unsigned int queryCount = args.size() > 1 ? (unsigned int)std::max(std::atoi(args[1].c_str()), 1) : DEFLT_QUERY_COUNT;
+
+	std::mt19937 random(12345);
+	float sceneSize = std::cbrt((float)itemCount) * ITEM_SPACING;
+	std::vector<BoundingBox> items = createScene(itemCount, sceneSize, random);
+	ThreadPool& pool = ThreadPool::getShared();
+
+	SceneBvh bvh;
+	double singleThreadBuild = timeMedian(BUILD_RUNS, [&]() { bvh.build(items, nullptr); });
+	double pooledBuild = timeMedian(BUILD_RUNS, [&]() { bvh.build(items, &pool); });
+
+	// Moving a few items and refitting their branches, against refitting or rebuilding everything.
+	std::uniform_int_distribution<unsigned int> anyItem(0, itemCount - 1);
+	std::uniform_real_distribution<float> offset(-MOVE_DISTANCE, MOVE_DISTANCE);
+	unsigned int movedCount = std::max((unsigned int)(itemCount * MOVED_FRACTION), 1u);
+	std::vector<unsigned int> moved(movedCount);
+	for (unsigned int& item : moved) {
+		item = anyItem(random);
+	}
+	size_t refittedNodes = 0;
+	double refit = timeMilliseconds([&]() {
+		for (unsigned int item : moved) {
+			glm::vec3 move(offset(random), offset(random), offset(random));
+			items[item] = { items[item].Min + move, items[item].Max + move };
+			bvh.setItemBounds(item, items[item]);
+		}
+		refittedNodes = bvh.refit();
+	});
+	double refitAll = timeMedian(BUILD_RUNS, [&]() { bvh.refitAll(); });
+	SceneBvh rebuilt;
+	double rebuild = timeMedian(BUILD_RUNS, [&]() { rebuilt.build(items, &pool); });
+
+	std::cout << itemCount << " items, " << bvh.getNodeCount() << " nodes, " << pool.getThreadCount() << " worker threads\n";
+	std::cout << std::fixed << std::setprecision(2)
+		<< "build (1 thread)   " << std::setw(10) << singleThreadBuild << " ms\n"
+		<< "build (pool)       " << std::setw(10) << pooledBuild << " ms\n"
+		<< "refit              " << std::setw(10) << refit << " ms (" << movedCount << " items moved, " << refittedNodes << " nodes refitted)\n"
+		<< "refit all          " << std::setw(10) << refitAll << " ms\n"
+		<< "rebuild            " << std::setw(10) << rebuild << " ms\n\n";
+
+	// The queries start from random points of the scene, the frustums looking in random directions.
+	std::uniform_real_distribution<float> position(0.0f, sceneSize);
+	std::normal_distribution<float> direction(0.0f, 1.0f);
+	std::vector<glm::vec3> origins(queryCount);
+	std::vector<glm::vec3> directions(queryCount);
+	std::vector<Frustum> frustums;
+	frustums.reserve(queryCount);
+	glm::mat4 projectionMat = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, RAY_LENGTH * ITEM_SPACING);
+	for (unsigned int i = 0; i < queryCount; i++) {
+		origins[i] = glm::vec3(position(random), position(random), position(random));
+		directions[i] = glm::normalize(glm::vec3(direction(random), direction(random), direction(random)));
+		frustums.emplace_back(projectionMat * glm::lookAt(origins[i], origins[i] + directions[i], glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+
+	// The brute force frustum test gets the boxes in the layout it tests 4 at a time.
+	std::vector<float> boxData(6 * (size_t)itemCount);
+	for (unsigned int i = 0; i < itemCount; i++) {
+		glm::vec3 center = (items[i].Min + items[i].Max) * 0.5f;
+		glm::vec3 extent = (items[i].Max - items[i].Min) * 0.5f;
+		for (int axis = 0; axis < 3; axis++) {
+			boxData[axis * (size_t)itemCount + i] = center[axis];
+			boxData[(3 + axis) * (size_t)itemCount + i] = extent[axis];
+		}
+	}
+	BoxBatch boxes = { &boxData[0], &boxData[itemCount], &boxData[2 * (size_t)itemCount],
+		&boxData[3 * (size_t)itemCount], &boxData[4 * (size_t)itemCount], &boxData[5 * (size_t)itemCount], itemCount };
+	std::vector<unsigned char> visible(itemCount);
+
+	size_t mismatches = 0;
+	std::vector<unsigned int> found;
+	size_t bvhVisible = 0;
+	double bvhFrustum = timeMilliseconds([&]() {
+		for (const Frustum& frustum : frustums) {
+			found.clear();
+			bvh.queryFrustum(frustum, found);
+			bvhVisible += found.size();
+		}
+	});
+	double bruteForceFrustum = timeMilliseconds([&]() {
+		for (const Frustum& frustum : frustums) {
+			frustum.cullBoxes(boxes, visible.data());
+		}
+	});
+	// Checked against the scalar test, which the hierarchy uses on its leaves, since the rounding of the batched one differs.
+	for (const Frustum& frustum : frustums) {
+		found.clear();
+		bvh.queryFrustum(frustum, found);
+		std::sort(found.begin(), found.end());
+		std::vector<unsigned int> expected;
+		for (unsigned int i = 0; i < itemCount; i++) {
+			if (frustum.intersectsBox((items[i].Min + items[i].Max) * 0.5f, (items[i].Max - items[i].Min) * 0.5f)) {
+				expected.push_back(i);
+			}
+		}
+		mismatches += found != expected;
+	}
+
+	float rayLength = RAY_LENGTH * ITEM_SPACING;
+	std::vector<BvhRayHit> bvhHits(queryCount);
+	std::vector<unsigned char> bvhHitFlags(queryCount);
+	double bvhRays = timeMilliseconds([&]() {
+		for (unsigned int i = 0; i < queryCount; i++) {
+			bvhHitFlags[i] = bvh.raycast(origins[i], directions[i], rayLength, bvhHits[i]);
+		}
+	});
+	std::vector<float> bruteForceHits(queryCount);
+	double bruteForceRays = timeMilliseconds([&]() {
+		for (unsigned int i = 0; i < queryCount; i++) {
+			glm::vec3 inverseDirection = 1.0f / directions[i];
+			float nearest = -1.0f;
+			float distance;
+			for (const BoundingBox& item : items) {
+				if (SceneBvh::intersectRay(item, origins[i], inverseDirection, rayLength, distance) && (nearest < 0.0f || distance < nearest)) {
+					nearest = distance;
+				}
+			}
+			bruteForceHits[i] = nearest;
+		}
+	});
+	for (unsigned int i = 0; i < queryCount; i++) {
+		mismatches += bvhHitFlags[i] ? bvhHits[i].distance != bruteForceHits[i] : bruteForceHits[i] >= 0.0f;
+	}
+
+	float radius = QUERY_RADIUS * ITEM_SPACING;
+	size_t bvhNearby = 0;
+	double bvhSpheres = timeMilliseconds([&]() {
+		for (unsigned int i = 0; i < queryCount; i++) {
+			found.clear();
+			bvh.querySphere(origins[i], radius, found);
+			bvhNearby += found.size();
+		}
+	});
+	size_t bruteForceNearby = 0;
+	double bruteForceSpheres = timeMilliseconds([&]() {
+		for (unsigned int i = 0; i < queryCount; i++) {
+			for (const BoundingBox& item : items) {
+				bruteForceNearby += SceneBvh::getDistanceSquared(item, origins[i]) <= radius * radius;
+			}
+		}
+	});
+	mismatches += bvhNearby != bruteForceNearby;
+
+	std::vector<float> bvhNearest(queryCount);
+	double bvhNearestTime = timeMilliseconds([&]() {
+		for (unsigned int i = 0; i < queryCount; i++) {
+			unsigned int item;
+			if (!bvh.findNearest(origins[i], rayLength, item, bvhNearest[i])) {
+				bvhNearest[i] = -1.0f;
+			}
+		}
+	});
+	std::vector<float> bruteForceNearest(queryCount);
+	double bruteForceNearestTime = timeMilliseconds([&]() {
+		for (unsigned int i = 0; i < queryCount; i++) {
+			float nearestSquared = rayLength * rayLength;
+			bool hasNearest = false;
+			for (const BoundingBox& item : items) {
+				float distanceSquared = SceneBvh::getDistanceSquared(item, origins[i]);
+				if (distanceSquared <= nearestSquared) {
+					nearestSquared = distanceSquared;
+					hasNearest = true;
+				}
+			}
+			bruteForceNearest[i] = hasNearest ? std::sqrt(nearestSquared) : -1.0f;
+		}
+	});
+	for (unsigned int i = 0; i < queryCount; i++) {
+		mismatches += bvhNearest[i] != bruteForceNearest[i];
+	}
+
+	std::cout << queryCount << " queries of each kind, " << (double)bvhVisible / queryCount << " items per frustum, "
+		<< (double)bruteForceNearby / queryCount << " per sphere\n";
+	std::cout << std::left << std::setw(12) << "query" << std::right << std::setw(14) << "bvh (us)" << std::setw(14) << "brute (us)" << std::setw(11) << "speedup" << "\n";
+	printRow("frustum", bvhFrustum, bruteForceFrustum, queryCount);
+	printRow("raycast", bvhRays, bruteForceRays, queryCount);
+	printRow("sphere", bvhSpheres, bruteForceSpheres, queryCount);
+	printRow("nearest", bvhNearestTime, bruteForceNearestTime, queryCount);
+
+	if (mismatches > 0) {
+		std::cout << mismatches << " queries of the hierarchy differ from brute force\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
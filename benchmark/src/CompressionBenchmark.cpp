@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "Benchmark.h"
+#include "TextureCompressor.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
+
+#define DEFLT_RUN_COUNT 3
+
+static const BlockFormat FORMATS[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5 };
+static const char* FORMAT_NAMES[] = { "BC1", "BC3", "BC4", "BC5" };
+// The channels each format stores, the others aren't compared.
+static const int FORMAT_CHANNELS[] = { 3, 4, 1, 2 };
+
+/**
+	Gets the channel of the pixel of the image as the compressor sees it, with gray images spread to RGB and opaque alpha.
+ */
+static int getChannel(const TextureImage& image, size_t pixel, int channel) {
+	const unsigned char* components = image.Pixels.get() + pixel * image.Components;
+	if (image.Components <= 2) {
+		return channel < 3 ? components[0] : image.Components == 2 ? components[1] : 255;
+	}
+	return channel < image.Components ? components[channel] : 255;
+}
+
+/**
+	Gets the peak signal to noise ratio of the first level of the compressed image against the source, over the indicated channels.
+ */
+static double getPsnr(const TextureImage& source, const CompressedImage& compressed, int channelCount) {
+	TextureImage decoded = TextureCompressor::decompress(compressed);
+	size_t pixelCount = (size_t)source.Width * source.Height;
+	double squaredError = 0.0;
+	for (size_t i = 0; i < pixelCount; i++) {
+		for (int c = 0; c < channelCount; c++) {
+			double error = getChannel(source, i, c) - decoded.Pixels.get()[i * 4 + c];
+			squaredError += error * error;
+		}
+	}
+	double meanSquaredError = squaredError / ((double)pixelCount * channelCount);
+	return meanSquaredError == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+template <typename Function>
+static double timeMedian(unsigned int runs, Function function) {
+	std::vector<double> samples;
+	for (unsigned int i = 0; i < runs; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		function();
+		samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(samples.begin(), samples.end());
+	return getPercentile(samples, 0.5);
+}
+
+int runCompressionBenchmark(const std::vector<std::string>& args) {
+
+	unsigned int runCount = DEFLT_RUN_COUNT;
+	std::vector<std::string> imagePaths;
+	for (size_t i = 0; i < args.size(); i++) {
+		if (args[i] == "--runs" && i + 1 < args.size()) {
+			runCount = (unsigned int)std::max(std::atoi(args[++i].c_str()), 1);
+		}
+		else {
+			imagePaths.push_back(args[i]);
+		}
+	}
+	if (imagePaths.empty()) {
+		return EXIT_FAILURE;
+	}
+
+	ThreadPool& pool = ThreadPool::getShared();
+	int result = EXIT_SUCCESS;
+	for (const std::string& imagePath : imagePaths) {
+
+		TextureImage image;
+		try {
+			image = TextureImage::load(imagePath);
+		}
+		catch (const Texture::TextureLoadingFailure& e) {
+			std::cout << "couldn't decode " << imagePath << "\n";
+			return EXIT_FAILURE;
+		}
+
+		// The mip chain of the uncompressed texture adds a third to the base level.
+		double megapixels = (double)image.Width * image.Height / 1e6;
+		double uncompressedBytes = (double)image.Width * image.Height * image.Components * 4.0 / 3.0;
+		BlockFormat chosen = TextureCompressor::chooseFormat(image, "texture_diffuse");
+		std::cout << imagePath << ", " << image.Width << "x" << image.Height << " with " << image.Components << " components, "
+			<< runCount << " runs, " << pool.getThreadCount() << " worker threads, picked " << FORMAT_NAMES[(int)chosen] << "\n";
+		std::cout << std::left << std::setw(8) << "format" << std::right << std::setw(14) << "1 thread (ms)" << std::setw(12) << "pool (ms)"
+			<< std::setw(12) << "MPixel/s" << std::setw(10) << "KB" << std::setw(10) << "ratio" << std::setw(10) << "PSNR" << "\n";
+
+		for (int f = 0; f < 4; f++) {
+			CompressedImage compressed;
+			double singleThread = timeMedian(runCount, [&]() { compressed = TextureCompressor::compress(image, FORMATS[f], nullptr); });
+			double pooled = timeMedian(runCount, [&]() { compressed = TextureCompressor::compress(image, FORMATS[f], &pool); });
+
+			size_t compressedBytes = 0;
+			for (const CompressedLevel& level : compressed.Levels) {
+				compressedBytes += level.Data.size();
+			}
+			std::cout << std::left << std::setw(8) << FORMAT_NAMES[f] << std::right << std::fixed << std::setprecision(2)
+				<< std::setw(14) << singleThread << std::setw(12) << pooled << std::setw(12) << megapixels * 1000.0 / pooled
+				<< std::setw(10) << compressedBytes / 1024 << std::setprecision(1) << std::setw(9) << uncompressedBytes / compressedBytes << "x"
+				<< std::setw(10) << getPsnr(image, compressed, FORMAT_CHANNELS[f]) << "\n";
+
+			// The container must give back exactly what was written.
+			std::string ddsPath = imagePath + ".benchmark.dds";
+			CompressedImage reloaded;
+			bool roundTrip = TextureContainer::saveDds(ddsPath, compressed) && TextureContainer::load(ddsPath, reloaded)
+				&& reloaded.Format == compressed.Format && reloaded.Levels.size() == compressed.Levels.size();
+			for (size_t i = 0; roundTrip && i < compressed.Levels.size(); i++) {
+				roundTrip = reloaded.Levels[i].Data == compressed.Levels[i].Data;
+			}
+			std::remove(ddsPath.c_str());
+			if (!roundTrip) {
+				std::cout << FORMAT_NAMES[f] << " didn't survive a round trip through a DDS file\n";
+				result = EXIT_FAILURE;
+			}
+		}
+		std::cout << std::endl;
+	}
+	return result;
+}
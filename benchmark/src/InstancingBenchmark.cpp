@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "GLStateCache.h"
+#include "Model.h"
+#include "RenderQueue.h"
+#include "RenderStats.h"
+#include "Shader.h"
+#include "OpenGLErrorHandling.h"
+
+#define DEFLT_INSTANCE_COUNT	10000
+#define DEFLT_FRAME_COUNT		100
+#define WARM_UP_FRAMES			5
+
+#define TARGET_WIDTH		1280
+#define TARGET_HEIGHT	720
+
+// The distance between the copies of the model on the grid.
+#define INSTANCE_SPACING	3.0f
+
+static const char* DEFLT_MODEL_PATH = "../learnOpenGL/res/models/backpack/backpack.obj";
+
+static const char* VERTEX_SHADER_PATH = "../learnOpenGL/res/shaders/modelShader.vert";
+static const char* INSTANCED_VERTEX_SHADER_PATH = "../learnOpenGL/res/shaders/modelShaderInstanced.vert";
+static const char* FRAGMENT_SHADER_PATH = "../learnOpenGL/res/shaders/modelShader.frag";
+static const char* ARRAY_FRAGMENT_SHADER_PATH = "../learnOpenGL/res/shaders/modelShaderArray.frag";
+
+/**
+	The frame times of one way of drawing the scene, in milliseconds.
+ */
+struct FrameTimes {
+	std::vector<double> cpu;
+	std::vector<double> frame;
+	size_t drawCalls;
+	size_t textureBinds;
+	// The binds that reached OpenGL, and those the state cache skipped.
+	size_t bindsIssued;
+	size_t bindsElided;
+};
+
+/**
+	Places the copies of the model on a square grid centered on the origin.
+ */
+static std::vector<glm::mat4> createGrid(unsigned int instanceCount) {
+	unsigned int side = (unsigned int)std::ceil(std::sqrt((double)instanceCount));
+	float halfExtent = (side - 1) * INSTANCE_SPACING * 0.5f;
+
+	std::vector<glm::mat4> modelMats;
+	modelMats.reserve(instanceCount);
+	for (unsigned int i = 0; i < instanceCount; i++) {
+		glm::vec3 position((i % side) * INSTANCE_SPACING - halfExtent, 0.0f, (i / side) * INSTANCE_SPACING - halfExtent);
+		modelMats.push_back(glm::translate(glm::mat4(1.0f), position));
+	}
+	return modelMats;
+}
+
+/**
+	Draws the indicated number of frames, timing the submission of each and the wait for the GPU to finish it.
+ */
+template <typename DrawFunction>
+static FrameTimes timeFrames(unsigned int frameCount, DrawFunction drawFrame) {
+
+	FrameTimes times;
+	times.drawCalls = 0;
+	times.textureBinds = 0;
+	times.bindsIssued = 0;
+	times.bindsElided = 0;
+	for (unsigned int frame = 0; frame < WARM_UP_FRAMES + frameCount; frame++) {
+		RenderStats::reset();
+		GLStateCache::getShared().resetStats();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		drawFrame();
+		std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+		GLCall(glFinish());
+		std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+		if (frame >= WARM_UP_FRAMES) {
+			times.cpu.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+			times.frame.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+			times.drawCalls = RenderStats::get().drawCalls;
+			times.textureBinds = RenderStats::get().textureBinds;
+			times.bindsIssued = GLStateCache::getShared().getStats().getIssued();
+			times.bindsElided = GLStateCache::getShared().getStats().getElided();
+		}
+	}
+	std::sort(times.cpu.begin(), times.cpu.end());
+	std::sort(times.frame.begin(), times.frame.end());
+	return times;
+}
+
+static void printFrameTimes(const char* name, const FrameTimes& times) {
+	std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << times.drawCalls << std::setw(12) << times.textureBinds
+		<< std::setw(12) << times.bindsIssued << std::setw(12) << times.bindsElided
+		<< std::setw(12) << getPercentile(times.cpu, 0.5) << std::setw(12) << getPercentile(times.cpu, 0.9)
+		<< std::setw(12) << getPercentile(times.frame, 0.5) << std::setw(12) << getPercentile(times.frame, 0.9) << "\n";
+}
+
+int runInstancingBenchmark(const std::vector<std::string>& args) {
+
+	unsigned int instanceCount = args.size() > 0 ? (unsigned int)std::max(std::atoi(args[0].c_str()), 1) : DEFLT_INSTANCE_COUNT;
+	unsigned int frameCount = args.size() > 1 ? (unsigned int)std::max(std::atoi(args[1].c_str()), 1) : DEFLT_FRAME_COUNT;
+	std::string modelPath = args.size() > 2 ? args[2] : DEFLT_MODEL_PATH;
+
+	try {
+		RenderTarget target(TARGET_WIDTH, TARGET_HEIGHT);
+		GLCall(glEnable(GL_DEPTH_TEST));
+
+		Model model(modelPath);
+		ModelLoadOptions packedOptions;
+		packedOptions.packTextures = true;
+		Model packedModel(modelPath, packedOptions);
+		Shader loopShader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+		Shader packedShader(VERTEX_SHADER_PATH, ARRAY_FRAGMENT_SHADER_PATH);
+		Shader instancedShader(INSTANCED_VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+
+		std::vector<glm::mat4> modelMats = createGrid(instanceCount);
+
+		// Looking down at the whole grid from one of its corners.
+		float gridExtent = std::sqrt((float)instanceCount) * INSTANCE_SPACING;
+		glm::mat4 viewMat = glm::lookAt(glm::vec3(-0.6f, 0.5f, -0.6f) * gridExtent, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projectionMat = glm::perspective(glm::radians(45.0f), (float)TARGET_WIDTH / (float)TARGET_HEIGHT, 0.1f, gridExtent * 3.0f);
+
+		for (Shader* shader : { &loopShader, &packedShader, &instancedShader }) {
+			shader->use();
+			shader->setUniform("ViewMat", viewMat);
+			shader->setUniform("ProjectionMat", projectionMat);
+		}
+
+		loopShader.use();
+		FrameTimes loopTimes = timeFrames(frameCount, [&]() {
+			for (const glm::mat4& modelMat : modelMats) {
+				model.draw(loopShader, modelMat);
+			}
+		});
+
+		// The same loop, with the textures packed in arrays bound once per copy instead of per mesh.
+		packedShader.use();
+		FrameTimes packedTimes = timeFrames(frameCount, [&]() {
+			for (const glm::mat4& modelMat : modelMats) {
+				packedModel.draw(packedShader, modelMat);
+			}
+		});
+
+		// The same loop through a render queue, which draws the meshes of all the copies grouped by texture.
+		RenderQueue queue;
+		FrameTimes queuedTimes = timeFrames(frameCount, [&]() {
+			for (const glm::mat4& modelMat : modelMats) {
+				model.enqueue(queue, loopShader, modelMat);
+			}
+			queue.submit();
+		});
+
+		instancedShader.use();
+		FrameTimes instancedTimes = timeFrames(frameCount, [&]() {
+			model.drawInstanced(instancedShader, modelMats);
+		});
+
+		std::cout << instanceCount << " instances of " << modelPath << ", " << frameCount << " frames at " << TARGET_WIDTH << "x" << TARGET_HEIGHT << "\n";
+		std::cout << std::left << std::setw(12) << "path" << std::right << std::setw(12) << "draw calls" << std::setw(12) << "tex binds"
+			<< std::setw(12) << "gl binds" << std::setw(12) << "elided"
+			<< std::setw(12) << "cpu p50" << std::setw(12) << "cpu p90" << std::setw(12) << "frame p50" << std::setw(12) << "frame p90" << "  (ms)\n";
+		printFrameTimes("loop", loopTimes);
+		printFrameTimes("packed", packedTimes);
+		printFrameTimes("queued", queuedTimes);
+		printFrameTimes("instanced", instancedTimes);
+		std::cout << "instanced frames are " << getPercentile(loopTimes.frame, 0.5) / getPercentile(instancedTimes.frame, 0.5)
+			<< "x faster at the median" << std::defaultfloat << std::endl;
+		queue.printReport(std::cout);
+	}
+	catch (const Shader::ShaderCompileError& e) {
+		std::cout << "SHADER COMPILE ERROR:\n" << Shader::getInfoLogBuffer() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (const Texture::TextureLoadingFailure& e) {
+		std::cout << "TEXTURE LOADING FAILURE\n";
+		return EXIT_FAILURE;
+	}
+	catch (const std::ios_base::failure& e) {
+		std::cout << "FILES COULDN'T BE READ FROM:\n" << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
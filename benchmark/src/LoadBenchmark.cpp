@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "Benchmark.h"
+#include "LoadProfiler.h"
+#include "Model.h"
+#include "ModelCache.h"
+
+static const double PERCENTILES[] = { 0.5, 0.9, 0.99 };
+static const char* PERCENTILE_NAMES[] = { "p50", "p90", "p99" };
+
+/**
+	Prints the distribution of every stage over the runs, one row per stage that ran.
+ */
+static void printStageTable(const std::vector<LoadProfile>& profiles) {
+
+	const unsigned int percentileCount = sizeof(PERCENTILES) / sizeof(PERCENTILES[0]);
+
+	std::cout << std::left << std::setw(20) << "stage" << std::right << std::setw(8) << "calls" << std::setw(12) << "KB"
+		<< std::setw(10) << "min";
+	for (unsigned int p = 0; p < percentileCount; p++) {
+		std::cout << std::setw(10) << PERCENTILE_NAMES[p];
+	}
+	std::cout << std::setw(10) << "max" << "  (ms per run)\n";
+
+	std::vector<double> samples(profiles.size());
+	for (int s = 0; s < (int)LoadStage::COUNT; s++) {
+		LoadStage stage = (LoadStage)s;
+		if (profiles.back()[stage].calls == 0) {
+			continue;
+		}
+		for (size_t r = 0; r < profiles.size(); r++) {
+			samples[r] = profiles[r][stage].milliseconds;
+		}
+		std::sort(samples.begin(), samples.end());
+
+		const LoadStageStats& lastRun = profiles.back()[stage];
+		std::cout << std::left << std::setw(20) << LoadProfiler::getStageName(stage) << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(8) << lastRun.calls << std::setw(12) << lastRun.bytes / 1024 << std::setw(10) << samples.front();
+		for (unsigned int p = 0; p < percentileCount; p++) {
+			std::cout << std::setw(10) << getPercentile(samples, PERCENTILES[p]);
+		}
+		std::cout << std::setw(10) << samples.back() << "\n";
+	}
+	std::cout << std::defaultfloat << std::flush;
+}
+
+int runLoadBenchmark(const std::vector<std::string>& args) {
+
+	if (args.empty()) {
+		return EXIT_FAILURE;
+	}
+	unsigned int runCount = (unsigned int)std::max(std::atoi(args[0].c_str()), 1);
+
+	ModelLoadOptions options;
+	bool cold = false;
+	std::vector<std::string> modelPaths;
+	for (size_t i = 1; i < args.size(); i++) {
+		if (args[i] == "--cold") {
+			cold = true;
+			options.cacheTextures = false;
+		}
+		else if (args[i] == "--optimize") {
+			options.optimizeMeshes = true;
+		}
+		else if (args[i] == "--clusters") {
+			options.buildClusters = true;
+		}
+		else if (args[i] == "--shared") {
+			options.sharedBuffers = true;
+		}
+		else if (args[i] == "--compress") {
+			options.compressTextures = true;
+		}
+		else if (args[i] == "--gpu-sync") {
+			LoadProfiler::setGpuSynchronized(true);
+		}
+		else if (args[i] == "--lods" && i + 1 < args.size()) {
+			options.lodLevels = (unsigned int)std::max(std::atoi(args[++i].c_str()), 0);
+		}
+		else {
+			modelPaths.push_back(args[i]);
+		}
+	}
+	if (modelPaths.empty()) {
+		return EXIT_FAILURE;
+	}
+
+	for (const std::string& modelPath : modelPaths) {
+
+		std::vector<LoadProfile> profiles;
+		profiles.reserve(runCount);
+		LodTriangleStats lodStats = {};
+		for (unsigned int run = 0; run < runCount; run++) {
+			// Without the caches every run imports the model with Assimp and decodes its textures, otherwise only the first one does.
+			// The textures are freed with the model, so every run uploads them again.
+			if (cold) {
+				std::remove(ModelCache::getCachePath(modelPath).c_str());
+			}
+
+			LoadProfiler::reset();
+			{
+				Model model(modelPath, options);
+				lodStats = model.getLodTriangleStats();
+			}
+			profiles.push_back(LoadProfiler::getProfile());
+		}
+
+		std::cout << modelPath << ", " << runCount << (cold ? " cold" : "") << " runs\n";
+		printStageTable(profiles);
+		if (options.lodLevels > 0) {
+			std::cout << lodStats.fullDetailTriangles << " triangles, " << lodStats.coarsestTriangles << " at the coarsest level of detail\n";
+			// Simplifying only locked vertices leaves the levels of detail as detailed as the full mesh.
+			if (lodStats.coarsestTriangles >= lodStats.fullDetailTriangles) {
+				std::cout << "the levels of detail didn't simplify the model" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <gtc/matrix_transform.hpp>
+
+#include "Benchmark.h"
+#include "GLStateCache.h"
+#include "Model.h"
+#include "PixelUploadRing.h"
+#include "Shader.h"
+#include "TextureData.h"
+#include "OpenGLErrorHandling.h"
+
+#define DEFLT_TEXTURE_COUNT		100
+#define DEFLT_TEXTURE_SIZE		512
+#define DEFLT_UPLOADS_PER_FRAME	2
+#define WARM_UP_FRAMES			5
+
+// The frames the CPU may run ahead of the GPU, like a swap chain would allow.
+#define FRAME_LATENCY	2
+
+#define TARGET_WIDTH		1280
+#define TARGET_HEIGHT	720
+
+static const char* DEFLT_MODEL_PATH = "../learnOpenGL/res/models/backpack/backpack.obj";
+
+static const char* VERTEX_SHADER_PATH = "../learnOpenGL/res/shaders/modelShader.vert";
+static const char* FRAGMENT_SHADER_PATH = "../learnOpenGL/res/shaders/modelShader.frag";
+
+/**
+	The times of one way of uploading the textures, in milliseconds.
+ */
+struct UploadTimes {
+	std::vector<double> upload;
+	std::vector<double> frame;
+	double total;
+};
+
+/**
+	Cooks a gradient with a different tint for every texture, so the driver can't share their storage.
+ */
+static TextureData createTexture(int size, unsigned int index) {
+	TextureImage image;
+	image.Width = size;
+	image.Height = size;
+	image.Components = 4;
+	image.Pixels = std::shared_ptr<unsigned char>(new unsigned char[(size_t)size * size * 4], std::default_delete<unsigned char[]>());
+	unsigned char* pixels = image.Pixels.get();
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			unsigned char* pixel = pixels + ((size_t)y * size + x) * 4;
+			pixel[0] = (unsigned char)(x * 255 / size);
+			pixel[1] = (unsigned char)(y * 255 / size);
+			pixel[2] = (unsigned char)(index * 37);
+			pixel[3] = 255;
+		}
+	}
+	return TextureData::fromImage(image);
+}
+
+/**
+	Draws the model every frame and uploads the indicated number of textures per frame until they are all
+	on the GPU, letting the CPU run FRAME_LATENCY frames ahead of the GPU.
+ */
+static UploadTimes timeUploads(const std::vector<TextureData>& textures, unsigned int uploadsPerFrame, PixelUploadRing* ring, Model& model, Shader& shader) {
+
+	typedef std::chrono::steady_clock Clock;
+	auto elapsedMs = [](Clock::time_point start, Clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	UploadTimes times;
+	std::vector<unsigned int> ids;
+	std::deque<GLsync> frameFences;
+	size_t nextTexture = 0;
+	Clock::time_point start = Clock::now();
+	for (unsigned int frame = 0; frame < WARM_UP_FRAMES || nextTexture < textures.size(); frame++) {
+		Clock::time_point frameStart = Clock::now();
+		if (frame == WARM_UP_FRAMES) {
+			start = frameStart;
+		}
+
+		GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		model.draw(shader, glm::mat4(1.0f));
+
+		if (frame >= WARM_UP_FRAMES) {
+			Clock::time_point uploadStart = Clock::now();
+			for (unsigned int i = 0; i < uploadsPerFrame && nextTexture < textures.size(); i++, nextTexture++) {
+				ids.push_back(textures[nextTexture].createTexture("upload", "texture_diffuse", ring).Id);
+			}
+			times.upload.push_back(elapsedMs(uploadStart, Clock::now()));
+		}
+
+		// Stands in for the swap, which blocks once the driver has queued enough frames.
+		frameFences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+		if (frameFences.size() > FRAME_LATENCY) {
+			glClientWaitSync(frameFences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			GLCall(glDeleteSync(frameFences.front()));
+			frameFences.pop_front();
+		}
+
+		if (frame >= WARM_UP_FRAMES) {
+			times.frame.push_back(elapsedMs(frameStart, Clock::now()));
+		}
+	}
+	GLCall(glFinish());
+	times.total = elapsedMs(start, Clock::now());
+
+	for (GLsync fence : frameFences) {
+		GLCall(glDeleteSync(fence));
+	}
+	GLStateCache::getShared().deleteTextures((GLsizei)ids.size(), ids.data());
+	std::sort(times.upload.begin(), times.upload.end());
+	std::sort(times.frame.begin(), times.frame.end());
+	return times;
+}
+
+static void printUploadTimes(const char* name, const UploadTimes& times) {
+	std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << getPercentile(times.upload, 0.5) << std::setw(12) << getPercentile(times.upload, 0.99)
+		<< std::setw(12) << getPercentile(times.frame, 0.5) << std::setw(12) << getPercentile(times.frame, 0.99)
+		<< std::setw(12) << times.total << "\n";
+}
+
+int runUploadBenchmark(const std::vector<std::string>& args) {
+
+	unsigned int textureCount = args.size() > 0 ? (unsigned int)std::max(std::atoi(args[0].c_str()), 1) : DEFLT_TEXTURE_COUNT;
+	int textureSize = args.size() > 1 ? std::max(std::atoi(args[1].c_str()), 1) : DEFLT_TEXTURE_SIZE;
+	unsigned int uploadsPerFrame = args.size() > 2 ? (unsigned int)std::max(std::atoi(args[2].c_str()), 1) : DEFLT_UPLOADS_PER_FRAME;
+	std::string modelPath = args.size() > 3 ? args[3] : DEFLT_MODEL_PATH;
+
+	try {
+		RenderTarget target(TARGET_WIDTH, TARGET_HEIGHT);
+		GLCall(glEnable(GL_DEPTH_TEST));
+
+		Model model(modelPath);
+		Shader shader(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+		shader.use();
+		shader.setUniform("ViewMat", glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		shader.setUniform("ProjectionMat", glm::perspective(glm::radians(45.0f), (float)TARGET_WIDTH / (float)TARGET_HEIGHT, 0.1f, 100.0f));
+
+		// Cooked up front, so only the uploads are timed.
+		std::vector<TextureData> textures;
+		size_t bytes = 0;
+		for (unsigned int i = 0; i < textureCount; i++) {
+			textures.push_back(createTexture(textureSize, i));
+			bytes += textures.back().getSize();
+		}
+
+		UploadTimes directTimes = timeUploads(textures, uploadsPerFrame, nullptr, model, shader);
+		// Slots that fit the base level, so every level goes through the ring.
+		PixelUploadRing ring(std::max(textures[0].Levels[0].Size, (size_t)DEFLT_UPLOAD_SLOT_SIZE));
+		UploadTimes ringTimes = timeUploads(textures, uploadsPerFrame, &ring, model, shader);
+
+		const PixelUploadStats& stats = ring.getStats();
+		std::cout << textureCount << " textures of " << textureSize << "x" << textureSize << ", " << bytes / (1024 * 1024) << " MB with their mips, "
+			<< uploadsPerFrame << " per frame while drawing " << modelPath << "\n";
+		std::cout << std::left << std::setw(12) << "path" << std::right << std::setw(12) << "upload p50" << std::setw(12) << "upload p99"
+			<< std::setw(12) << "frame p50" << std::setw(12) << "frame p99" << std::setw(12) << "total" << "  (ms)\n";
+		printUploadTimes("direct", directTimes);
+		printUploadTimes("ring", ringTimes);
+		std::cout << "the " << (ring.isPersistent() ? "persistently mapped" : "mapped per upload") << " ring took " << stats.uploads << " levels and stalled "
+			<< stats.stalls << " times for " << stats.stallMilliseconds << " ms" << std::defaultfloat << std::endl;
+	}
+	catch (const Shader::ShaderCompileError& e) {
+		std::cout << "SHADER COMPILE ERROR:\n" << Shader::getInfoLogBuffer() << std::endl;
+		return EXIT_FAILURE;
+	}
+	catch (const Texture::TextureLoadingFailure& e) {
+		std::cout << "TEXTURE LOADING FAILURE\n";
+		return EXIT_FAILURE;
+	}
+	catch (const std::ios_base::failure& e) {
+		std::cout << "FILES COULDN'T BE READ FROM:\n" << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <exception>
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+
+/**
+	A hidden window with a current OpenGL context, so the benchmarks can create GPU resources.
+ */
+class BenchmarkContext {
+private:
+
+	GLFWwindow* window;
+
+public:
+
+	/**
+		Exception that indicates the window or its OpenGL context couldn't be created.
+	 */
+	class ContextCreationFailure : public std::exception {
+	public:
+		explicit ContextCreationFailure() {}
+	};
+
+	/**
+		Creates the hidden window and makes its context current.
+	 */
+	BenchmarkContext();
+
+	/**
+		Destroys the window and terminates glfw.
+	 */
+	~BenchmarkContext();
+
+	BenchmarkContext(const BenchmarkContext& context) = delete;
+	BenchmarkContext& operator=(const BenchmarkContext& context) = delete;
+};
+
+/**
+	An offscreen color and depth target the size of a window, so the fragment work is the same as
+	on screen. Stays bound as the framebuffer until it's destroyed.
+ */
+class RenderTarget {
+private:
+
+	unsigned int FBO;
+	unsigned int ColorRBO;
+	unsigned int DepthRBO;
+
+public:
+
+	RenderTarget(int width, int height);
+
+	~RenderTarget();
+
+	RenderTarget(const RenderTarget& target) = delete;
+	RenderTarget& operator=(const RenderTarget& target) = delete;
+};
+
+/**
+	Gets the value under which the indicated fraction of the sorted samples fall (nearest rank).
+ */
+double getPercentile(const std::vector<double>& sortedSamples, double fraction);
+
+/**
+	Counts the heap allocations of the import path, from the Assimp mesh to the uploaded Mesh,
+	for meshes of growing vertex counts.
+	@return EXIT_FAILURE if the allocation count grows with the vertex count.
+ */
+int runAllocationBenchmark(const std::vector<std::string>& args);
+
+/**
+	Loads each model the indicated number of times and prints the time of every stage of the load,
+	as its minimum, percentiles and maximum over the runs.
+	Arguments: <runs> [--cold] [--optimize] [--lods <levels>] [--clusters] [--shared] [--compress] [--gpu-sync] <model>...
+ */
+int runLoadBenchmark(const std::vector<std::string>& args);
+
+/**
+	Draws a grid of copies of a model to an offscreen target, first with a draw per copy, then
+	the same with the model's textures packed in arrays, then through a render queue, then
+	instanced, and prints the draw calls, texture binds, binds the state cache issued and
+	elided, and frame times of each.
+	Arguments: [instances] [frames] [model]
+ */
+int runInstancingBenchmark(const std::vector<std::string>& args);
+
+/**
+	Builds a bounding volume hierarchy over a synthetic scene on one thread and on the pool, times
+	refitting it after moving a few items, then compares its frustum, ray, sphere and nearest item
+	queries against testing every item.
+	Arguments: [items] [queries]
+	@return EXIT_FAILURE if a query of the hierarchy doesn't match brute force.
+ */
+int runBvhBenchmark(const std::vector<std::string>& args);
+
+/**
+	Block compresses each image in every format on one thread and on the pool, and prints the
+	encoding time, the size and the peak signal to noise ratio of every format.
+	Arguments: [--runs <runs>] <image>...
+	@return EXIT_FAILURE if an image can't be decoded or a format doesn't survive a round trip through a DDS file.
+ */
+int runCompressionBenchmark(const std::vector<std::string>& args);
+
+/**
+	Draws a model to an offscreen target while uploading synthetic textures a few per frame, first
+	straight from client memory and then through a pixel upload ring, and prints the time the
+	uploads and the frames take with each, and how often the ring waited for a free slot.
+	Arguments: [textures] [size] [per frame] [model]
+ */
+int runUploadBenchmark(const std::vector<std::string>& args);
@@ -8,9 +8,25 @@ uniform mat4 ModelMat;
 uniform mat4 ViewMat;
 uniform mat4 ProjectionMat;
 
+// Decoding of the mesh's vertex format (see VertexFormat).
+uniform vec3 PositionScale;
+uniform vec3 PositionOffset;
+uniform bool OctahedralNormals;
+
 out vec2 TexCoords;
+out vec3 Normal;
+
+vec3 decodeOctahedral(vec2 e) {
+   vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+   float t = max(-n.z, 0.0);
+   n.x += n.x >= 0.0 ? -t : t;
+   n.y += n.y >= 0.0 ? -t : t;
+   return normalize(n);
+}
 
 void main() {
+   vec3 position = aPos * PositionScale + PositionOffset;
+   Normal = OctahedralNormals ? decodeOctahedral(aNormal.xy) : aNormal;
    TexCoords = aTexCoords;
-   gl_Position = ProjectionMat * ViewMat * ModelMat * vec4(aPos, 1.0);
+   gl_Position = ProjectionMat * ViewMat * ModelMat * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 TexCoords;
+
+// The model's texture packed in a texture array, and its layer (see TexturePacker).
+uniform sampler2DArray texture_diffuse1;
+uniform int texture_diffuse1_layer;
+
+out vec4 FragColor;
+
+void main () {
+   FragColor = texture(texture_diffuse1, vec3(TexCoords, float(texture_diffuse1_layer)));
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include "BoundingVolumes.h"
+#include "Mesh.h"
+#include "Simd.h"
+
+MeshBounds BoundingVolumes::compute(const std::vector<Vertex>& vertices) {
+
+   MeshBounds bounds;
+   if (vertices.empty()) {
+      bounds.Box.Min = bounds.Box.Max = glm::vec3(0.0f);
+      bounds.Sphere.Center = glm::vec3(0.0f);
+      bounds.Sphere.Radius = 0.0f;
+      return bounds;
+   }
+
+   bounds.Box = computeBox(vertices.data(), vertices.size());
+   bounds.Sphere.Center = (bounds.Box.Min + bounds.Box.Max) * 0.5f;
+   bounds.Sphere.Radius = glm::sqrt(computeMaxDistanceSquared(vertices.data(), vertices.size(), bounds.Sphere.Center));
+   return bounds;
+}
+
+MeshBounds BoundingVolumes::transform(const MeshBounds& bounds, const glm::mat4& transform) {
+
+   // The extent of the transformed box along each axis is the sum of the absolute contributions of the box's half sizes.
+   glm::vec3 center = glm::vec3(transform * glm::vec4((bounds.Box.Min + bounds.Box.Max) * 0.5f, 1.0f));
+   glm::vec3 halfSize = (bounds.Box.Max - bounds.Box.Min) * 0.5f;
+   glm::mat3 absolute(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+   glm::vec3 halfExtent = absolute * halfSize;
+
+   float scale = glm::sqrt(glm::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+      glm::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])))));
+
+   MeshBounds transformed;
+   transformed.Box.Min = center - halfExtent;
+   transformed.Box.Max = center + halfExtent;
+   transformed.Sphere.Center = glm::vec3(transform * glm::vec4(bounds.Sphere.Center, 1.0f));
+   transformed.Sphere.Radius = bounds.Sphere.Radius * scale;
+   return transformed;
+}
+
+MeshBounds BoundingVolumes::merge(const MeshBounds& a, const MeshBounds& b) {
+
+   MeshBounds merged;
+   merged.Box.Min = glm::min(a.Box.Min, b.Box.Min);
+   merged.Box.Max = glm::max(a.Box.Max, b.Box.Max);
+
+   // Centered on the merged box, large enough to hold both spheres.
+   merged.Sphere.Center = (merged.Box.Min + merged.Box.Max) * 0.5f;
+   merged.Sphere.Radius = glm::max(glm::length(a.Sphere.Center - merged.Sphere.Center) + a.Sphere.Radius,
+      glm::length(b.Sphere.Center - merged.Sphere.Center) + b.Sphere.Radius);
+   // The corners of the box are never farther than the half diagonal.
+   merged.Sphere.Radius = glm::min(merged.Sphere.Radius, glm::length(merged.Box.Max - merged.Box.Min) * 0.5f);
+   return merged;
+}
+
+BoundingBox BoundingVolumes::computeBox(const Vertex* vertices, std::size_t vertexCount) {
+
+   glm::vec3 minPosition = vertices[0].Position;
+   glm::vec3 maxPosition = vertices[0].Position;
+   std::size_t i = 0;
+
+#ifdef SIMD_SSE
+   __m128 minX = _mm_set1_ps(minPosition.x);
+   __m128 minY = _mm_set1_ps(minPosition.y);
+   __m128 minZ = _mm_set1_ps(minPosition.z);
+   __m128 maxX = minX;
+   __m128 maxY = minY;
+   __m128 maxZ = minZ;
+   for (; i + 4 <= vertexCount; i += 4) {
+      // Each load takes the position and the first component of the normal, which the transpose leaves in the unused row.
+      __m128 x = _mm_loadu_ps(&vertices[i].Position.x);
+      __m128 y = _mm_loadu_ps(&vertices[i + 1].Position.x);
+      __m128 z = _mm_loadu_ps(&vertices[i + 2].Position.x);
+      __m128 w = _mm_loadu_ps(&vertices[i + 3].Position.x);
+      _MM_TRANSPOSE4_PS(x, y, z, w);
+      minX = _mm_min_ps(minX, x);
+      minY = _mm_min_ps(minY, y);
+      minZ = _mm_min_ps(minZ, z);
+      maxX = _mm_max_ps(maxX, x);
+      maxY = _mm_max_ps(maxY, y);
+      maxZ = _mm_max_ps(maxZ, z);
+   }
+
+   alignas(16) float lanes[6][4];
+   _mm_store_ps(lanes[0], minX);
+   _mm_store_ps(lanes[1], minY);
+   _mm_store_ps(lanes[2], minZ);
+   _mm_store_ps(lanes[3], maxX);
+   _mm_store_ps(lanes[4], maxY);
+   _mm_store_ps(lanes[5], maxZ);
+   for (int lane = 0; lane < 4; lane++) {
+      minPosition = glm::min(minPosition, glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]));
+      maxPosition = glm::max(maxPosition, glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]));
+   }
+#endif
+
+   for (; i < vertexCount; i++) {
+      minPosition = glm::min(minPosition, vertices[i].Position);
+      maxPosition = glm::max(maxPosition, vertices[i].Position);
+   }
+   return { minPosition, maxPosition };
+}
+
+float BoundingVolumes::computeMaxDistanceSquared(const Vertex* vertices, std::size_t vertexCount, const glm::vec3& center) {
+
+   float maxDistanceSquared = 0.0f;
+   std::size_t i = 0;
+
+#ifdef SIMD_SSE
+   __m128 centerX = _mm_set1_ps(center.x);
+   __m128 centerY = _mm_set1_ps(center.y);
+   __m128 centerZ = _mm_set1_ps(center.z);
+   __m128 maxDistances = _mm_setzero_ps();
+   for (; i + 4 <= vertexCount; i += 4) {
+      __m128 x = _mm_loadu_ps(&vertices[i].Position.x);
+      __m128 y = _mm_loadu_ps(&vertices[i + 1].Position.x);
+      __m128 z = _mm_loadu_ps(&vertices[i + 2].Position.x);
+      __m128 w = _mm_loadu_ps(&vertices[i + 3].Position.x);
+      _MM_TRANSPOSE4_PS(x, y, z, w);
+      __m128 dx = _mm_sub_ps(x, centerX);
+      __m128 dy = _mm_sub_ps(y, centerY);
+      __m128 dz = _mm_sub_ps(z, centerZ);
+      __m128 distances = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+      maxDistances = _mm_max_ps(maxDistances, distances);
+   }
+
+   alignas(16) float lanes[4];
+   _mm_store_ps(lanes, maxDistances);
+   maxDistanceSquared = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+   for (; i < vertexCount; i++) {
+      glm::vec3 offset = vertices[i].Position - center;
+      maxDistanceSquared = std::max(maxDistanceSquared, glm::dot(offset, offset));
+   }
+   return maxDistanceSquared;
+}
@@ -0,0 +1,110 @@
+#include "Frustum.h"
+#include "Simd.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+
+   // GLM matrices are column major, so the rows are gathered across the columns.
+   glm::vec4 rows[4];
+   for (int i = 0; i < 4; i++) {
+      rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+   }
+
+   Planes[0] = rows[3] + rows[0];
+   Planes[1] = rows[3] - rows[0];
+   Planes[2] = rows[3] + rows[1];
+   Planes[3] = rows[3] - rows[1];
+   Planes[4] = rows[3] + rows[2];
+   Planes[5] = rows[3] - rows[2];
+
+   for (glm::vec4& plane : Planes) {
+      plane /= glm::length(glm::vec3(plane));
+   }
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+   for (const glm::vec4& plane : Planes) {
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+         return false;
+      }
+   }
+   return true;
+}
+
+bool Frustum::intersectsBox(const glm::vec3& center, const glm::vec3& halfExtent) const {
+   for (const glm::vec4& plane : Planes) {
+      // The distance of the box's corner farthest along the plane's normal.
+      float radius = glm::dot(glm::abs(glm::vec3(plane)), halfExtent);
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+         return false;
+      }
+   }
+   return true;
+}
+
+FrustumTest Frustum::classifyBox(const glm::vec3& center, const glm::vec3& halfExtent) const {
+   FrustumTest result = FrustumTest::INSIDE;
+   for (const glm::vec4& plane : Planes) {
+      float radius = glm::dot(glm::abs(glm::vec3(plane)), halfExtent);
+      float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+      if (distance < -radius) {
+         return FrustumTest::OUTSIDE;
+      }
+      if (distance < radius) {
+         result = FrustumTest::INTERSECTING;
+      }
+   }
+   return result;
+}
+
+size_t Frustum::cullBoxes(const BoxBatch& boxes, unsigned char* outVisible) const {
+
+   size_t visibleCount = 0;
+   size_t i = 0;
+
+#ifdef SIMD_SSE
+   // Every component of every plane, and its absolute value, broadcast to the 4 lanes.
+   __m128 planes[6][4];
+   __m128 absolutePlanes[6][3];
+   for (int p = 0; p < 6; p++) {
+      for (int c = 0; c < 4; c++) {
+         planes[p][c] = _mm_set1_ps(Planes[p][c]);
+      }
+      for (int c = 0; c < 3; c++) {
+         absolutePlanes[p][c] = _mm_set1_ps(glm::abs(Planes[p][c]));
+      }
+   }
+
+   for (; i + 4 <= boxes.count; i += 4) {
+      __m128 centerX = _mm_loadu_ps(boxes.centerX + i);
+      __m128 centerY = _mm_loadu_ps(boxes.centerY + i);
+      __m128 centerZ = _mm_loadu_ps(boxes.centerZ + i);
+      __m128 extentX = _mm_loadu_ps(boxes.extentX + i);
+      __m128 extentY = _mm_loadu_ps(boxes.extentY + i);
+      __m128 extentZ = _mm_loadu_ps(boxes.extentZ + i);
+
+      __m128 outside = _mm_setzero_ps();
+      for (int p = 0; p < 6; p++) {
+         __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], centerX), _mm_mul_ps(planes[p][1], centerY)),
+            _mm_add_ps(_mm_mul_ps(planes[p][2], centerZ), planes[p][3]));
+         __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absolutePlanes[p][0], extentX), _mm_mul_ps(absolutePlanes[p][1], extentY)),
+            _mm_mul_ps(absolutePlanes[p][2], extentZ));
+         outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+      }
+
+      int outsideMask = _mm_movemask_ps(outside);
+      for (int lane = 0; lane < 4; lane++) {
+         unsigned char visible = (outsideMask >> lane & 1) == 0 ? 1 : 0;
+         outVisible[i + lane] = visible;
+         visibleCount += visible;
+      }
+   }
+#endif
+
+   for (; i < boxes.count; i++) {
+      glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+      glm::vec3 halfExtent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+      outVisible[i] = intersectsBox(center, halfExtent) ? 1 : 0;
+      visibleCount += outVisible[i];
+   }
+   return visibleCount;
+}
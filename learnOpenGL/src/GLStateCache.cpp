@@ -0,0 +1,175 @@
+#include "GLStateCache.h"
+#include "OpenGLErrorHandling.h"
+
+GLStateCache::GLStateCache() :
+   Stats()
+   {
+   invalidate();
+}
+
+GLStateCache& GLStateCache::getShared() {
+   static GLStateCache cache;
+   return cache;
+}
+
+void GLStateCache::useProgram(unsigned int program) {
+   if (program == Program) {
+      Stats.programs.elided++;
+      return;
+   }
+   GLCall(glUseProgram(program));
+   Program = program;
+   Stats.programs.issued++;
+}
+
+void GLStateCache::bindVertexArray(unsigned int vertexArray) {
+   if (vertexArray == VertexArray) {
+      Stats.vertexArrays.elided++;
+      return;
+   }
+   GLCall(glBindVertexArray(vertexArray));
+   VertexArray = vertexArray;
+   Buffers[ELEMENT_ARRAY_BUFFER] = GL_STATE_UNKNOWN;
+   Stats.vertexArrays.issued++;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer) {
+   BufferTarget tracked = getBufferTarget(target);
+   if (tracked != BUFFER_TARGET_COUNT) {
+      if (buffer == Buffers[tracked]) {
+         Stats.buffers.elided++;
+         return;
+      }
+      Buffers[tracked] = buffer;
+   }
+   GLCall(glBindBuffer(target, buffer));
+   Stats.buffers.issued++;
+}
+
+void GLStateCache::activeTexture(unsigned int unit) {
+   if (unit == ActiveTexture) {
+      Stats.activeTextures.elided++;
+      return;
+   }
+   GLCall(glActiveTexture(GL_TEXTURE0 + unit));
+   ActiveTexture = unit;
+   Stats.activeTextures.issued++;
+}
+
+void GLStateCache::bindTexture(GLenum target, unsigned int texture) {
+   TextureTarget tracked = getTextureTarget(target);
+   if (tracked != TEXTURE_TARGET_COUNT && ActiveTexture < GL_STATE_TEXTURE_UNIT_COUNT) {
+      if (texture == Textures[ActiveTexture][tracked]) {
+         Stats.textures.elided++;
+         return;
+      }
+      Textures[ActiveTexture][tracked] = texture;
+   }
+   GLCall(glBindTexture(target, texture));
+   Stats.textures.issued++;
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+   TextureTarget tracked = getTextureTarget(target);
+   if (tracked != TEXTURE_TARGET_COUNT && unit < GL_STATE_TEXTURE_UNIT_COUNT && texture == Textures[unit][tracked]) {
+      Stats.textures.elided++;
+      return;
+   }
+   activeTexture(unit);
+   bindTexture(target, texture);
+}
+
+void GLStateCache::deleteProgram(unsigned int program) {
+   GLCall(glDeleteProgram(program));
+   // A program in use is only deleted once it isn't anymore, so it stays bound until then.
+   if (program == Program) {
+      Program = GL_STATE_UNKNOWN;
+   }
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const unsigned int* vertexArrays) {
+   GLCall(glDeleteVertexArrays(count, vertexArrays));
+   for (GLsizei i = 0; i < count; i++) {
+      if (vertexArrays[i] == VertexArray) {
+         VertexArray = 0;
+         Buffers[ELEMENT_ARRAY_BUFFER] = 0;
+      }
+   }
+}
+
+void GLStateCache::deleteBuffers(GLsizei count, const unsigned int* buffers) {
+   GLCall(glDeleteBuffers(count, buffers));
+   for (GLsizei i = 0; i < count; i++) {
+      for (unsigned int& binding : Buffers) {
+         if (binding == buffers[i]) {
+            binding = 0;
+         }
+      }
+   }
+}
+
+void GLStateCache::deleteTextures(GLsizei count, const unsigned int* textures) {
+   GLCall(glDeleteTextures(count, textures));
+   // A deleted texture is unbound from every unit it was bound to.
+   for (GLsizei i = 0; i < count; i++) {
+      for (unsigned int (&unit)[TEXTURE_TARGET_COUNT] : Textures) {
+         for (unsigned int& binding : unit) {
+            if (binding == textures[i]) {
+               binding = 0;
+            }
+         }
+      }
+   }
+}
+
+void GLStateCache::invalidate() {
+   Program = GL_STATE_UNKNOWN;
+   VertexArray = GL_STATE_UNKNOWN;
+   for (unsigned int& binding : Buffers) {
+      binding = GL_STATE_UNKNOWN;
+   }
+   ActiveTexture = GL_STATE_UNKNOWN;
+   for (unsigned int (&unit)[TEXTURE_TARGET_COUNT] : Textures) {
+      for (unsigned int& binding : unit) {
+         binding = GL_STATE_UNKNOWN;
+      }
+   }
+}
+
+void GLStateCache::resetStats() {
+   Stats = GLStateStats();
+}
+
+GLStateCache::BufferTarget GLStateCache::getBufferTarget(GLenum target) {
+   switch (target) {
+      case GL_ARRAY_BUFFER: {
+         return ARRAY_BUFFER;
+      }
+      case GL_ELEMENT_ARRAY_BUFFER: {
+         return ELEMENT_ARRAY_BUFFER;
+      }
+      case GL_PIXEL_UNPACK_BUFFER: {
+         return PIXEL_UNPACK_BUFFER;
+      }
+      case GL_UNIFORM_BUFFER: {
+         return UNIFORM_BUFFER;
+      }
+      default: {
+         return BUFFER_TARGET_COUNT;
+      }
+   }
+}
+
+GLStateCache::TextureTarget GLStateCache::getTextureTarget(GLenum target) {
+   switch (target) {
+      case GL_TEXTURE_2D: {
+         return TEXTURE_2D;
+      }
+      case GL_TEXTURE_2D_ARRAY: {
+         return TEXTURE_2D_ARRAY;
+      }
+      default: {
+         return TEXTURE_TARGET_COUNT;
+      }
+   }
+}
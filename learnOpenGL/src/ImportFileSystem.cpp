@@ -0,0 +1,85 @@
+#include <algorithm>
+
+#include "ImportFileSystem.h"
+
+ImportFileStream::ImportFileStream(std::FILE* file) :
+   File(file),
+   Size(0)
+   {
+   std::fseek(File, 0, SEEK_END);
+   long size = std::ftell(File);
+   std::fseek(File, 0, SEEK_SET);
+   Size = size > 0 ? (size_t)size : 0;
+}
+
+ImportFileStream::~ImportFileStream() {
+   std::fclose(File);
+}
+
+size_t ImportFileStream::Read(void* buffer, size_t size, size_t count) {
+   return std::fread(buffer, size, count, File);
+}
+
+size_t ImportFileStream::Write(const void* buffer, size_t size, size_t count) {
+   return std::fwrite(buffer, size, count, File);
+}
+
+aiReturn ImportFileStream::Seek(size_t offset, aiOrigin origin) {
+   int whence;
+   switch (origin) {
+      case aiOrigin_CUR: {
+         whence = SEEK_CUR;
+         break;
+      }
+      case aiOrigin_END: {
+         whence = SEEK_END;
+         break;
+      }
+      default: {
+         whence = SEEK_SET;
+         break;
+      }
+   }
+   return std::fseek(File, (long)offset, whence) == 0 ? aiReturn_SUCCESS : aiReturn_FAILURE;
+}
+
+size_t ImportFileStream::Tell() const {
+   return (size_t)std::ftell(File);
+}
+
+size_t ImportFileStream::FileSize() const {
+   return Size;
+}
+
+void ImportFileStream::Flush() {
+   std::fflush(File);
+}
+
+bool ImportFileSystem::Exists(const char* path) const {
+   std::FILE* file = std::fopen(path, "rb");
+   if (!file) {
+      return false;
+   }
+   std::fclose(file);
+   return true;
+}
+
+char ImportFileSystem::getOsSeparator() const {
+   return '/';
+}
+
+Assimp::IOStream* ImportFileSystem::Open(const char* path, const char* mode) {
+   std::FILE* file = std::fopen(path, mode);
+   if (!file) {
+      return nullptr;
+   }
+   // Assimp may open the same file more than once, e.g. to check its header before reading it.
+   if (mode[0] == 'r' && std::find(OpenedFiles.begin(), OpenedFiles.end(), path) == OpenedFiles.end()) {
+      OpenedFiles.emplace_back(path);
+   }
+   return new ImportFileStream(file);
+}
+
+void ImportFileSystem::Close(Assimp::IOStream* stream) {
+   delete stream;
+}
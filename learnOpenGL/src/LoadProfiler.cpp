@@ -0,0 +1,85 @@
+#include <iomanip>
+
+#include <glad/glad.h>
+
+#include "LoadProfiler.h"
+
+std::atomic<std::uint64_t> LoadProfiler::Nanoseconds[(int)LoadStage::COUNT];
+std::atomic<std::uint64_t> LoadProfiler::Bytes[(int)LoadStage::COUNT];
+std::atomic<std::uint32_t> LoadProfiler::Calls[(int)LoadStage::COUNT];
+std::atomic<bool> LoadProfiler::GpuSynchronized(false);
+
+static const char* STAGE_NAMES[(int)LoadStage::COUNT] = {
+   "cache load",
+   "assimp parse",
+   "processMesh",
+   "optimize",
+   "LOD generation",
+   "cluster build",
+   "cache save",
+   "texture decode",
+   "texture cache load",
+   "texture compress",
+   "texture upload",
+   "mipmap generation",
+   "mesh upload",
+   "total"
+};
+
+void LoadProfiler::add(LoadStage stage, std::uint64_t nanoseconds, std::uint64_t bytes) {
+   Nanoseconds[(int)stage] += nanoseconds;
+   Bytes[(int)stage] += bytes;
+   Calls[(int)stage]++;
+}
+
+LoadProfile LoadProfiler::getProfile() {
+   LoadProfile profile;
+   for (int i = 0; i < (int)LoadStage::COUNT; i++) {
+      profile.stages[i].milliseconds = Nanoseconds[i].load() / 1e6;
+      profile.stages[i].bytes = Bytes[i].load();
+      profile.stages[i].calls = Calls[i].load();
+   }
+   return profile;
+}
+
+void LoadProfiler::reset() {
+   for (int i = 0; i < (int)LoadStage::COUNT; i++) {
+      Nanoseconds[i] = 0;
+      Bytes[i] = 0;
+      Calls[i] = 0;
+   }
+}
+
+const char* LoadProfiler::getStageName(LoadStage stage) {
+   return STAGE_NAMES[(int)stage];
+}
+
+void LoadProfiler::printReport(std::ostream& stream, const LoadProfile& profile) {
+   stream << "LOAD PROFILE:\n";
+   for (int i = 0; i < (int)LoadStage::COUNT; i++) {
+      const LoadStageStats& stats = profile.stages[i];
+      if (stats.calls == 0) {
+         continue;
+      }
+      stream << "   " << std::left << std::setw(20) << STAGE_NAMES[i] << std::right << std::fixed << std::setprecision(2)
+         << std::setw(10) << stats.milliseconds << " ms" << std::setw(8) << stats.calls << " calls"
+         << std::setw(10) << stats.bytes / 1024 << " KB\n";
+   }
+   stream << std::defaultfloat << std::flush;
+}
+
+ScopedLoadTimer::ScopedLoadTimer(LoadStage stage, std::uint64_t bytes, bool gpuStage) :
+   Stage(stage),
+   Bytes(bytes),
+   GpuStage(gpuStage),
+   Start(std::chrono::steady_clock::now())
+   {
+}
+
+ScopedLoadTimer::~ScopedLoadTimer() {
+   if (GpuStage && LoadProfiler::isGpuSynchronized()) {
+      glFinish();
+   }
+   std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - Start;
+   LoadProfiler::add(Stage, (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), Bytes);
+}
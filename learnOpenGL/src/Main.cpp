@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
+#include <string>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,8 +11,16 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "GLStateCache.h"
 #include "Mesh.h"
+#include "LoadProfiler.h"
 #include "Model.h"
+#include "ModelLoader.h"
+#include "PixelUploadRing.h"
+#include "RenderQueue.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include "TextureStreamer.h"
 
 #include "OpenGLErrorHandling.h"
 
@@ -21,6 +30,10 @@
 #define WINDOW_WIDTH		800
 #define WINDOW_HEIGHT	600
 
+#define MODEL_LOD_LEVELS		3
+#define STATS_UPDATE_PERIOD	0.5f
+#define PICK_DISTANCE			100.0f
+
 static const char* WINDOW_TITLE = "learnOpenGL";
 
 static const char* OBJECT_VERTEX_SHADER_PATH = "res/shaders/modelShader.vert";
@@ -33,6 +46,14 @@ static Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 static float deltaTime = 0.0f;
 static float lastFrame = 0.0f;
 
+static bool lodEnabled = true;
+
+// The draws of every frame, sorted by the state they need before being submitted.
+static RenderQueue renderQueue;
+
+// The model instances, culled and picked through the hierarchy of their boxes.
+static Scene scene;
+
 /**
 	The callback for the glfw window resizing event.
  */
@@ -54,6 +75,16 @@ void scrollCallback(GLFWwindow* window, double xOffset, double yOffset);
  */
 void processInput(GLFWwindow* window);
 
+/**
+	Prints the GPU memory taken by the index buffers of the model.
+ */
+void printMemoryReport(const Model& model, const PixelUploadRing& uploadRing);
+
+/**
+	Shows the triangles submitted during the last frame in the title of the window.
+ */
+void updateWindowTitle(GLFWwindow* window);
+
 /**
 	updates the deltaTime every frame if the funcion is called in the game loop.
 */
@@ -101,15 +132,32 @@ int main(void) {
 
 	try {
 
-		Model model(MODEL_PATH);
+		// The textures are copied to the GPU through the ring, so the frames don't wait on the driver's copies.
+		PixelUploadRing uploadRing;
+		ModelLoader modelLoader(DEFLT_UPLOAD_BUDGET_MS, &uploadRing);
+		ModelLoadOptions modelOptions;
+		modelOptions.lodLevels = MODEL_LOD_LEVELS;
+		modelOptions.buildClusters = true;
+		modelOptions.compressTextures = true;
+		modelOptions.streamTextures = true;
+		TextureStreamer::getShared().setScreenHeight(WINDOW_HEIGHT);
+		TextureStreamer::getShared().setUploadRing(&uploadRing);
+		std::shared_ptr<ModelHandle> model = modelLoader.loadAsync(MODEL_PATH, modelOptions);
 
 		Shader shader(OBJECT_VERTEX_SHADER_PATH, OBJECT_FRAGMENT_SHADER_PATH);
 
+		bool memoryReported = false;
+
 		while (!glfwWindowShouldClose(window)) {
 
 			updateDeltaTime();
 			processInput(window);
 
+			RenderStats::reset();
+			GLStateCache::getShared().resetStats();
+
+			modelLoader.processUploads();
+
 			GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
 			float currentTime = (float)glfwGetTime();
@@ -124,11 +172,35 @@ int main(void) {
 			shader.setUniform("ViewMat", viewMat);
 			shader.setUniform("ProjectionMat", projectionMat);
 
-			model.draw(shader);
+			if (model->isReady()) {
+				if (scene.getInstanceCount() == 0) {
+					scene.addInstance(model->getModel(), modelMat);
+				}
+				if (lodEnabled) {
+					scene.enqueue(renderQueue, shader, camera, projectionMat);
+				}
+				else {
+					scene.enqueue(renderQueue, shader);
+				}
+				renderQueue.submit();
+
+				if (!memoryReported) {
+					printMemoryReport(model->getModel(), uploadRing);
+					LoadProfiler::printReport(std::cout, LoadProfiler::getProfile());
+					memoryReported = true;
+				}
+			}
+
+			// Loads the texture levels the frame's meshes asked for, for the next frames.
+			TextureStreamer::getShared().update();
+
+			updateWindowTitle(window);
 
 			glfwSwapBuffers(window);
 			glfwPollEvents();
 		}
+
+		TextureStreamer::getShared().setUploadRing(nullptr);
 	}
 	catch (const Shader::VertexShaderCompileError& e) {
 		std::cout << "VERTEX SHADER COMPILE ERROR:\n" << Shader::getInfoLogBuffer() << std::endl;
@@ -142,6 +214,10 @@ int main(void) {
 		std::cout << "SHADER PROGRAM LINK ERROR:\n" << Shader::getInfoLogBuffer() << std::endl;
 		mainReturnValue = EXIT_FAILURE;
 	}
+	catch (const Model::ModelImportFailure& e) {
+		std::cout << "MODEL IMPORT FAILURE\n";
+		mainReturnValue = EXIT_FAILURE;
+	}
 	catch (const Texture::TextureLoadingFailure & e) {
 		std::cout << "TEXTURE LOADING FAILURE\n";
 		mainReturnValue = EXIT_FAILURE;
@@ -157,6 +233,7 @@ int main(void) {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 	GLCall(glViewport(0, 0, width, height));
+	TextureStreamer::getShared().setScreenHeight(height);
 }
 
 void processInput(GLFWwindow* window) {
@@ -177,6 +254,40 @@ void processInput(GLFWwindow* window) {
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
 		camera.move(CameraMovement::RIGHT, deltaTime);
 	}
+
+	static bool lodKeyWasPressed = false;
+	bool lodKeyPressed = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+	if (lodKeyPressed && !lodKeyWasPressed) {
+		lodEnabled = !lodEnabled;
+	}
+	lodKeyWasPressed = lodKeyPressed;
+
+	static bool streamingKeyWasPressed = false;
+	bool streamingKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+	if (streamingKeyPressed && !streamingKeyWasPressed) {
+		TextureStreamer::getShared().printReport(std::cout);
+	}
+	streamingKeyWasPressed = streamingKeyPressed;
+
+	static bool queueKeyWasPressed = false;
+	bool queueKeyPressed = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+	if (queueKeyPressed && !queueKeyWasPressed) {
+		renderQueue.printReport(std::cout);
+	}
+	queueKeyWasPressed = queueKeyPressed;
+
+	static bool pickKeyWasPressed = false;
+	bool pickKeyPressed = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+	if (pickKeyPressed && !pickKeyWasPressed) {
+		ScenePick pick;
+		if (scene.pick(camera.getPosition(), camera.getFront(), PICK_DISTANCE, pick)) {
+			std::cout << "PICKED: instance " << pick.instance << ", mesh " << pick.mesh << " at " << pick.distance << std::endl;
+		}
+		else {
+			std::cout << "PICKED: nothing" << std::endl;
+		}
+	}
+	pickKeyWasPressed = pickKeyPressed;
 }
 
 void updateDeltaTime() {
@@ -185,6 +296,44 @@ void updateDeltaTime() {
 	lastFrame = currentFrame;
 }
 
+void printMemoryReport(const Model& model, const PixelUploadRing& uploadRing) {
+	IndexMemoryStats stats = model.getIndexMemoryStats();
+	std::cout << "INDEX BUFFERS: " << stats.meshCount << " meshes, " << stats.shortIndexMeshCount << " with 16 bit indices, "
+		<< stats.bytes / 1024 << " KB instead of " << stats.bytesAs32Bit / 1024 << " KB" << std::endl;
+	TextureCacheStats textureStats = TextureCache::getShared().getStats();
+	std::cout << "TEXTURE CACHE: " << textureStats.textureCount << " textures, " << textureStats.hits << " hits, "
+		<< textureStats.misses << " misses" << std::endl;
+	const PixelUploadStats& uploadStats = uploadRing.getStats();
+	std::cout << "PIXEL UPLOADS: " << uploadStats.uploads << " levels through the " << (uploadRing.isPersistent() ? "persistent" : "mapped per upload")
+		<< " ring, " << uploadStats.directUploads << " direct, " << uploadStats.bytes / (1024 * 1024) << " MB, "
+		<< uploadStats.stalls << " stalls for " << uploadStats.stallMilliseconds << " ms" << std::endl;
+}
+
+void updateWindowTitle(GLFWwindow* window) {
+
+	static float lastUpdate = 0.0f;
+	float currentTime = (float)glfwGetTime();
+	if (currentTime - lastUpdate < STATS_UPDATE_PERIOD) {
+		return;
+	}
+	lastUpdate = currentTime;
+
+	const FrameStats& stats = RenderStats::get();
+	std::string title = std::string(WINDOW_TITLE) + " | LOD and culling " + (lodEnabled ? "on" : "off") + " (L)"
+		+ " | " + std::to_string(stats.drawCalls) + " draws, " + std::to_string(stats.textureBinds) + " texture binds, " + std::to_string(stats.triangles) + " triangles"
+		+ ", " + std::to_string(stats.fullDetailTriangles) + " at full detail"
+		+ " | " + std::to_string(stats.meshesCulled) + "/" + std::to_string(stats.meshesVisible + stats.meshesCulled) + " meshes culled"
+		+ ", " + std::to_string(stats.clustersRejected) + "/" + std::to_string(stats.clustersTested) + " clusters culled";
+	TextureStreamingStats streaming = TextureStreamer::getShared().getStats();
+	title += " | textures " + std::to_string(streaming.usedBytes / (1024 * 1024)) + "/" + std::to_string(streaming.budget / (1024 * 1024)) + " MB, "
+		+ std::to_string(streaming.pendingRequests) + " pending (T)";
+	const RenderQueueStats& queueStats = renderQueue.getStats();
+	title += " | " + std::to_string(queueStats.sorted.getTotal()) + " state changes, " + std::to_string(queueStats.pushed.getTotal()) + " unsorted (Q)";
+	const GLStateStats& stateStats = GLStateCache::getShared().getStats();
+	title += " | " + std::to_string(stateStats.getIssued()) + " binds issued, " + std::to_string(stateStats.getElided()) + " elided";
+	glfwSetWindowTitle(window, title.c_str());
+}
+
 void mousePosCallback(GLFWwindow* window, double xPos, double yPos) {
 
 	static bool firstMouse = true;
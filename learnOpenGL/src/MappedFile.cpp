@@ -0,0 +1,122 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) :
+   Data(nullptr),
+   Size(0),
+   FileHandle(INVALID_HANDLE_VALUE),
+   MappingHandle(nullptr)
+   {
+   FileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (FileHandle == INVALID_HANDLE_VALUE) {
+      throw MappingFailure();
+   }
+
+   LARGE_INTEGER fileSize;
+   if (!GetFileSizeEx(FileHandle, &fileSize)) {
+      CloseHandle(FileHandle);
+      throw MappingFailure();
+   }
+   Size = (std::size_t)fileSize.QuadPart;
+   if (Size == 0) {
+      return;
+   }
+
+   MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (MappingHandle == nullptr) {
+      CloseHandle(FileHandle);
+      throw MappingFailure();
+   }
+
+   Data = (const unsigned char*)MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+   if (Data == nullptr) {
+      CloseHandle(MappingHandle);
+      CloseHandle(FileHandle);
+      throw MappingFailure();
+   }
+}
+
+MappedFile::~MappedFile() {
+   if (Data != nullptr) {
+      UnmapViewOfFile(Data);
+   }
+   if (MappingHandle != nullptr) {
+      CloseHandle(MappingHandle);
+   }
+   CloseHandle(FileHandle);
+}
+
+bool MappedFile::getFileInfo(const std::string& path, FileInfo& outInfo) {
+   WIN32_FILE_ATTRIBUTE_DATA attributes;
+   if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+      return false;
+   }
+   outInfo.size = ((std::uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+   outInfo.modificationTime = (std::int64_t)(((std::uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+   return true;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) :
+   Data(nullptr),
+   Size(0)
+   {
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd == -1) {
+      throw MappingFailure();
+   }
+
+   struct stat fileStat;
+   if (fstat(fd, &fileStat) == -1) {
+      close(fd);
+      throw MappingFailure();
+   }
+   Size = (std::size_t)fileStat.st_size;
+   if (Size == 0) {
+      close(fd);
+      return;
+   }
+
+   void* mapping = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+   // The mapping keeps its own reference to the file.
+   close(fd);
+   if (mapping == MAP_FAILED) {
+      throw MappingFailure();
+   }
+   Data = (const unsigned char*)mapping;
+}
+
+MappedFile::~MappedFile() {
+   if (Data != nullptr) {
+      munmap((void*)Data, Size);
+   }
+}
+
+bool MappedFile::getFileInfo(const std::string& path, FileInfo& outInfo) {
+   struct stat fileStat;
+   if (stat(path.c_str(), &fileStat) == -1) {
+      return false;
+   }
+   outInfo.size = (std::uint64_t)fileStat.st_size;
+#ifdef __APPLE__
+   outInfo.modificationTime = (std::int64_t)fileStat.st_mtimespec.tv_sec * 1000000000 + fileStat.st_mtimespec.tv_nsec;
+#else
+   outInfo.modificationTime = (std::int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+#endif
+   return true;
+}
+
+#endif
@@ -3,24 +3,286 @@
 #include <stb_image.h>
 
 #include "Mesh.h"
+#include "MeshArena.h"
+#include "MeshClusterizer.h"
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "LoadProfiler.h"
 #include "OpenGLErrorHandling.h"
+#include "RenderStats.h"
+#include "TextureData.h"
 
 static bool printed = false;
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) :
-   Vertices(vertices),
-   Indices(indices),
-   Textures(textures) 
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, VertexFormat format) :
+   Vertices(std::move(vertices)),
+   Indices(std::move(indices)),
+   Textures(std::move(textures)),
+   VAO(0),
+   VBO(0),
+   EBO(0),
+   Format(format),
+   IndexType(GL_UNSIGNED_INT),
+   BaseVertex(0)
    {
-   setupMesh();
+   Bounds = BoundingVolumes::compute(Vertices);
+   setupMesh(std::vector<std::vector<unsigned int>>());
 }
 
-void Mesh::draw(Shader& shader) {
+Mesh::Mesh(MeshData&& data, std::vector<Texture> textures, VertexFormat format) :
+   Vertices(std::move(data.Vertices)),
+   Indices(std::move(data.Indices)),
+   Textures(std::move(textures)),
+   VAO(0),
+   VBO(0),
+   EBO(0),
+   Format(format),
+   IndexType(GL_UNSIGNED_INT),
+   BaseVertex(0),
+   Clusters(std::move(data.Clusters)),
+   Bounds(data.Bounds)
+   {
+   setupMesh(data.LodIndices);
+}
+
+Mesh::Mesh(MeshData&& data, std::vector<Texture> textures, MeshArena& arena) :
+   Vertices(std::move(data.Vertices)),
+   Indices(std::move(data.Indices)),
+   Textures(std::move(textures)),
+   VAO(0),
+   VBO(0),
+   EBO(0),
+   Format(arena.getFormat()),
+   Clusters(std::move(data.Clusters)),
+   Bounds(data.Bounds)
+   {
+
+   ScratchArena& scratch = ScratchArena::getThreadLocal();
+   ScratchArena::Scope scratchScope(scratch);
+
+   PackedVertices packed = VertexPacker::pack(Vertices, Format, scratch);
+   PositionScale = packed.positionScale;
+   PositionOffset = packed.positionOffset;
+
+   initLods(data.LodIndices);
+   MeshArenaRange range = arena.append(packed, VertexPacker::packIndices(Indices, data.LodIndices, scratch));
+   BaseVertex = range.baseVertex;
+   IndexType = range.indexType;
+   placeLods(range.indexOffset, IndexType);
+}
+
+Mesh::Mesh(Mesh&& mesh) noexcept :
+   Vertices(std::move(mesh.Vertices)),
+   Indices(std::move(mesh.Indices)),
+   Textures(std::move(mesh.Textures)),
+   TextureLayers(std::move(mesh.TextureLayers)),
+   VAO(mesh.VAO),
+   VBO(mesh.VBO),
+   EBO(mesh.EBO),
+   Format(mesh.Format),
+   PositionScale(mesh.PositionScale),
+   PositionOffset(mesh.PositionOffset),
+   IndexType(mesh.IndexType),
+   BaseVertex(mesh.BaseVertex),
+   Lods(std::move(mesh.Lods)),
+   Clusters(std::move(mesh.Clusters)),
+   Bounds(mesh.Bounds)
+   {
+   mesh.VAO = 0;
+   mesh.VBO = 0;
+   mesh.EBO = 0;
+}
+
+Mesh::~Mesh() {
+   GLStateCache& state = GLStateCache::getShared();
+   if (VAO != 0) {
+      state.deleteVertexArrays(1, &VAO);
+   }
+   if (VBO != 0) {
+      state.deleteBuffers(1, &VBO);
+   }
+   if (EBO != 0) {
+      state.deleteBuffers(1, &EBO);
+   }
+}
+
+void Mesh::draw(Shader& shader, unsigned int lod, bool texturesBound) {
+
+   bindTextures(shader, !texturesBound);
+   setVertexFormatUniforms(shader);
+
+   const MeshLod& drawnLod = getLod(lod);
+
+   // The VAO is left bound, so the next draw of the same mesh doesn't bind it again.
+   GLStateCache::getShared().bindVertexArray(VAO);
+   GLCall(glDrawElements(GL_TRIANGLES, drawnLod.IndexCount, IndexType, (void*)drawnLod.IndexOffset));
+}
+
+void Mesh::drawInArena(Shader& shader, unsigned int lod, bool texturesBound) {
+
+   bindTextures(shader, !texturesBound);
+   setVertexFormatUniforms(shader);
+
+   const MeshLod& drawnLod = getLod(lod);
+
+   GLCall(glDrawElementsBaseVertex(GL_TRIANGLES, drawnLod.IndexCount, IndexType, (void*)drawnLod.IndexOffset, BaseVertex));
+}
+
+void Mesh::drawClusters(Shader& shader, const Frustum& frustum, const glm::vec3& cameraPosition, bool texturesBound) {
+
+   bindTextures(shader, !texturesBound);
+   setVertexFormatUniforms(shader);
+
+   if (VAO != 0) {
+      GLStateCache::getShared().bindVertexArray(VAO);
+   }
+
+   FrameStats& stats = RenderStats::get();
+   stats.fullDetailTriangles += Lods[0].IndexCount / 3;
+
+   // Runs of visible clusters are contiguous in the element buffer, so each run is a single draw.
+   size_t runOffset = 0;
+   unsigned int runCount = 0;
+   for (const MeshCluster& cluster : Clusters) {
+      stats.clustersTested++;
+      if (!frustum.intersectsSphere(cluster.Center, cluster.Radius) || MeshClusterizer::isBackFacing(cluster, cameraPosition)) {
+         stats.clustersRejected++;
+         if (runCount > 0) {
+            drawRange(runOffset, runCount);
+            runCount = 0;
+         }
+         continue;
+      }
+      if (runCount == 0) {
+         runOffset = cluster.IndexOffset;
+      }
+      runCount += cluster.IndexCount;
+   }
+   if (runCount > 0) {
+      drawRange(runOffset, runCount);
+   }
+}
+
+void Mesh::drawInstanced(Shader& shader, unsigned int instanceCount, unsigned int lod) {
+
+   bindTextures(shader);
+   setVertexFormatUniforms(shader);
+
+   const MeshLod& drawnLod = getLod(lod, instanceCount);
+
+   if (VAO != 0) {
+      GLStateCache::getShared().bindVertexArray(VAO);
+   }
+   if (BaseVertex != 0) {
+      GLCall(glDrawElementsInstancedBaseVertex(GL_TRIANGLES, drawnLod.IndexCount, IndexType, (void*)drawnLod.IndexOffset, instanceCount, BaseVertex));
+   }
+   else {
+      GLCall(glDrawElementsInstanced(GL_TRIANGLES, drawnLod.IndexCount, IndexType, (void*)drawnLod.IndexOffset, instanceCount));
+   }
+}
+
+void Mesh::attachInstanceBuffer(unsigned int instanceVBO) {
+   if (VAO == 0) {
+      return;
+   }
+   GLStateCache& state = GLStateCache::getShared();
+   state.bindVertexArray(VAO);
+   state.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+   VertexPacker::setupInstanceAttributes();
+   state.bindVertexArray(0);
+}
+
+void Mesh::drawRange(size_t indexOffset, unsigned int indexCount) {
+   FrameStats& stats = RenderStats::get();
+   stats.drawCalls++;
+   stats.triangles += indexCount / 3;
+
+   if (BaseVertex != 0) {
+      GLCall(glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, IndexType, (void*)indexOffset, BaseVertex));
+   }
+   else {
+      GLCall(glDrawElements(GL_TRIANGLES, indexCount, IndexType, (void*)indexOffset));
+   }
+}
+
+const MeshLod& Mesh::getLod(unsigned int lod, unsigned int instanceCount) const {
+   const MeshLod& drawnLod = Lods[lod < Lods.size() ? lod : Lods.size() - 1];
+
+   FrameStats& stats = RenderStats::get();
+   stats.drawCalls++;
+   stats.triangles += (size_t)drawnLod.IndexCount / 3 * instanceCount;
+   stats.fullDetailTriangles += (size_t)Lods[0].IndexCount / 3 * instanceCount;
+   return drawnLod;
+}
+
+IndexMemoryStats Mesh::getIndexMemoryStats() const {
+   IndexMemoryStats stats;
+   stats.meshCount = 1;
+   stats.shortIndexMeshCount = IndexType == GL_UNSIGNED_SHORT ? 1 : 0;
+   size_t indexCount = 0;
+   for (const MeshLod& lod : Lods) {
+      indexCount += lod.IndexCount;
+   }
+   stats.bytes = indexCount * (IndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+   stats.bytesAs32Bit = indexCount * sizeof(unsigned int);
+   return stats;
+}
+
+LodTriangleStats Mesh::getLodTriangleStats() const {
+   LodTriangleStats stats;
+   stats.fullDetailTriangles = Lods.front().IndexCount / 3;
+   stats.coarsestTriangles = Lods.back().IndexCount / 3;
+   return stats;
+}
+
+bool Mesh::hasSameTextures(const Mesh& other) const {
+   if (Textures.size() != other.Textures.size() || TextureLayers.size() != other.TextureLayers.size()) {
+      return false;
+   }
+   for (unsigned int i = 0; i < Textures.size(); i++) {
+      if (Textures[i].Id != other.Textures[i].Id) {
+         return false;
+      }
+   }
+   // The arrays bound for the whole model don't count, only those the mesh binds itself.
+   for (unsigned int i = 0; i < TextureLayers.size(); i++) {
+      if (TextureLayers[i].SharedUnit && TextureLayers[i].ArrayId != other.TextureLayers[i].ArrayId) {
+         return false;
+      }
+   }
+   return true;
+}
+
+void Mesh::bindTextures(Shader& shader, bool bind) {
    
+   GLStateCache& state = GLStateCache::getShared();
    unsigned int diffuseNum = 1;
    unsigned int specularNum = 1;
+   for (const TextureLayer& layer : TextureLayers) {
+      std::string number;
+      if (layer.type == "texture_diffuse") {
+         number = std::to_string(diffuseNum++);
+      }
+      if (layer.type == "texture_specular") {
+         number = std::to_string(specularNum++);
+      }
+      try {
+         shader.setUniform(layer.type + number, layer.Unit);
+         shader.setUniform(layer.type + number + "_layer", layer.Layer);
+      }
+      catch (const Shader::InvalidUniformLocation & e) {
+         if (!printed) {
+            std::cout << "Invalid uniform location: " << layer.type + number << std::endl;
+            printed = true;
+         }
+      }
+      if (bind && layer.SharedUnit) {
+         state.bindTexture(layer.Unit, GL_TEXTURE_2D_ARRAY, layer.ArrayId);
+         RenderStats::get().textureBinds++;
+      }
+   }
+
    for (unsigned int i = 0; i < Textures.size(); i++) {
-      GLCall(glActiveTexture(GL_TEXTURE0 + i));
       std::string number;
       std::string name = Textures[i].type;
       if (name == "texture_diffuse") {
@@ -38,60 +300,127 @@ void Mesh::draw(Shader& shader) {
             printed = true;
          }
       }
-      GLCall(glBindTexture(GL_TEXTURE_2D, Textures[i].Id));
+      if (bind) {
+         state.bindTexture(i, GL_TEXTURE_2D, Textures[i].Id);
+         RenderStats::get().textureBinds++;
+      }
    }
-   GLCall(glActiveTexture(GL_TEXTURE0));
+}
 
-   // draw mesh
-   GLCall(glBindVertexArray(VAO));
-   GLCall(glDrawElements(GL_TRIANGLES, Indices.size(), GL_UNSIGNED_INT, 0));
-   GLCall(glBindVertexArray(VAO));
+void Mesh::setVertexFormatUniforms(Shader& shader) {
+   // Shaders that don't read the vertex attributes this way simply don't have the uniforms.
+   try {
+      shader.setUniform("PositionScale", PositionScale);
+      shader.setUniform("PositionOffset", PositionOffset);
+      shader.setUniform("OctahedralNormals", VertexPacker::hasOctahedralNormals(Format));
+   }
+   catch (const Shader::InvalidUniformLocation & e) {
+   }
+}
+
+void Mesh::initLods(const std::vector<std::vector<unsigned int>>& lodIndices) {
+   Lods.clear();
+   Lods.reserve(1 + lodIndices.size());
+   Lods.push_back({ 0, (unsigned int)Indices.size() });
+   size_t indexOffset = Indices.size();
+   for (const std::vector<unsigned int>& lod : lodIndices) {
+      Lods.push_back({ indexOffset, (unsigned int)lod.size() });
+      indexOffset += lod.size();
+   }
 }
 
-void Mesh::setupMesh() {
+void Mesh::placeLods(size_t baseOffset, unsigned int indexType) {
+   size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+   for (MeshLod& lod : Lods) {
+      lod.IndexOffset = baseOffset + lod.IndexOffset * indexSize;
+   }
+   for (MeshCluster& cluster : Clusters) {
+      cluster.IndexOffset = (unsigned int)(baseOffset + cluster.IndexOffset * indexSize);
+   }
+}
+
+void Mesh::setupMesh(const std::vector<std::vector<unsigned int>>& lodIndices) {
+   ScopedLoadTimer timer(LoadStage::MESH_UPLOAD, 0, true);
+   ScratchArena& scratch = ScratchArena::getThreadLocal();
+   ScratchArena::Scope scratchScope(scratch);
+
+   PackedVertices packed = VertexPacker::pack(Vertices, Format, scratch);
+   PositionScale = packed.positionScale;
+   PositionOffset = packed.positionOffset;
+
    GLCall(glGenVertexArrays(1, &VAO));
    GLCall(glGenBuffers(1, &VBO));
    GLCall(glGenBuffers(1, &EBO));
 
-   GLCall(glBindVertexArray(VAO));
+   GLStateCache& state = GLStateCache::getShared();
+   state.bindVertexArray(VAO);
 
-   GLCall(glBindBuffer(GL_ARRAY_BUFFER, VBO));
-   GLCall(glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(Vertex), &Vertices[0], GL_STATIC_DRAW));
+   state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+   GLCall(glBufferData(GL_ARRAY_BUFFER, packed.size, packed.data, GL_STATIC_DRAW));
    
-   GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO));
-   GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned int), &Indices[0], GL_STATIC_DRAW));
+   PackedIndices packedIndices = VertexPacker::packIndices(Indices, lodIndices, scratch);
+   IndexType = packedIndices.type;
+   initLods(lodIndices);
+   placeLods(0, IndexType);
+   state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+   GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, packedIndices.size, packedIndices.data, GL_STATIC_DRAW));
+   timer.addBytes(packed.size + packedIndices.size);
 
-   // Vertex positions
-   GLCall(glEnableVertexAttribArray(0));
-   GLCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position)));
-   //Vertex normals
-   GLCall(glEnableVertexAttribArray(1));
-   GLCall(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal)));
-   // Vertex texture coords
-   GLCall(glEnableVertexAttribArray(2));
-   GLCall(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords)));
+   VertexPacker::setupAttributes(Format);
 
-   GLCall(glBindVertexArray(0));
+   state.bindVertexArray(0);
 }
 
-Texture::Texture(const std::string& path, const std::string& directory, const std::string& typeName) 
+Texture::Texture(const std::string& path, const std::string& directory, const std::string& typeName) :
+   Texture(path, typeName, TextureImage::load(directory + '/' + path))
+   {
+}
+
+Texture::Texture(const std::string& path, const std::string& typeName, const TextureImage& image)
    :
-   path(path),
-   type(typeName)
+   type(typeName),
+   path(path)
    {
+   upload(image);
+}
 
-   std::string fileName = directory + '/' + path;
+Texture::Texture(const std::string& path, const std::string& typeName, const TextureData& data, unsigned int firstLevel, PixelUploadRing* ring)
+   :
+   type(typeName),
+   path(path)
+   {
 
-   stbi_set_flip_vertically_on_load(true);
+   if (data.isCompressed() && !TextureCompressor::isSupported(data.Format)) {
+      const TextureLevel& level = data.Levels[0];
+      upload(TextureCompressor::decompress(data.Format, level.Width, level.Height, level.Data));
+      return;
+   }
 
-   int width, height, nrComponents;
-   unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &nrComponents, 0);
-   if (data == nullptr) {
-      throw TextureLoadingFailure();
+   {
+      // The mip chain was built when the texture was cooked, so there is nothing to generate.
+      ScopedLoadTimer timer(LoadStage::TEXTURE_UPLOAD, 0, true);
+      GLCall(glGenTextures(1, &Id));
+      GLStateCache::getShared().bindTexture(GL_TEXTURE_2D, Id);
+      for (unsigned int i = firstLevel; i < data.Levels.size(); i++) {
+         data.uploadLevel(i, ring);
+         timer.addBytes(data.Levels[i].Size);
+      }
+      // The levels before the first one are left undefined, which the base level makes the texture ignore.
+      GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)firstLevel));
+      GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)data.Levels.size() - 1));
+   }
+
+   if (data.isCompressed() ? data.Format == BlockFormat::BC4 : data.Components == 1) {
+      GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
+      GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
    }
+   setSamplingParameters();
+}
+
+void Texture::upload(const TextureImage& image) {
 
    GLenum format;
-   switch (nrComponents) {
+   switch (image.Components) {
       case 1: {
          format = GL_RED;
          break;
@@ -109,16 +438,40 @@ Texture::Texture(const std::string& path, const std::string& directory, const st
       }
    }
 
-   GLCall(glGenTextures(1, &Id));
-   GLCall(glBindTexture(GL_TEXTURE_2D, Id));
-   GLCall(glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data));
-   GLCall(glGenerateMipmap(GL_TEXTURE_2D));
+   std::uint64_t imageSize = (std::uint64_t)image.Width * image.Height * image.Components;
+   {
+      ScopedLoadTimer timer(LoadStage::TEXTURE_UPLOAD, imageSize, true);
+      GLCall(glGenTextures(1, &Id));
+      GLStateCache::getShared().bindTexture(GL_TEXTURE_2D, Id);
+      GLCall(glTexImage2D(GL_TEXTURE_2D, 0, format, image.Width, image.Height, 0, format, GL_UNSIGNED_BYTE, image.Pixels.get()));
+   }
+   {
+      // The mip chain adds up to a third of the base level.
+      ScopedLoadTimer timer(LoadStage::MIPMAP_GENERATION, imageSize / 3, true);
+      GLCall(glGenerateMipmap(GL_TEXTURE_2D));
+   }
+   setSamplingParameters();
+}
 
+void Texture::setSamplingParameters() {
    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
    GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+}
+
+TextureImage TextureImage::load(const std::string& fileName) {
 
-   stbi_image_free(data);
-   data = nullptr;
+   // The flag is thread local so images can be decoded on several threads at once.
+   stbi_set_flip_vertically_on_load_thread(true);
+
+   ScopedLoadTimer timer(LoadStage::TEXTURE_DECODE);
+   TextureImage image;
+   unsigned char* data = stbi_load(fileName.c_str(), &image.Width, &image.Height, &image.Components, 0);
+   if (data == nullptr) {
+      throw Texture::TextureLoadingFailure();
+   }
+   image.Pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+   timer.addBytes((std::uint64_t)image.Width * image.Height * image.Components);
+   return image;
 }
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "GLStateCache.h"
+#include "LoadProfiler.h"
+#include "MeshArena.h"
+#include "OpenGLErrorHandling.h"
+
+// 32 bit indices are kept 4 byte aligned after a mesh with an odd number of 16 bit indices.
+#define INDEX_ALIGNMENT sizeof(unsigned int)
+
+MeshArena::MeshArena(VertexFormat format, std::size_t vertexCapacity, std::size_t indexCapacityBytes) :
+   VAO(0),
+   VBO(0),
+   EBO(0),
+   Format(format),
+   VertexCapacity(vertexCapacity),
+   IndexCapacityBytes(indexCapacityBytes),
+   VertexCount(0),
+   IndexBytes(0)
+   {
+   GLCall(glGenVertexArrays(1, &VAO));
+   GLCall(glGenBuffers(1, &VBO));
+   GLCall(glGenBuffers(1, &EBO));
+
+   GLStateCache& state = GLStateCache::getShared();
+   state.bindVertexArray(VAO);
+
+   state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+   GLCall(glBufferData(GL_ARRAY_BUFFER, VertexCapacity * VertexPacker::getStride(Format), nullptr, GL_STATIC_DRAW));
+
+   state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+   GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexCapacityBytes, nullptr, GL_STATIC_DRAW));
+
+   VertexPacker::setupAttributes(Format);
+
+   state.bindVertexArray(0);
+}
+
+MeshArena::~MeshArena() {
+   GLStateCache& state = GLStateCache::getShared();
+   state.deleteVertexArrays(1, &VAO);
+   state.deleteBuffers(1, &VBO);
+   state.deleteBuffers(1, &EBO);
+}
+
+MeshArenaRange MeshArena::append(const PackedVertices& packedVertices, const PackedIndices& packedIndices) {
+
+   std::size_t stride = VertexPacker::getStride(Format);
+   std::size_t vertexCount = packedVertices.size / stride;
+   std::size_t indexOffset = (IndexBytes + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+   if (VertexCount + vertexCount > VertexCapacity || indexOffset + packedIndices.size > IndexCapacityBytes) {
+      throw ArenaFull();
+   }
+
+   MeshArenaRange range;
+   range.baseVertex = (int)VertexCount;
+   range.indexOffset = indexOffset;
+   range.indexType = packedIndices.type;
+
+   ScopedLoadTimer timer(LoadStage::MESH_UPLOAD, packedVertices.size + packedIndices.size, true);
+
+   // The arena's element buffer is attached to its VAO, so it's updated through the VAO
+   // to leave the element buffer binding of any other VAO untouched.
+   GLStateCache& state = GLStateCache::getShared();
+   state.bindVertexArray(VAO);
+   state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+   GLCall(glBufferSubData(GL_ARRAY_BUFFER, VertexCount * stride, packedVertices.size, packedVertices.data));
+   GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset, packedIndices.size, packedIndices.data));
+   state.bindVertexArray(0);
+
+   VertexCount += vertexCount;
+   IndexBytes = indexOffset + packedIndices.size;
+   return range;
+}
+
+std::size_t MeshArena::getIndexCapacity(const std::vector<MeshData>& meshesData) {
+   std::size_t capacity = 0;
+   for (const MeshData& meshData : meshesData) {
+      capacity = (capacity + INDEX_ALIGNMENT - 1) / INDEX_ALIGNMENT * INDEX_ALIGNMENT;
+      // The levels of detail only reference vertices of the full detail mesh, so they pack the same way.
+      std::size_t indexCount = meshData.Indices.size();
+      for (const std::vector<unsigned int>& lod : meshData.LodIndices) {
+         indexCount += lod.size();
+      }
+      capacity += indexCount * VertexPacker::getPackedIndexSize(meshData.Indices);
+   }
+   return capacity;
+}
+
+void MeshArena::bind() const {
+   GLStateCache::getShared().bindVertexArray(VAO);
+}
+
+void MeshArena::attachInstanceBuffer(unsigned int instanceVBO) {
+   GLStateCache& state = GLStateCache::getShared();
+   state.bindVertexArray(VAO);
+   state.bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+   VertexPacker::setupInstanceAttributes();
+   state.bindVertexArray(0);
+}
@@ -0,0 +1,103 @@
+#include "MeshClusterizer.h"
+
+// Clusters whose normals spread this much or more are never considered back-facing.
+#define MIN_CONE_SPREAD_COS 0.1f
+
+void MeshClusterizer::buildClusters(MeshData& mesh, std::size_t maxVertices, std::size_t maxTriangles) {
+
+   mesh.Clusters.clear();
+   const std::vector<unsigned int>& indices = mesh.Indices;
+
+   // The cluster in which each vertex was last counted, offset by one so 0 means none.
+   std::vector<unsigned int> vertexCluster(mesh.Vertices.size(), 0);
+
+   MeshCluster cluster = {};
+   std::size_t clusterVertexCount = 0;
+   for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+      unsigned int clusterTag = (unsigned int)mesh.Clusters.size() + 1;
+      std::size_t newVertices = 0;
+      for (int c = 0; c < 3; c++) {
+         if (vertexCluster[indices[t + c]] != clusterTag) {
+            newVertices++;
+         }
+      }
+
+      if (cluster.IndexCount > 0 &&
+         (clusterVertexCount + newVertices > maxVertices || cluster.IndexCount / 3 >= maxTriangles)) {
+         computeClusterBounds(cluster, mesh.Vertices, indices);
+         mesh.Clusters.push_back(cluster);
+
+         cluster = MeshCluster();
+         cluster.IndexOffset = (unsigned int)t;
+         clusterVertexCount = 0;
+         clusterTag++;
+      }
+
+      for (int c = 0; c < 3; c++) {
+         if (vertexCluster[indices[t + c]] != clusterTag) {
+            vertexCluster[indices[t + c]] = clusterTag;
+            clusterVertexCount++;
+         }
+      }
+      cluster.IndexCount += 3;
+   }
+
+   if (cluster.IndexCount > 0) {
+      computeClusterBounds(cluster, mesh.Vertices, indices);
+      mesh.Clusters.push_back(cluster);
+   }
+}
+
+void MeshClusterizer::computeClusterBounds(MeshCluster& cluster, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+
+   std::size_t begin = cluster.IndexOffset;
+   std::size_t end = begin + cluster.IndexCount;
+
+   glm::vec3 minPosition = vertices[indices[begin]].Position;
+   glm::vec3 maxPosition = minPosition;
+   for (std::size_t i = begin; i < end; i++) {
+      minPosition = glm::min(minPosition, vertices[indices[i]].Position);
+      maxPosition = glm::max(maxPosition, vertices[indices[i]].Position);
+   }
+   cluster.Center = (minPosition + maxPosition) * 0.5f;
+   float radiusSquared = 0.0f;
+   for (std::size_t i = begin; i < end; i++) {
+      glm::vec3 offset = vertices[indices[i]].Position - cluster.Center;
+      radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+   }
+   cluster.Radius = glm::sqrt(radiusSquared);
+
+   // The cone axis is the average of the triangle normals, its spread the widest of them.
+   std::vector<glm::vec3> normals;
+   normals.reserve(cluster.IndexCount / 3);
+   glm::vec3 axis(0.0f);
+   for (std::size_t t = begin; t + 2 < end; t += 3) {
+      const glm::vec3& p0 = vertices[indices[t]].Position;
+      const glm::vec3& p1 = vertices[indices[t + 1]].Position;
+      const glm::vec3& p2 = vertices[indices[t + 2]].Position;
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float length = glm::length(normal);
+      if (length > 0.0f) {
+         normals.push_back(normal / length);
+         axis += normals.back();
+      }
+   }
+
+   cluster.ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+   cluster.ConeCutoff = 1.0f;
+   float axisLength = glm::length(axis);
+   if (normals.empty() || axisLength == 0.0f) {
+      return;
+   }
+   axis /= axisLength;
+
+   float minCos = 1.0f;
+   for (const glm::vec3& normal : normals) {
+      minCos = glm::min(minCos, glm::dot(axis, normal));
+   }
+   cluster.ConeAxis = axis;
+   if (minCos > MIN_CONE_SPREAD_COS) {
+      // Every triangle faces away once the view direction is within 90 degrees minus the spread of the axis.
+      cluster.ConeCutoff = glm::sqrt(1.0f - minCos * minCos);
+   }
+}
@@ -0,0 +1,358 @@
+#include <algorithm>
+
+#include "MeshOptimizer.h"
+
+/**
+   FIFO post-transform vertex cache simulation.
+   A vertex is in the cache if fewer than cacheSize misses happened since it was transformed.
+ */
+struct VertexCacheSimulator {
+   std::vector<unsigned int> cachedAt;
+   unsigned int cacheSize;
+   unsigned int time;
+
+   VertexCacheSimulator(std::size_t vertexCount, unsigned int cacheSize) :
+      cachedAt(vertexCount, 0),
+      cacheSize(cacheSize),
+      time(cacheSize + 1)
+      {
+   }
+
+   /**
+      Simulates the transform of a vertex.
+      @return 1 if it was a cache miss, 0 otherwise.
+    */
+   inline unsigned int access(unsigned int vertex) {
+      if (time - cachedAt[vertex] > cacheSize) {
+         cachedAt[vertex] = time++;
+         return 1;
+      }
+      return 0;
+   }
+
+   /**
+      Simulates the transform of a triangle.
+      @return the number of cache misses.
+    */
+   inline unsigned int accessTriangle(const unsigned int* triangle) {
+      return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+   }
+
+   /**
+      Empties the cache.
+    */
+   inline void flush() {
+      time += cacheSize + 1;
+   }
+};
+
+MeshOptimizationStats MeshOptimizer::optimize(MeshData& mesh) {
+   MeshOptimizationStats stats;
+   stats.before = analyzeVertexCache(mesh.Indices, mesh.Vertices.size());
+
+   optimizeVertexCache(mesh.Indices, mesh.Vertices.size());
+   optimizeOverdraw(mesh.Indices, mesh.Vertices);
+   optimizeVertexFetch(mesh.Vertices, mesh.Indices);
+
+   stats.after = analyzeVertexCache(mesh.Indices, mesh.Vertices.size());
+   return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices, std::size_t vertexCount, unsigned int cacheSize) {
+
+   std::size_t triangleCount = indices.size() / 3;
+   if (triangleCount == 0 || indices.size() % 3 != 0) {
+      return;
+   }
+
+   // Triangles adjacent to every vertex, and how many of them haven't been emitted yet.
+   std::vector<unsigned int> liveCount(vertexCount, 0);
+   for (unsigned int index : indices) {
+      liveCount[index]++;
+   }
+   std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+   for (std::size_t v = 0; v < vertexCount; v++) {
+      adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCount[v];
+   }
+   std::vector<unsigned int> adjacency(triangleCount * 3);
+   std::vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+   for (std::size_t t = 0; t < triangleCount; t++) {
+      for (int c = 0; c < 3; c++) {
+         adjacency[adjacencyFill[indices[t * 3 + c]]++] = (unsigned int)t;
+      }
+   }
+
+   std::vector<unsigned int> cacheTime(vertexCount, 0);
+   std::vector<bool> emitted(triangleCount, false);
+   std::vector<unsigned int> deadEnd;
+   std::vector<unsigned int> candidates;
+   std::vector<unsigned int> result;
+   result.reserve(triangleCount * 3);
+   unsigned int time = cacheSize + 1;
+   std::size_t scanCursor = 0;
+
+   // Finds a vertex to restart from when none of the candidates is worth fanning around.
+   auto skipDeadEnd = [&]() -> long long {
+      while (!deadEnd.empty()) {
+         unsigned int vertex = deadEnd.back();
+         deadEnd.pop_back();
+         if (liveCount[vertex] > 0) {
+            return vertex;
+         }
+      }
+      while (scanCursor < vertexCount) {
+         if (liveCount[scanCursor] > 0) {
+            return (long long)scanCursor;
+         }
+         scanCursor++;
+      }
+      return -1;
+   };
+
+   long long fanning = skipDeadEnd();
+   while (fanning >= 0) {
+
+      candidates.clear();
+      for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+         unsigned int triangle = adjacency[a];
+         if (emitted[triangle]) {
+            continue;
+         }
+         for (int c = 0; c < 3; c++) {
+            unsigned int vertex = indices[triangle * 3 + c];
+            result.push_back(vertex);
+            deadEnd.push_back(vertex);
+            candidates.push_back(vertex);
+            liveCount[vertex]--;
+            if (time - cacheTime[vertex] > cacheSize) {
+               cacheTime[vertex] = time++;
+            }
+         }
+         emitted[triangle] = true;
+      }
+
+      // Prefer the candidate that entered the cache earliest but will still be in it after
+      // all its remaining triangles are emitted.
+      long long next = -1;
+      unsigned int bestPriority = 0;
+      for (unsigned int vertex : candidates) {
+         if (liveCount[vertex] == 0) {
+            continue;
+         }
+         unsigned int priority = 0;
+         if (time - cacheTime[vertex] + 2 * liveCount[vertex] <= cacheSize) {
+            priority = time - cacheTime[vertex];
+         }
+         if (priority > bestPriority) {
+            bestPriority = priority;
+            next = vertex;
+         }
+      }
+      fanning = next >= 0 ? next : skipDeadEnd();
+   }
+
+   indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold, unsigned int cacheSize) {
+
+   std::size_t triangleCount = indices.size() / 3;
+   if (triangleCount == 0 || indices.size() % 3 != 0) {
+      return;
+   }
+
+   // Hard boundaries: a triangle that misses the cache on all its vertices usually starts a
+   // disjoint patch of the mesh.
+   std::vector<std::size_t> hardClusters;
+   VertexCacheSimulator cache(vertices.size(), cacheSize);
+   for (std::size_t t = 0; t < triangleCount; t++) {
+      if (cache.accessTriangle(&indices[t * 3]) == 3 || t == 0) {
+         hardClusters.push_back(t);
+      }
+   }
+   hardClusters.push_back(triangleCount);
+
+   // Soft boundaries: split the patches further wherever the cache efficiency of the part so
+   // far stays within the threshold of the whole patch's, even with a cold cache.
+   std::vector<std::size_t> clusters;
+   for (std::size_t h = 0; h + 1 < hardClusters.size(); h++) {
+      std::size_t start = hardClusters[h];
+      std::size_t end = hardClusters[h + 1];
+
+      cache.flush();
+      unsigned int clusterMisses = 0;
+      for (std::size_t t = start; t < end; t++) {
+         clusterMisses += cache.accessTriangle(&indices[t * 3]);
+      }
+      float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+      cache.flush();
+      clusters.push_back(start);
+      std::size_t softStart = start;
+      unsigned int runningMisses = 0;
+      for (std::size_t t = start; t < end; t++) {
+         runningMisses += cache.accessTriangle(&indices[t * 3]);
+         if (t + 1 < end && (float)runningMisses / (float)(t - softStart + 1) <= clusterThreshold) {
+            clusters.push_back(t + 1);
+            softStart = t + 1;
+            runningMisses = 0;
+            cache.flush();
+         }
+      }
+   }
+   clusters.push_back(triangleCount);
+
+   // Sort the clusters by how much they face away from the center of the mesh: those are the
+   // ones that are the most likely to occlude the rest.
+   glm::vec3 meshCentroid(0.0f);
+   for (const Vertex& vertex : vertices) {
+      meshCentroid += vertex.Position;
+   }
+   meshCentroid /= (float)std::max<std::size_t>(vertices.size(), 1);
+
+   std::size_t clusterCount = clusters.size() - 1;
+   std::vector<float> sortKeys(clusterCount);
+   for (std::size_t c = 0; c < clusterCount; c++) {
+      glm::vec3 centroid(0.0f);
+      glm::vec3 normal(0.0f);
+      float area = 0.0f;
+      for (std::size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+         const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+         const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+         const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+         glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+         float triangleArea = glm::length(areaNormal);
+         centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+         normal += areaNormal;
+         area += triangleArea;
+      }
+      float normalLength = glm::length(normal);
+      if (area > 0.0f && normalLength > 0.0f) {
+         sortKeys[c] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+      }
+      else {
+         sortKeys[c] = 0.0f;
+      }
+   }
+
+   std::vector<std::size_t> order(clusterCount);
+   for (std::size_t c = 0; c < clusterCount; c++) {
+      order[c] = c;
+   }
+   std::stable_sort(order.begin(), order.end(), [&sortKeys](std::size_t a, std::size_t b) {
+      return sortKeys[a] > sortKeys[b];
+   });
+
+   std::vector<unsigned int> result;
+   result.reserve(indices.size());
+   for (std::size_t c : order) {
+      result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+   }
+   indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+
+   if (indices.size() % 3 != 0) {
+      return;
+   }
+
+   const unsigned int unused = ~0u;
+   std::vector<unsigned int> remap(vertices.size(), unused);
+   unsigned int nextVertex = 0;
+   for (unsigned int& index : indices) {
+      if (remap[index] == unused) {
+         remap[index] = nextVertex++;
+      }
+      index = remap[index];
+   }
+
+   std::vector<Vertex> result(nextVertex);
+   for (std::size_t v = 0; v < vertices.size(); v++) {
+      if (remap[v] != unused) {
+         result[remap[v]] = vertices[v];
+      }
+   }
+   vertices.swap(result);
+}
+
+void MeshOptimizer::splitMesh(MeshData& mesh, std::vector<MeshData>& outMeshes, std::size_t maxVertices) {
+
+   if (mesh.Vertices.size() <= maxVertices) {
+      outMeshes.push_back(std::move(mesh));
+      return;
+   }
+
+   const unsigned int unused = ~0u;
+   std::vector<unsigned int> remap(mesh.Vertices.size(), unused);
+   std::vector<unsigned int> partVertices;
+   MeshData part;
+
+   auto flushPart = [&]() {
+      for (unsigned int vertex : partVertices) {
+         part.Vertices.push_back(mesh.Vertices[vertex]);
+         remap[vertex] = unused;
+      }
+      part.Textures = mesh.Textures;
+      part.Node = mesh.Node;
+      part.Bounds = BoundingVolumes::compute(part.Vertices);
+      outMeshes.push_back(std::move(part));
+      part = MeshData();
+      partVertices.clear();
+   };
+
+   for (std::size_t t = 0; t + 2 < mesh.Indices.size(); t += 3) {
+      std::size_t newVertices = 0;
+      for (int c = 0; c < 3; c++) {
+         unsigned int vertex = mesh.Indices[t + c];
+         // A degenerate triangle may reference a new vertex more than once.
+         bool repeated = (c > 0 && mesh.Indices[t] == vertex) || (c > 1 && mesh.Indices[t + 1] == vertex);
+         if (remap[vertex] == unused && !repeated) {
+            newVertices++;
+         }
+      }
+      if (partVertices.size() + newVertices > maxVertices) {
+         flushPart();
+      }
+      for (int c = 0; c < 3; c++) {
+         unsigned int vertex = mesh.Indices[t + c];
+         if (remap[vertex] == unused) {
+            remap[vertex] = (unsigned int)partVertices.size();
+            partVertices.push_back(vertex);
+         }
+         part.Indices.push_back(remap[vertex]);
+      }
+   }
+   if (!part.Indices.empty()) {
+      flushPart();
+   }
+   mesh = MeshData();
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const std::vector<unsigned int>& indices, std::size_t vertexCount, unsigned int cacheSize) {
+
+   VertexCacheStats stats = {};
+   stats.triangleCount = indices.size() / 3;
+
+   VertexCacheSimulator cache(vertexCount, cacheSize);
+   std::vector<bool> referenced(vertexCount, false);
+   for (std::size_t i = 0; i < stats.triangleCount * 3; i++) {
+      stats.transformedCount += cache.access(indices[i]);
+      if (!referenced[indices[i]]) {
+         referenced[indices[i]] = true;
+         stats.vertexCount++;
+      }
+   }
+
+   stats.acmr = stats.triangleCount == 0 ? 0.0f : (float)stats.transformedCount / (float)stats.triangleCount;
+   stats.atvr = stats.vertexCount == 0 ? 0.0f : (float)stats.transformedCount / (float)stats.vertexCount;
+   return stats;
+}
+
+void MeshOptimizer::accumulate(VertexCacheStats& total, const VertexCacheStats& stats) {
+   total.triangleCount += stats.triangleCount;
+   total.vertexCount += stats.vertexCount;
+   total.transformedCount += stats.transformedCount;
+   total.acmr = total.triangleCount == 0 ? 0.0f : (float)total.transformedCount / (float)total.triangleCount;
+   total.atvr = total.vertexCount == 0 ? 0.0f : (float)total.transformedCount / (float)total.vertexCount;
+}
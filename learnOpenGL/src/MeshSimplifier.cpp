@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#include "MeshSimplifier.h"
+
+// A collapse may turn a triangle by at most about 75 degrees, and not make it thinner than this.
+#define MAX_NORMAL_ROTATION_COS 0.25f
+#define MIN_TRIANGLE_ASPECT     1e-3f
+
+/**
+   The sum of the squared distances to a set of planes, as a symmetric 4x4 matrix.
+ */
+struct Quadric {
+   double a00, a01, a02, a11, a12, a22;
+   double b0, b1, b2;
+   double c;
+
+   Quadric() :
+      a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0) {
+   }
+
+   /**
+      Creates the quadric of the plane with the indicated unit normal that goes through the point.
+    */
+   Quadric(const glm::vec3& normal, const glm::vec3& point) {
+      double nx = normal.x;
+      double ny = normal.y;
+      double nz = normal.z;
+      double d = -(nx * point.x + ny * point.y + nz * point.z);
+      a00 = nx * nx; a01 = nx * ny; a02 = nx * nz;
+      a11 = ny * ny; a12 = ny * nz;
+      a22 = nz * nz;
+      b0 = nx * d; b1 = ny * d; b2 = nz * d;
+      c = d * d;
+   }
+
+   inline Quadric& operator+=(const Quadric& q) {
+      a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+      b0 += q.b0; b1 += q.b1; b2 += q.b2;
+      c += q.c;
+      return *this;
+   }
+
+   /**
+      Gets the sum of the squared distances from the point to the planes.
+    */
+   inline double evaluate(const glm::vec3& p) const {
+      double x = p.x;
+      double y = p.y;
+      double z = p.z;
+      double result = a00 * x * x + a11 * y * y + a22 * z * z
+         + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+         + 2.0 * (b0 * x + b1 * y + b2 * z)
+         + c;
+      return result > 0.0 ? result : 0.0;
+   }
+};
+
+struct PositionHash {
+   inline size_t operator()(const glm::vec3& p) const {
+      std::uint32_t bits[3];
+      std::memcpy(bits, &p, sizeof(bits));
+      return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+   }
+};
+
+struct VertexHash {
+   inline size_t operator()(const Vertex& v) const {
+      return PositionHash()(v.Position) ^ PositionHash()(v.Normal) * 31u;
+   }
+};
+
+struct VertexEqual {
+   inline bool operator()(const Vertex& a, const Vertex& b) const {
+      return a.Position == b.Position && a.Normal == b.Normal && a.TexCoords == b.TexCoords;
+   }
+};
+
+struct Collapse {
+   double cost;
+   unsigned int from;
+   unsigned int to;
+};
+
+/**
+   Indicates whether replacing the vertex "from" with "to" flips, or folds into a sliver, any of
+   the triangles around "from".
+ */
+static bool collapseFlips(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+   const std::vector<unsigned int>& adjacencyOffsets, const std::vector<unsigned int>& adjacency, unsigned int from, unsigned int to) {
+
+   for (unsigned int a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+      const unsigned int* triangle = &indices[adjacency[a] * 3];
+      if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+         // This triangle just disappears.
+         continue;
+      }
+      glm::vec3 p[3];
+      glm::vec3 q[3];
+      for (int c = 0; c < 3; c++) {
+         p[c] = vertices[triangle[c]].Position;
+         q[c] = triangle[c] == from ? vertices[to].Position : p[c];
+      }
+      glm::vec3 oldNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+      glm::vec3 newNormal = glm::cross(q[1] - q[0], q[2] - q[0]);
+      float oldArea = glm::length(oldNormal);
+      float newArea = glm::length(newNormal);
+      float longestEdge = glm::max(glm::length(q[1] - q[0]), glm::max(glm::length(q[2] - q[1]), glm::length(q[0] - q[2])));
+      if (newArea <= MIN_TRIANGLE_ASPECT * longestEdge * longestEdge ||
+         glm::dot(oldNormal, newNormal) <= MAX_NORMAL_ROTATION_COS * oldArea * newArea) {
+         return true;
+      }
+   }
+   return false;
+}
+
+std::vector<unsigned int> MeshSimplifier::simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, std::size_t targetIndexCount, float maxError) {
+
+   std::size_t vertexCount = vertices.size();
+
+   // Meshes that weren't welded, like OBJs imported without joining identical vertices, have a
+   // vertex per triangle corner. The copies of a vertex are interchangeable, so the triangles
+   // are rewritten to use the first one, and then a position only has several vertices on a seam.
+   std::vector<unsigned int> weld(vertexCount);
+   std::vector<unsigned int> positionIds(vertexCount);
+   {
+      std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> firstVertices;
+      std::unordered_map<glm::vec3, unsigned int, PositionHash> firstPositions;
+      for (std::size_t v = 0; v < vertexCount; v++) {
+         weld[v] = firstVertices.emplace(vertices[v], (unsigned int)v).first->second;
+         positionIds[v] = firstPositions.emplace(vertices[v].Position, (unsigned int)v).first->second;
+      }
+   }
+
+   std::vector<unsigned int> result;
+   result.reserve(indices.size());
+   for (std::size_t t = 0; t + 2 < indices.size(); t += 3) {
+      unsigned int a = weld[indices[t]];
+      unsigned int b = weld[indices[t + 1]];
+      unsigned int c = weld[indices[t + 2]];
+      if (a != b && b != c && a != c) {
+         result.push_back(a);
+         result.push_back(b);
+         result.push_back(c);
+      }
+   }
+   if (result.size() <= targetIndexCount || vertexCount == 0) {
+      return result;
+   }
+
+   // Positions on attribute seams, used by several distinct vertices, and on borders, where an
+   // edge between two positions belongs to a single triangle, are locked in place.
+   std::vector<bool> lockedPositions(vertexCount, false);
+   std::vector<unsigned int> seamVertices(vertexCount, ~0u);
+   for (unsigned int index : result) {
+      unsigned int& seamVertex = seamVertices[positionIds[index]];
+      if (seamVertex == ~0u) {
+         seamVertex = index;
+      }
+      else if (seamVertex != index) {
+         lockedPositions[positionIds[index]] = true;
+      }
+   }
+   std::unordered_map<std::uint64_t, unsigned int> edgeCounts;
+   for (std::size_t t = 0; t < result.size(); t += 3) {
+      for (int e = 0; e < 3; e++) {
+         std::uint64_t a = positionIds[result[t + e]];
+         std::uint64_t b = positionIds[result[t + (e + 1) % 3]];
+         edgeCounts[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+      }
+   }
+   for (const auto& edge : edgeCounts) {
+      if (edge.second == 1) {
+         lockedPositions[(unsigned int)(edge.first >> 32)] = true;
+         lockedPositions[(unsigned int)(edge.first & 0xFFFFFFFFu)] = true;
+      }
+   }
+   std::vector<bool> locked(vertexCount);
+   for (std::size_t v = 0; v < vertexCount; v++) {
+      locked[v] = lockedPositions[positionIds[v]];
+   }
+
+   std::vector<Quadric> quadrics(vertexCount);
+   glm::vec3 minPosition = vertices[result[0]].Position;
+   glm::vec3 maxPosition = minPosition;
+   for (std::size_t t = 0; t < result.size(); t += 3) {
+      const glm::vec3& p0 = vertices[result[t]].Position;
+      const glm::vec3& p1 = vertices[result[t + 1]].Position;
+      const glm::vec3& p2 = vertices[result[t + 2]].Position;
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float length = glm::length(normal);
+      if (length > 0.0f) {
+         Quadric plane(normal / length, p0);
+         quadrics[result[t]] += plane;
+         quadrics[result[t + 1]] += plane;
+         quadrics[result[t + 2]] += plane;
+      }
+      minPosition = glm::min(minPosition, glm::min(p0, glm::min(p1, p2)));
+      maxPosition = glm::max(maxPosition, glm::max(p0, glm::max(p1, p2)));
+   }
+   double maxErrorDistance = (double)maxError * glm::length(maxPosition - minPosition);
+   double maxCost = maxErrorDistance * maxErrorDistance;
+
+   std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+   std::vector<unsigned int> adjacency;
+   std::vector<unsigned int> remap(vertexCount);
+   std::vector<bool> touched(vertexCount);
+   std::vector<Collapse> collapses;
+
+   // Every pass collapses the cheapest edges that don't share triangles, then compacts the mesh.
+   while (result.size() > targetIndexCount) {
+
+      std::size_t triangleCount = result.size() / 3;
+
+      std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+      for (unsigned int index : result) {
+         adjacencyOffsets[index + 1]++;
+      }
+      std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+      adjacency.resize(result.size());
+      std::vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+      for (std::size_t t = 0; t < triangleCount; t++) {
+         for (int c = 0; c < 3; c++) {
+            adjacency[adjacencyFill[result[t * 3 + c]]++] = (unsigned int)t;
+         }
+      }
+
+      collapses.clear();
+      for (std::size_t t = 0; t < result.size(); t += 3) {
+         for (int e = 0; e < 3; e++) {
+            unsigned int a = result[t + e];
+            unsigned int b = result[t + (e + 1) % 3];
+            Quadric quadric = quadrics[a];
+            quadric += quadrics[b];
+            if (!locked[a]) {
+               collapses.push_back({ quadric.evaluate(vertices[b].Position), a, b });
+            }
+            if (!locked[b]) {
+               collapses.push_back({ quadric.evaluate(vertices[a].Position), b, a });
+            }
+         }
+      }
+      std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+         return x.cost < y.cost;
+      });
+
+      // Each collapse of an inner edge removes two triangles.
+      std::size_t collapseBudget = std::max<std::size_t>((triangleCount - targetIndexCount / 3) / 2, 1);
+      std::size_t collapseCount = 0;
+      std::iota(remap.begin(), remap.end(), 0);
+      std::fill(touched.begin(), touched.end(), false);
+
+      for (const Collapse& collapse : collapses) {
+         if (collapseCount >= collapseBudget || collapse.cost > maxCost) {
+            break;
+         }
+         if (touched[collapse.from] || touched[collapse.to] ||
+            collapseFlips(vertices, result, adjacencyOffsets, adjacency, collapse.from, collapse.to)) {
+            continue;
+         }
+
+         remap[collapse.from] = collapse.to;
+         quadrics[collapse.to] += quadrics[collapse.from];
+         for (unsigned int a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+            const unsigned int* triangle = &result[adjacency[a] * 3];
+            touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+         }
+         collapseCount++;
+      }
+      if (collapseCount == 0) {
+         break;
+      }
+
+      std::size_t write = 0;
+      for (std::size_t t = 0; t < result.size(); t += 3) {
+         unsigned int a = remap[result[t]];
+         unsigned int b = remap[result[t + 1]];
+         unsigned int c = remap[result[t + 2]];
+         if (a != b && b != c && a != c) {
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+         }
+      }
+      result.resize(write);
+   }
+
+   return result;
+}
+
+void MeshSimplifier::generateLods(MeshData& mesh, unsigned int levelCount, float reduction) {
+
+   mesh.LodIndices.clear();
+   for (unsigned int level = 1; level <= levelCount; level++) {
+      const std::vector<unsigned int>& previous = level == 1 ? mesh.Indices : mesh.LodIndices.back();
+      std::size_t target = (std::size_t)((float)(previous.size() / 3) * reduction) * 3;
+
+      // Coarser levels are seen from further away, so they can afford a larger error.
+      float maxError = DEFLT_LOD_MAX_ERROR * (float)(1u << (level - 1));
+      std::vector<unsigned int> lod = simplify(mesh.Vertices, previous, target, maxError);
+
+      if (lod.empty() || lod.size() * 20 >= previous.size() * 19) {
+         break;
+      }
+      mesh.LodIndices.push_back(std::move(lod));
+   }
+}
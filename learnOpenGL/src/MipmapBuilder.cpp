@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "MipmapBuilder.h"
+#include "Simd.h"
+
+void MipmapBuilder::downsample(const unsigned char* pixels, int width, int height, int components, unsigned char* outPixels) {
+
+   int halfWidth = std::max(width / 2, 1);
+   int halfHeight = std::max(height / 2, 1);
+   std::size_t rowSize = (std::size_t)width * components;
+   for (int y = 0; y < halfHeight; y++) {
+      const unsigned char* row0 = pixels + std::min(y * 2, height - 1) * rowSize;
+      const unsigned char* row1 = pixels + std::min(y * 2 + 1, height - 1) * rowSize;
+      unsigned char* out = outPixels + (std::size_t)y * halfWidth * components;
+      int x = 0;
+
+#ifdef SIMD_SSE
+      if (width >= 2 && (components == 1 || components == 4)) {
+         const __m128i zero = _mm_setzero_si128();
+         const __m128i ones = _mm_set1_epi16(1);
+         const __m128i rounding = _mm_set1_epi16(2);
+         // 16 source bytes of both rows give 8 bytes of the half size row.
+         int outputsPerStep = 8 / components;
+         for (; x + outputsPerStep <= halfWidth; x += outputsPerStep) {
+            __m128i top = _mm_loadu_si128((const __m128i*)(row0 + (std::size_t)x * 2 * components));
+            __m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + (std::size_t)x * 2 * components));
+            __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+            __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+            __m128i sums;
+            if (components == 4) {
+               // Each half of the registers holds a pixel, the pairs are the halves of the same register.
+               sums = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+            }
+            else {
+               // The pairs are adjacent 16 bit lanes, which madd adds up.
+               sums = _mm_packs_epi32(_mm_madd_epi16(low, ones), _mm_madd_epi16(high, ones));
+            }
+            __m128i averages = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+            _mm_storel_epi64((__m128i*)(out + (std::size_t)x * components), _mm_packus_epi16(averages, averages));
+         }
+      }
+#endif
+
+      for (; x < halfWidth; x++) {
+         int x0 = std::min(x * 2, width - 1) * components;
+         int x1 = std::min(x * 2 + 1, width - 1) * components;
+         for (int c = 0; c < components; c++) {
+            int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+            out[x * components + c] = (unsigned char)((sum + 2) / 4);
+         }
+      }
+   }
+}
+
+unsigned int MipmapBuilder::getLevelCount(int width, int height) {
+   unsigned int levelCount = 1;
+   while (width > 1 || height > 1) {
+      width = std::max(width / 2, 1);
+      height = std::max(height / 2, 1);
+      levelCount++;
+   }
+   return levelCount;
+}
+
+std::size_t MipmapBuilder::getLevelSize(int width, int height, int components, unsigned int level) {
+   std::size_t levelWidth = std::max(width >> level, 1);
+   std::size_t levelHeight = std::max(height >> level, 1);
+   return levelWidth * levelHeight * components;
+}
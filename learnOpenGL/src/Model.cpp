@@ -1,43 +1,538 @@
 
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <unordered_set>
+
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "ImportFileSystem.h"
+#include "LoadProfiler.h"
+#include "MappedFile.h"
 #include "Model.h"
+#include "ModelCache.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+
+Model::~Model() {
+   if (InstanceVBO != 0) {
+      GLStateCache::getShared().deleteBuffers(1, &InstanceVBO);
+   }
+}
+
+void Model::draw(Shader& shader, const glm::mat4& modelMat) {
+   RenderQueue& queue = getImmediateQueue();
+   enqueue(queue, shader, modelMat);
+   queue.submit();
+}
+
+void Model::draw(Shader& shader, const Camera& camera, const glm::mat4& projectionMat, const glm::mat4& modelMat) {
+   RenderQueue& queue = getImmediateQueue();
+   enqueue(queue, shader, camera, projectionMat, modelMat);
+   queue.submit();
+}
+
+void Model::enqueue(RenderQueue& queue, Shader& shader, const glm::mat4& modelMat) {
+
+   updateBounds();
+
+   DrawItem item = createDrawItem(shader);
+   int drawnNode = -1;
+   for (unsigned int i = 0; i < Meshes.size(); i++) {
+      // Meshes of the same node are consecutive, so the matrix only changes between nodes.
+      if ((int)MeshNodes[i] != drawnNode) {
+         drawnNode = (int)MeshNodes[i];
+         item.ModelMat = modelMat * Nodes.getWorldTransform(drawnNode);
+      }
+      // Without a camera the size on screen is unknown, so the textures are wanted in full.
+      if (Options.streamTextures) {
+         requestTextureLevels(Meshes[i], std::numeric_limits<float>::max());
+      }
+      item.DrawnMesh = &Meshes[i];
+      queue.push(item, 0.0f);
+   }
+}
+
+void Model::enqueue(RenderQueue& queue, Shader& shader, const Camera& camera, const glm::mat4& projectionMat, const glm::mat4& modelMat) {
+
+   updateBounds();
+
+   glm::mat4 viewProjectionMat = projectionMat * camera.getViewMatrix();
+   cullMeshes(viewProjectionMat, modelMat);
+
+   glm::vec3 cameraPosition = camera.getPosition();
+   float tanHalfFov = std::tan(glm::radians(camera.getZoom()) * 0.5f);
+
+   // The clusters are culled in the space of their node, so their bounds don't need to be transformed.
+   float nodeScale = 1.0f;
+   glm::vec3 nodeCameraPosition = cameraPosition;
+
+   DrawItem item = createDrawItem(shader);
+   int drawnNode = -1;
+   for (unsigned int i : VisibleMeshes) {
+      if ((int)MeshNodes[i] != drawnNode) {
+         drawnNode = (int)MeshNodes[i];
+         item.ModelMat = modelMat * Nodes.getWorldTransform(drawnNode);
+         nodeScale = getMaxScale(item.ModelMat);
+         nodeCameraPosition = glm::vec3(glm::inverse(item.ModelMat) * glm::vec4(cameraPosition, 1.0f));
+      }
+
+      Mesh& mesh = Meshes[i];
+      item.DrawnMesh = &mesh;
+      item.Lod = selectLod(mesh, cameraPosition, tanHalfFov, item.ModelMat, nodeScale);
+      if (Options.streamTextures) {
+         requestTextureLevels(mesh, getScreenSize(mesh, cameraPosition, tanHalfFov, item.ModelMat, nodeScale));
+      }
+      item.CullClusters = item.Lod == 0 && mesh.hasClusters();
+      if (item.CullClusters) {
+         item.ClusterViewProjection = viewProjectionMat * item.ModelMat;
+         item.ClusterCameraPosition = nodeCameraPosition;
+      }
+      glm::vec3 center = glm::vec3(item.ModelMat * glm::vec4(mesh.getBoundsCenter(), 1.0f));
+      queue.push(item, glm::length(center - cameraPosition));
+   }
+}
+
+void Model::cullMeshes(const glm::mat4& viewProjectionMat, const glm::mat4& modelMat) {
+
+   VisibleMeshes.clear();
+   // The hierarchy is in model space, so the frustum is brought there rather than every box to world space.
+   MeshBvh.queryFrustum(Frustum(viewProjectionMat * modelMat), VisibleMeshes);
+   // The meshes of a node are consecutive, so in mesh order the matrix only changes between nodes.
+   std::sort(VisibleMeshes.begin(), VisibleMeshes.end());
+
+   FrameStats& stats = RenderStats::get();
+   stats.meshesVisible += VisibleMeshes.size();
+   stats.meshesCulled += Meshes.size() - VisibleMeshes.size();
+}
+
+void Model::drawInstanced(Shader& shader, const glm::mat4* modelMats, unsigned int instanceCount, unsigned int lod) {
+
+   if (instanceCount == 0) {
+      return;
+   }
+   updateBounds();
+   uploadInstances(modelMats, instanceCount);
+
+   if (Arena) {
+      Arena->bind();
+   }
+   PackedTextures.bind();
+   int drawnNode = -1;
+   for (unsigned int i = 0; i < Meshes.size(); i++) {
+      if ((int)MeshNodes[i] != drawnNode) {
+         drawnNode = (int)MeshNodes[i];
+         shader.setUniform("NodeMat", Nodes.getWorldTransform(drawnNode));
+      }
+      Meshes[i].drawInstanced(shader, instanceCount, lod);
+   }
+   GLStateCache::getShared().bindVertexArray(0);
+}
+
+void Model::uploadInstances(const glm::mat4* modelMats, unsigned int instanceCount) {
+
+   if (InstanceVBO == 0) {
+      GLCall(glGenBuffers(1, &InstanceVBO));
+      // The VAOs keep reading from the buffer name, so they only need attaching once.
+      if (Arena) {
+         Arena->attachInstanceBuffer(InstanceVBO);
+      }
+      for (Mesh& mesh : Meshes) {
+         mesh.attachInstanceBuffer(InstanceVBO);
+      }
+   }
+
+   GLStateCache::getShared().bindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+   if (instanceCount > InstanceCapacity) {
+      InstanceCapacity = glm::max((size_t)instanceCount, InstanceCapacity * 2);
+   }
+   // Orphaning the storage every frame lets the driver hand out fresh memory instead of
+   // waiting for the draws of the previous frame to finish reading it.
+   GLCall(glBufferData(GL_ARRAY_BUFFER, InstanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW));
+   GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(glm::mat4), modelMats));
+   GLStateCache::getShared().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int Model::selectLod(const Mesh& mesh, const glm::vec3& cameraPosition, float tanHalfFov, const glm::mat4& modelMat, float modelScale) const {
 
-std::vector<Texture> Model::loadedTextures;
+   if (mesh.getLodCount() <= 1) {
+      return 0;
+   }
+   float screenSize = getScreenSize(mesh, cameraPosition, tanHalfFov, modelMat, modelScale);
+   if (screenSize >= Options.lodScreenSize) {
+      return 0;
+   }
+   unsigned int lod = 1 + (unsigned int)std::log2(Options.lodScreenSize / screenSize);
+   return glm::min(lod, mesh.getLodCount() - 1);
+}
+
+float Model::getScreenSize(const Mesh& mesh, const glm::vec3& cameraPosition, float tanHalfFov, const glm::mat4& modelMat, float modelScale) {
+   glm::vec3 center = glm::vec3(modelMat * glm::vec4(mesh.getBoundsCenter(), 1.0f));
+   float radius = mesh.getBoundsRadius() * modelScale;
+   float distance = glm::length(center - cameraPosition);
+   if (distance <= radius) {
+      return std::numeric_limits<float>::max();
+   }
+   // The diameter of the sphere over the height of the screen at its distance.
+   return radius / (distance * tanHalfFov);
+}
+
+BoundingBox Model::getBounds() {
+   updateBounds();
+   return MeshBvh.getBounds();
+}
+
+bool Model::pickMesh(const glm::vec3& origin, const glm::vec3& direction, const glm::mat4& modelMat, float maxDistance, BvhRayHit& outHit) {
+
+   updateBounds();
+   // The distances along the ray are in units of its direction, which an affine transform keeps.
+   glm::mat4 inverseModelMat = glm::inverse(modelMat);
+   glm::vec3 modelOrigin = glm::vec3(inverseModelMat * glm::vec4(origin, 1.0f));
+   glm::vec3 modelDirection = glm::vec3(inverseModelMat * glm::vec4(direction, 0.0f));
+   return MeshBvh.raycast(modelOrigin, modelDirection, maxDistance, outHit);
+}
 
-void Model::draw(Shader& shader) {
+bool Model::findNearestMesh(const glm::vec3& point, const glm::mat4& modelMat, float maxDistance, unsigned int& outMesh, float& outDistance) {
+
+   updateBounds();
+   float scale = getMaxScale(modelMat);
+   glm::vec3 modelPoint = glm::vec3(glm::inverse(modelMat) * glm::vec4(point, 1.0f));
+   if (!MeshBvh.findNearest(modelPoint, maxDistance / scale, outMesh, outDistance)) {
+      return false;
+   }
+   outDistance *= scale;
+   return true;
+}
+
+void Model::updateBounds() {
+
+   size_t movedNodes = Nodes.updateWorldTransforms();
+   if (MeshBvh.getItemCount() != Meshes.size()) {
+      std::vector<BoundingBox> meshBounds;
+      meshBounds.reserve(Meshes.size());
+      for (unsigned int i = 0; i < Meshes.size(); i++) {
+         meshBounds.push_back(BoundingVolumes::transform(Meshes[i].getBounds(), Nodes.getWorldTransform(MeshNodes[i])).Box);
+      }
+      MeshBvh.build(meshBounds);
+      return;
+   }
+   if (movedNodes == 0) {
+      return;
+   }
+   // Only the meshes whose box changed dirty their leaf.
    for (unsigned int i = 0; i < Meshes.size(); i++) {
-      Meshes[i].draw(shader);
+      BoundingBox box = BoundingVolumes::transform(Meshes[i].getBounds(), Nodes.getWorldTransform(MeshNodes[i])).Box;
+      const BoundingBox& current = MeshBvh.getItemBounds(i);
+      if (box.Min != current.Min || box.Max != current.Max) {
+         MeshBvh.setItemBounds(i, box);
+      }
    }
+   MeshBvh.refit();
+}
+
+float Model::getMaxScale(const glm::mat4& transform) {
+   return glm::sqrt(glm::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+      glm::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])))));
+}
+
+IndexMemoryStats Model::getIndexMemoryStats() const {
+   IndexMemoryStats total = {};
+   for (const Mesh& mesh : Meshes) {
+      IndexMemoryStats stats = mesh.getIndexMemoryStats();
+      total.meshCount += stats.meshCount;
+      total.shortIndexMeshCount += stats.shortIndexMeshCount;
+      total.bytes += stats.bytes;
+      total.bytesAs32Bit += stats.bytesAs32Bit;
+   }
+   return total;
+}
+
+LodTriangleStats Model::getLodTriangleStats() const {
+   LodTriangleStats total = {};
+   for (const Mesh& mesh : Meshes) {
+      LodTriangleStats stats = mesh.getLodTriangleStats();
+      total.fullDetailTriangles += stats.fullDetailTriangles;
+      total.coarsestTriangles += stats.coarsestTriangles;
+   }
+   return total;
 }
 
 void Model::loadModel(const std::string& path) {
+
+   ScopedLoadTimer timer(LoadStage::TOTAL);
+   std::vector<MeshData> meshesData;
+   cookModel(path, meshesData);
+   loadTextures(meshesData);
+
+   if (Options.sharedBuffers) {
+      createArena(meshesData);
+   }
+   Meshes.reserve(meshesData.size());
+   MeshNodes.reserve(meshesData.size());
+   for (unsigned int i = 0; i < meshesData.size(); i++) {
+      uploadMesh(std::move(meshesData[i]));
+   }
+}
+
+void Model::loadTextures(const std::vector<MeshData>& meshesData) {
+
+   TextureCache& cache = TextureCache::getShared();
+   std::unordered_set<std::string> keys;
+   std::vector<std::string> decodedKeys;
+   std::vector<const TextureRef*> decodedRefs;
+   std::vector<std::future<TextureData>> decodedImages;
+
+   // Every image is queued for decoding as soon as it's found, the pool's threads decoding them all at once.
+   for (const MeshData& meshData : meshesData) {
+      for (const TextureRef& ref : meshData.Textures) {
+         std::string path = Directory + '/' + ref.path;
+         std::string key = TextureCache::getKey(path);
+         // Packed textures are copied into the model's arrays, so even the cached ones are needed.
+         if (!keys.insert(key).second || (!Options.packTextures && cache.contains(key))) {
+            continue;
+         }
+         decodedKeys.push_back(key);
+         decodedRefs.push_back(&ref);
+         std::string typeName = ref.type;
+         bool compress = Options.compressTextures;
+         bool useCache = Options.cacheTextures;
+         decodedImages.push_back(ThreadPool::getShared().submit([path, typeName, compress, useCache]() {
+            return TextureData::load(path, typeName, compress, useCache);
+         }));
+      }
+   }
+
+   // Only the uploads are left to this thread, each as soon as its image is decoded.
+   for (size_t i = 0; i < decodedImages.size(); i++) {
+      if (Options.packTextures) {
+         PackedTextures.add(decodedKeys[i], decodedImages[i].get());
+      }
+      else {
+         holdTexture(decodedKeys[i], addTexture(decodedKeys[i], decodedImages[i].get(), *decodedRefs[i]));
+      }
+   }
+   if (Options.packTextures) {
+      PackedTextures.upload();
+   }
+}
+
+void Model::createArena(const std::vector<MeshData>& meshesData) {
+   size_t vertexCount = 0;
+   for (const MeshData& meshData : meshesData) {
+      vertexCount += meshData.Vertices.size();
+   }
+   Arena.reset(new MeshArena(Options.vertexFormat, vertexCount, MeshArena::getIndexCapacity(meshesData)));
+}
+
+void Model::uploadMesh(MeshData&& meshData) {
+   MeshNodes.push_back(meshData.Node);
+   std::vector<Texture> textures;
+   std::vector<TextureLayer> layers;
+   if (Options.packTextures) {
+      layers = getTextureLayers(meshData.Textures);
+   }
+   else {
+      textures = loadMaterialTextures(meshData.Textures);
+   }
+   if (Arena) {
+      Meshes.emplace_back(std::move(meshData), std::move(textures), *Arena);
+   }
+   else {
+      Meshes.emplace_back(std::move(meshData), std::move(textures), Options.vertexFormat);
+   }
+   Meshes.back().setTextureLayers(std::move(layers));
+}
+
+void Model::cookModel(const std::string& path, std::vector<MeshData>& outMeshes) {
+
+   Directory = path.substr(0, path.find_last_of('/'));
+   Nodes.clear();
+
+   std::uint32_t cookFlags = getCookFlags();
+   if (!ModelCache::load(path, cookFlags, outMeshes, Nodes)) {
+      std::vector<std::string> dependencies;
+      if (!importModel(path, outMeshes, dependencies)) {
+         throw ModelImportFailure();
+      }
+      if (Options.optimizeMeshes) {
+         optimizeMeshes(outMeshes);
+      }
+      if (Options.splitLargeMeshes) {
+         std::vector<MeshData> splitMeshes;
+         for (MeshData& meshData : outMeshes) {
+            MeshOptimizer::splitMesh(meshData, splitMeshes);
+         }
+         outMeshes.swap(splitMeshes);
+      }
+      if (Options.lodLevels > 0) {
+         generateLods(outMeshes);
+      }
+      if (Options.buildClusters) {
+         buildClusters(outMeshes);
+      }
+      if (!ModelCache::save(path, cookFlags, dependencies, outMeshes, Nodes)) {
+         std::cout << "WARNING::MODEL_CACHE::Couldn't write " << ModelCache::getCachePath(path) << std::endl;
+      }
+   }
+}
+
+std::uint32_t Model::getCookFlags() const {
+   std::uint32_t cookFlags = 0;
+   if (Options.optimizeMeshes) {
+      cookFlags |= MODEL_COOK_OPTIMIZED_MESHES;
+   }
+   if (Options.splitLargeMeshes) {
+      cookFlags |= MODEL_COOK_SPLIT_MESHES;
+   }
+   if (Options.buildClusters) {
+      cookFlags |= MODEL_COOK_CLUSTERS;
+   }
+   if (Options.lodLevels > 0) {
+      cookFlags |= glm::min(Options.lodLevels, 0xFFu) << MODEL_COOK_LOD_LEVELS_SHIFT;
+      cookFlags |= (std::uint32_t)glm::clamp(Options.lodReduction * 100.0f + 0.5f, 0.0f, 255.0f) << MODEL_COOK_LOD_REDUCTION_SHIFT;
+   }
+   return cookFlags;
+}
+
+void Model::optimizeMeshes(std::vector<MeshData>& meshesData) {
+
+   std::vector<MeshOptimizationStats> meshStats(meshesData.size());
+   ThreadPool::getShared().parallelFor(meshesData.size(), [&](size_t i) {
+      ScopedLoadTimer timer(LoadStage::OPTIMIZE, getMeshDataSize(meshesData[i]));
+      meshStats[i] = MeshOptimizer::optimize(meshesData[i]);
+   });
+
+   OptimizationStats = MeshOptimizationStats();
+   for (const MeshOptimizationStats& stats : meshStats) {
+      MeshOptimizer::accumulate(OptimizationStats.before, stats.before);
+      MeshOptimizer::accumulate(OptimizationStats.after, stats.after);
+   }
+   std::cout << "MESH_OPTIMIZER::" << Directory << " ACMR " << OptimizationStats.before.acmr << " -> " << OptimizationStats.after.acmr
+      << ", ATVR " << OptimizationStats.before.atvr << " -> " << OptimizationStats.after.atvr << std::endl;
+}
+
+void Model::generateLods(std::vector<MeshData>& meshesData) {
+
+   ThreadPool::getShared().parallelFor(meshesData.size(), [&](size_t i) {
+      MeshData& meshData = meshesData[i];
+      ScopedLoadTimer timer(LoadStage::LOD_GENERATION);
+      MeshSimplifier::generateLods(meshData, Options.lodLevels, Options.lodReduction);
+      for (std::vector<unsigned int>& lod : meshData.LodIndices) {
+         if (Options.optimizeMeshes) {
+            MeshOptimizer::optimizeVertexCache(lod, meshData.Vertices.size());
+         }
+         timer.addBytes(lod.size() * sizeof(unsigned int));
+      }
+   });
+
+   size_t triangleCount = 0;
+   size_t lodTriangleCount = 0;
+   for (const MeshData& meshData : meshesData) {
+      triangleCount += meshData.Indices.size() / 3;
+      if (!meshData.LodIndices.empty()) {
+         lodTriangleCount += meshData.LodIndices.back().size() / 3;
+      }
+      else {
+         lodTriangleCount += meshData.Indices.size() / 3;
+      }
+   }
+   std::cout << "MESH_SIMPLIFIER::" << Directory << " " << triangleCount << " triangles, " << lodTriangleCount << " at the coarsest level of detail" << std::endl;
+}
+
+void Model::buildClusters(std::vector<MeshData>& meshesData) {
+
+   ThreadPool::getShared().parallelFor(meshesData.size(), [&](size_t i) {
+      ScopedLoadTimer timer(LoadStage::CLUSTER_BUILD);
+      MeshClusterizer::buildClusters(meshesData[i]);
+      timer.addBytes(meshesData[i].Clusters.size() * sizeof(MeshCluster));
+   });
+
+   size_t clusterCount = 0;
+   for (const MeshData& meshData : meshesData) {
+      clusterCount += meshData.Clusters.size();
+   }
+   std::cout << "MESH_CLUSTERIZER::" << Directory << " " << clusterCount << " clusters" << std::endl;
+}
+
+bool Model::importModel(const std::string& path, std::vector<MeshData>& outMeshes, std::vector<std::string>& outDependencies) {
    Assimp::Importer importer;
-   const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+   // The importer owns its IO handler and deletes it along with itself.
+   ImportFileSystem* fileSystem = new ImportFileSystem();
+   importer.SetIOHandler(fileSystem);
+   // Meshes made only of lines or points are removed, since the meshes are drawn as triangles.
+   importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+   const aiScene* scene;
+   {
+      FileInfo sourceInfo;
+      ScopedLoadTimer timer(LoadStage::ASSIMP_PARSE, MappedFile::getFileInfo(path, sourceInfo) ? sourceInfo.size : 0);
+      scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_FlipUVs);
+   }
 
    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
       std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-      return;
+      return false;
    }
-   Directory = path.substr(0, path.find_last_of('/'));
-   processNode(scene->mRootNode, scene);
+   for (const std::string& file : fileSystem->getOpenedFiles()) {
+      if (file != path) {
+         outDependencies.push_back(file);
+      }
+   }
+
+   std::vector<aiMesh*> meshes;
+   std::vector<unsigned int> meshNodes;
+   processNode(scene->mRootNode, scene, NO_PARENT_NODE, meshes, meshNodes);
+
+   size_t firstMesh = outMeshes.size();
+   outMeshes.resize(firstMesh + meshes.size());
+   if (Options.parallelImport) {
+      ThreadPool::getShared().parallelFor(meshes.size(), [&](size_t i) {
+         outMeshes[firstMesh + i] = processMesh(meshes[i], scene);
+         outMeshes[firstMesh + i].Node = meshNodes[i];
+      });
+   }
+   else {
+      for (size_t i = 0; i < meshes.size(); i++) {
+         outMeshes[firstMesh + i] = processMesh(meshes[i], scene);
+         outMeshes[firstMesh + i].Node = meshNodes[i];
+      }
+   }
+   return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+void Model::processNode(aiNode* node, const aiScene* scene, int parent, std::vector<aiMesh*>& outMeshes, std::vector<unsigned int>& outMeshNodes) {
+
+   // Assimp's matrices are row major, each glm column is one of its columns.
+   const aiMatrix4x4& m = node->mTransformation;
+   glm::mat4 localTransform(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+   unsigned int nodeIndex = Nodes.addNode(node->mName.C_Str(), parent, localTransform);
 
    for (int i = 0; i < node->mNumMeshes; i++) {
-      aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-      Meshes.push_back(processMesh(mesh, scene));
+      outMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+      outMeshNodes.push_back(nodeIndex);
    }
 
    for (int i = 0; i < node->mNumChildren; i++) {
-      processNode(node->mChildren[i], scene);
+      processNode(node->mChildren[i], scene, (int)nodeIndex, outMeshes, outMeshNodes);
    }
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+MeshData Model::processMesh(const aiMesh* mesh, const aiScene* scene) {
 
-   std::vector<Vertex> vertices;
-   std::vector<unsigned int> indices;
-   std::vector<Texture> textures;
+   ScopedLoadTimer timer(LoadStage::PROCESS_MESH);
+   MeshData meshData;
+   std::vector<Vertex>& vertices = meshData.Vertices;
+   std::vector<unsigned int>& indices = meshData.Indices;
+   // The meshes are drawn as triangle lists, so the lines and points left in a mesh with mixed
+   // primitives are dropped.
+   size_t indexCount = 0;
+   for (int i = 0; i < mesh->mNumFaces; i++) {
+      if (mesh->mFaces[i].mNumIndices == 3) {
+         indexCount += 3;
+      }
+   }
+   vertices.reserve(mesh->mNumVertices);
+   indices.reserve(indexCount);
 
    for (int i = 0; i < mesh->mNumVertices; i++) {
       Vertex vertex;
@@ -58,45 +553,106 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
    }
 
    for (int i = 0; i < mesh->mNumFaces; i++) {
-      aiFace face = mesh->mFaces[i];
-      for (int j = 0; j < face.mNumIndices; j++) {
-         indices.push_back(face.mIndices[j]);
+      // aiFace owns its indices, so a copy of it would allocate.
+      const aiFace& face = mesh->mFaces[i];
+      if (face.mNumIndices == 3) {
+         indices.insert(indices.end(), face.mIndices, face.mIndices + 3);
       }
    }
 
+   meshData.Bounds = BoundingVolumes::compute(vertices);
+
    if (mesh->mMaterialIndex >= 0) {
       aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-      std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-      textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-      std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-      textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+      meshData.Textures.reserve(material->GetTextureCount(aiTextureType_DIFFUSE) + material->GetTextureCount(aiTextureType_SPECULAR));
+      getMaterialTextureRefs(material, aiTextureType_DIFFUSE, "texture_diffuse", meshData.Textures);
+      getMaterialTextureRefs(material, aiTextureType_SPECULAR, "texture_specular", meshData.Textures);
    }
 
-   return Mesh(vertices, indices, textures);
+   timer.addBytes(getMeshDataSize(meshData));
+   return meshData;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
+std::size_t Model::getMeshDataSize(const MeshData& meshData) {
+   return meshData.Vertices.size() * sizeof(Vertex) + meshData.Indices.size() * sizeof(unsigned int);
+}
 
-   std::vector<Texture> textures;
-   
+void Model::getMaterialTextureRefs(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<TextureRef>& outTextures) {
    for (int i = 0; i < mat->GetTextureCount(type); i++) {
-      aiString str; 
+      aiString str;
       mat->GetTexture(type, i, &str);
-      bool skip = false;
-      for (int j = 0; j < loadedTextures.size(); j++) {
-         if (std::strcmp(loadedTextures[j].path.data(), str.C_Str()) == 0) {
-            textures.push_back(loadedTextures[j]);
-            skip = true;
-            break;
-         }
-      }
-      if (!skip) {
-         Texture texture(str.C_Str(), Directory, typeName);
-         textures.push_back(texture);
-         loadedTextures.push_back(texture);
+      outTextures.push_back({ typeName, str.C_Str() });
+   }
+}
+
+std::vector<Texture> Model::loadMaterialTextures(const std::vector<TextureRef>& textureRefs) {
+
+   TextureCache& cache = TextureCache::getShared();
+   std::vector<Texture> textures;
+   textures.reserve(textureRefs.size());
+
+   for (const TextureRef& ref : textureRefs) {
+      std::string key = TextureCache::getKey(Directory + '/' + ref.path);
+      std::shared_ptr<const Texture> texture = cache.find(key);
+      if (!texture) {
+         texture = addTexture(key, TextureData::load(Directory + '/' + ref.path, ref.type, Options.compressTextures, Options.cacheTextures), ref);
       }
+      holdTexture(key, texture);
+
+      // The same image can be used as a different type by another material.
+      textures.push_back(*texture);
+      textures.back().type = ref.type;
    }
    return textures;
-}
\ No newline at end of file
+}
+std::vector<TextureLayer> Model::getTextureLayers(const std::vector<TextureRef>& textureRefs) const {
+   std::vector<TextureLayer> layers;
+   layers.reserve(textureRefs.size());
+   for (const TextureRef& ref : textureRefs) {
+      layers.push_back(PackedTextures.getLayer(TextureCache::getKey(Directory + '/' + ref.path), ref.type));
+   }
+   return layers;
+}
+
+DrawItem Model::createDrawItem(Shader& shader) const {
+   DrawItem item;
+   item.Program = &shader;
+   item.DrawnMesh = nullptr;
+   item.Arena = Arena.get();
+   item.PackedTextures = PackedTextures.getArrayCount() > 0 ? &PackedTextures : nullptr;
+   item.ModelMat = glm::mat4(1.0f);
+   item.Lod = 0;
+   item.CullClusters = false;
+   return item;
+}
+
+RenderQueue& Model::getImmediateQueue() {
+   static RenderQueue queue;
+   return queue;
+}
+
+std::shared_ptr<const Texture> Model::addTexture(const std::string& key, TextureData&& data, const TextureRef& ref, PixelUploadRing* ring) {
+   TextureCache& cache = TextureCache::getShared();
+   if (!Options.streamTextures || !TextureStreamer::isStreamable(data)) {
+      return cache.insert(key, data.createTexture(ref.path, ref.type, ring));
+   }
+   Texture created = TextureStreamer::createTexture(ref.path, ref.type, data, ring);
+   std::shared_ptr<const Texture> texture = cache.insert(key, created);
+   if (texture->Id == created.Id) {
+      TextureStreamer::getShared().add(texture, std::move(data));
+   }
+   return texture;
+}
+
+void Model::holdTexture(const std::string& key, std::shared_ptr<const Texture> texture) {
+   if (TextureKeys.insert(key).second) {
+      Textures.push_back(std::move(texture));
+   }
+}
+
+void Model::requestTextureLevels(const Mesh& mesh, float screenSize) const {
+   TextureStreamer& streamer = TextureStreamer::getShared();
+   for (const Texture& texture : mesh.getTextures()) {
+      streamer.request(texture.Id, screenSize);
+   }
+}
@@ -0,0 +1,331 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "LoadProfiler.h"
+#include "ModelCache.h"
+#include "MappedFile.h"
+
+static const char CACHE_MAGIC[8] = { 'M', 'D', 'L', 'C', 'A', 'C', 'H', 'E' };
+
+struct CacheHeader {
+   char magic[8];
+   std::uint32_t version;
+   std::uint32_t vertexSize;
+   std::uint64_t sourceSize;
+   std::int64_t sourceModificationTime;
+   std::uint64_t sourceHash;
+   std::uint32_t meshCount;
+   std::uint32_t cookFlags;
+   std::uint32_t nodeCount;
+   std::uint32_t dependencyCount;
+};
+
+// Followed by the path of the file.
+struct CacheDependencyRecord {
+   std::uint64_t size;
+   std::int64_t modificationTime;
+   std::uint64_t hash;
+   std::uint32_t pathLength;
+   std::uint32_t reserved;
+};
+
+struct CacheMeshRecord {
+   std::uint32_t vertexCount;
+   std::uint32_t indexCount;
+   std::uint32_t textureCount;
+   std::uint32_t lodCount;
+   std::uint32_t clusterCount;
+   std::uint32_t node;
+   MeshBounds bounds;
+};
+
+struct CacheNodeRecord {
+   std::int32_t parent;
+   float localTransform[16];
+};
+
+/**
+   Bounds checked sequential reader over the mapped cache file.
+ */
+struct CacheReader {
+   const unsigned char* cursor;
+   const unsigned char* end;
+
+   inline bool has(std::size_t size) const {
+      return (std::size_t)(end - cursor) >= size;
+   }
+
+   inline bool read(void* dst, std::size_t size) {
+      if (!has(size)) {
+         return false;
+      }
+      std::memcpy(dst, cursor, size);
+      cursor += size;
+      return true;
+   }
+
+   inline bool readString(std::string& outString, std::uint32_t length) {
+      if (!has(length)) {
+         return false;
+      }
+      outString.assign((const char*)cursor, length);
+      cursor += length;
+      return true;
+   }
+};
+
+static void writeString(std::ofstream& file, const std::string& str) {
+   std::uint32_t length = (std::uint32_t)str.size();
+   file.write((const char*)&length, sizeof(length));
+   file.write(str.data(), length);
+}
+
+bool ModelCache::hashFile(const std::string& path, std::uint64_t& outHash) {
+   try {
+      MappedFile file(path);
+      std::uint64_t hash = 14695981039346656037ull;
+      const unsigned char* data = file.data();
+      for (std::size_t i = 0; i < file.size(); i++) {
+         hash ^= data[i];
+         hash *= 1099511628211ull;
+      }
+      outHash = hash;
+      return true;
+   }
+   catch (const MappedFile::MappingFailure& e) {
+      return false;
+   }
+}
+
+bool ModelCache::checkFile(const std::string& path, std::uint64_t size, std::int64_t& modificationTime, std::uint64_t hash, bool& outTouched) {
+   FileInfo info;
+   if (!MappedFile::getFileInfo(path, info) || info.size != size) {
+      return false;
+   }
+
+   // The file may have been touched without being modified (e.g. by a checkout).
+   if (info.modificationTime != modificationTime) {
+      std::uint64_t currentHash;
+      if (!hashFile(path, currentHash) || currentHash != hash) {
+         return false;
+      }
+      modificationTime = info.modificationTime;
+      outTouched = true;
+   }
+   return true;
+}
+
+bool ModelCache::load(const std::string& modelPath, std::uint32_t cookFlags, std::vector<MeshData>& outMeshes, NodeHierarchy& outNodes) {
+
+   ScopedLoadTimer timer(LoadStage::CACHE_LOAD);
+   std::string cachePath = getCachePath(modelPath);
+   CacheHeader header;
+   bool touched = false;
+   // The dependency records whose modification time changed, and their offset in the cache.
+   std::vector<std::pair<std::size_t, CacheDependencyRecord>> touchedDependencies;
+
+   try {
+      MappedFile cache(cachePath);
+      timer.addBytes(cache.size());
+      CacheReader reader = { cache.data(), cache.data() + cache.size() };
+
+      if (!reader.read(&header, sizeof(header)) ||
+         std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+         header.version != MODEL_CACHE_VERSION ||
+         header.vertexSize != sizeof(Vertex) ||
+         header.cookFlags != cookFlags ||
+         !checkFile(modelPath, header.sourceSize, header.sourceModificationTime, header.sourceHash, touched)) {
+         return false;
+      }
+
+      for (std::uint32_t i = 0; i < header.dependencyCount; i++) {
+         std::size_t offset = (std::size_t)(reader.cursor - cache.data());
+         CacheDependencyRecord record;
+         std::string path;
+         bool dependencyTouched = false;
+         if (!reader.read(&record, sizeof(record)) || !reader.readString(path, record.pathLength) ||
+            !checkFile(path, record.size, record.modificationTime, record.hash, dependencyTouched)) {
+            return false;
+         }
+         if (dependencyTouched) {
+            touchedDependencies.emplace_back(offset, record);
+         }
+      }
+
+      std::vector<MeshData> meshes(header.meshCount);
+      for (MeshData& mesh : meshes) {
+         CacheMeshRecord record;
+         if (!reader.read(&record, sizeof(record)) || record.node >= header.nodeCount ||
+            !reader.has((std::size_t)record.vertexCount * sizeof(Vertex) + (std::size_t)record.indexCount * sizeof(unsigned int))) {
+            return false;
+         }
+
+         mesh.Node = record.node;
+         mesh.Bounds = record.bounds;
+         mesh.Vertices.resize(record.vertexCount);
+         mesh.Indices.resize(record.indexCount);
+         if (!reader.read(mesh.Vertices.data(), record.vertexCount * sizeof(Vertex)) ||
+            !reader.read(mesh.Indices.data(), record.indexCount * sizeof(unsigned int))) {
+            return false;
+         }
+
+         mesh.LodIndices.resize(record.lodCount);
+         for (std::vector<unsigned int>& lod : mesh.LodIndices) {
+            std::uint32_t indexCount;
+            if (!reader.read(&indexCount, sizeof(indexCount)) || !reader.has((std::size_t)indexCount * sizeof(unsigned int))) {
+               return false;
+            }
+            lod.resize(indexCount);
+            if (!reader.read(lod.data(), indexCount * sizeof(unsigned int))) {
+               return false;
+            }
+         }
+
+         if (!reader.has((std::size_t)record.clusterCount * sizeof(MeshCluster))) {
+            return false;
+         }
+         mesh.Clusters.resize(record.clusterCount);
+         reader.read(mesh.Clusters.data(), record.clusterCount * sizeof(MeshCluster));
+
+         mesh.Textures.resize(record.textureCount);
+         for (TextureRef& texture : mesh.Textures) {
+            std::uint32_t length;
+            if (!reader.read(&length, sizeof(length)) || !reader.readString(texture.type, length) ||
+               !reader.read(&length, sizeof(length)) || !reader.readString(texture.path, length)) {
+               return false;
+            }
+         }
+      }
+
+      NodeHierarchy nodes;
+      nodes.reserve(header.nodeCount);
+      for (std::uint32_t i = 0; i < header.nodeCount; i++) {
+         CacheNodeRecord record;
+         std::uint32_t length;
+         std::string name;
+         if (!reader.read(&record, sizeof(record)) || record.parent >= (std::int32_t)i || record.parent < NO_PARENT_NODE ||
+            !reader.read(&length, sizeof(length)) || !reader.readString(name, length)) {
+            return false;
+         }
+         glm::mat4 localTransform;
+         std::memcpy(&localTransform[0][0], record.localTransform, sizeof(record.localTransform));
+         nodes.addNode(name, record.parent, localTransform);
+      }
+
+      outMeshes.insert(outMeshes.end(), std::make_move_iterator(meshes.begin()), std::make_move_iterator(meshes.end()));
+      outNodes = std::move(nodes);
+   }
+   catch (const MappedFile::MappingFailure& e) {
+      return false;
+   }
+
+   // Rewrite the modification times in place once the cache is unmapped, so the files aren't hashed
+   // again on the next load. The cache stays valid if this fails.
+   if (touched || !touchedDependencies.empty()) {
+      std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+      if (file) {
+         file.write((const char*)&header, sizeof(header));
+         for (const std::pair<std::size_t, CacheDependencyRecord>& dependency : touchedDependencies) {
+            file.seekp((std::streamoff)dependency.first);
+            file.write((const char*)&dependency.second, sizeof(dependency.second));
+         }
+      }
+   }
+   return true;
+}
+
+bool ModelCache::save(const std::string& modelPath, std::uint32_t cookFlags, const std::vector<std::string>& dependencies,
+   const std::vector<MeshData>& meshes, const NodeHierarchy& nodes) {
+
+   ScopedLoadTimer timer(LoadStage::CACHE_SAVE);
+   FileInfo sourceInfo;
+   CacheHeader header;
+   if (!MappedFile::getFileInfo(modelPath, sourceInfo) || !hashFile(modelPath, header.sourceHash)) {
+      return false;
+   }
+   std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+   header.version = MODEL_CACHE_VERSION;
+   header.vertexSize = sizeof(Vertex);
+   header.sourceSize = sourceInfo.size;
+   header.sourceModificationTime = sourceInfo.modificationTime;
+   header.meshCount = (std::uint32_t)meshes.size();
+   header.cookFlags = cookFlags;
+   header.nodeCount = (std::uint32_t)nodes.getNodeCount();
+   header.dependencyCount = (std::uint32_t)dependencies.size();
+
+   std::vector<CacheDependencyRecord> dependencyRecords(dependencies.size());
+   for (std::size_t i = 0; i < dependencies.size(); i++) {
+      FileInfo info;
+      CacheDependencyRecord& record = dependencyRecords[i];
+      if (!MappedFile::getFileInfo(dependencies[i], info) || !hashFile(dependencies[i], record.hash)) {
+         return false;
+      }
+      record.size = info.size;
+      record.modificationTime = info.modificationTime;
+      record.pathLength = (std::uint32_t)dependencies[i].size();
+      record.reserved = 0;
+   }
+
+   // Write to a temporary file first so an interrupted write never leaves a truncated cache behind.
+   std::string cachePath = getCachePath(modelPath);
+   std::string tempPath = cachePath + ".tmp";
+   {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      if (!file) {
+         return false;
+      }
+
+      file.write((const char*)&header, sizeof(header));
+      for (std::size_t i = 0; i < dependencies.size(); i++) {
+         file.write((const char*)&dependencyRecords[i], sizeof(dependencyRecords[i]));
+         file.write(dependencies[i].data(), dependencies[i].size());
+      }
+      for (const MeshData& mesh : meshes) {
+         CacheMeshRecord record;
+         record.vertexCount = (std::uint32_t)mesh.Vertices.size();
+         record.indexCount = (std::uint32_t)mesh.Indices.size();
+         record.textureCount = (std::uint32_t)mesh.Textures.size();
+         record.lodCount = (std::uint32_t)mesh.LodIndices.size();
+         record.clusterCount = (std::uint32_t)mesh.Clusters.size();
+         record.node = mesh.Node;
+         record.bounds = mesh.Bounds;
+
+         file.write((const char*)&record, sizeof(record));
+         file.write((const char*)mesh.Vertices.data(), mesh.Vertices.size() * sizeof(Vertex));
+         file.write((const char*)mesh.Indices.data(), mesh.Indices.size() * sizeof(unsigned int));
+         for (const std::vector<unsigned int>& lod : mesh.LodIndices) {
+            std::uint32_t indexCount = (std::uint32_t)lod.size();
+            file.write((const char*)&indexCount, sizeof(indexCount));
+            file.write((const char*)lod.data(), lod.size() * sizeof(unsigned int));
+         }
+         file.write((const char*)mesh.Clusters.data(), mesh.Clusters.size() * sizeof(MeshCluster));
+         for (const TextureRef& texture : mesh.Textures) {
+            writeString(file, texture.type);
+            writeString(file, texture.path);
+         }
+      }
+      for (unsigned int i = 0; i < nodes.getNodeCount(); i++) {
+         CacheNodeRecord record;
+         record.parent = nodes.getParent(i);
+         std::memcpy(record.localTransform, &nodes.getLocalTransform(i)[0][0], sizeof(record.localTransform));
+         file.write((const char*)&record, sizeof(record));
+         writeString(file, nodes.getName(i));
+      }
+
+      if (!file) {
+         file.close();
+         std::remove(tempPath.c_str());
+         return false;
+      }
+      timer.addBytes((std::uint64_t)file.tellp());
+   }
+
+   std::remove(cachePath.c_str());
+   if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+      std::remove(tempPath.c_str());
+      return false;
+   }
+   return true;
+}
@@ -0,0 +1,163 @@
+#include <chrono>
+
+#include "ModelLoader.h"
+#include "LoadProfiler.h"
+#include "ThreadPool.h"
+
+ModelHandle::ModelHandle(const std::string& path, const ModelLoadOptions& options) :
+   LoadedModel(new Model(options)),
+   Path(path),
+   NextTexture(0),
+   NextMesh(0),
+   Ready(false),
+   LoadStart(std::chrono::steady_clock::now()),
+   DoneUnits(0),
+   TotalUnits(0)
+   {
+}
+
+void ModelHandle::cook() {
+
+   LoadedModel->cookModel(Path, MeshesData);
+
+   for (const MeshData& mesh : MeshesData) {
+      for (const TextureRef& ref : mesh.Textures) {
+         bool found = false;
+         for (const TextureRef& uniqueRef : TextureRefs) {
+            if (uniqueRef.path == ref.path) {
+               found = true;
+               break;
+            }
+         }
+         if (!found) {
+            TextureRefs.push_back(ref);
+         }
+      }
+   }
+
+   // Parsing, then a decode and an upload per texture, then an upload per mesh.
+   DoneUnits = 1;
+   TotalUnits = (unsigned int)(1 + 2 * TextureRefs.size() + MeshesData.size());
+
+   // Textures that another model already loaded aren't decoded again, unless they are packed in this model's arrays.
+   DecodedTextures.resize(TextureRefs.size());
+   TextureKeys.resize(TextureRefs.size());
+   const std::string& directory = LoadedModel->Directory;
+   bool compress = LoadedModel->Options.compressTextures;
+   bool useCache = LoadedModel->Options.cacheTextures;
+   bool pack = LoadedModel->Options.packTextures;
+   ThreadPool::getShared().parallelFor(TextureRefs.size(), [&](size_t i) {
+      TextureKeys[i] = TextureCache::getKey(directory + '/' + TextureRefs[i].path);
+      if (pack || !TextureCache::getShared().contains(TextureKeys[i])) {
+         DecodedTextures[i] = TextureData::load(directory + '/' + TextureRefs[i].path, TextureRefs[i].type, compress, useCache);
+      }
+      DoneUnits++;
+   });
+}
+
+void ModelHandle::uploadNext(PixelUploadRing* ring) {
+
+   if (NextTexture < TextureRefs.size() && LoadedModel->Options.packTextures) {
+      // The arrays are uploaded at once, with the last texture.
+      LoadedModel->PackedTextures.add(TextureKeys[NextTexture], std::move(DecodedTextures[NextTexture]));
+      DecodedTextures[NextTexture] = TextureData();
+      NextTexture++;
+      if (NextTexture == TextureRefs.size()) {
+         LoadedModel->PackedTextures.upload();
+      }
+   }
+   else if (NextTexture < TextureRefs.size()) {
+      const TextureRef& ref = TextureRefs[NextTexture];
+      TextureCache& cache = TextureCache::getShared();
+      std::shared_ptr<const Texture> texture = cache.find(TextureKeys[NextTexture]);
+      if (!texture) {
+         // The model that had the texture when this one was cooked may have released it since.
+         if (!DecodedTextures[NextTexture].isLoaded()) {
+            DecodedTextures[NextTexture] = TextureData::load(LoadedModel->Directory + '/' + ref.path, ref.type, LoadedModel->Options.compressTextures, LoadedModel->Options.cacheTextures);
+         }
+         texture = LoadedModel->addTexture(TextureKeys[NextTexture], std::move(DecodedTextures[NextTexture]), ref, ring);
+      }
+      // Held by the model until its meshes pick it up.
+      LoadedModel->holdTexture(TextureKeys[NextTexture], texture);
+      DecodedTextures[NextTexture] = TextureData();
+      NextTexture++;
+   }
+   else {
+      if (NextMesh == 0) {
+         LoadedModel->Meshes.reserve(MeshesData.size());
+         LoadedModel->MeshNodes.reserve(MeshesData.size());
+         if (LoadedModel->Options.sharedBuffers) {
+            LoadedModel->createArena(MeshesData);
+         }
+      }
+      // Every texture of the mesh is already loaded, so this only uploads the mesh's buffers.
+      LoadedModel->uploadMesh(std::move(MeshesData[NextMesh]));
+      MeshesData[NextMesh] = MeshData();
+      NextMesh++;
+   }
+   DoneUnits++;
+}
+
+ModelLoader::ModelLoader(float uploadBudgetMs, PixelUploadRing* ring) :
+   UploadBudgetMs(uploadBudgetMs),
+   UploadRing(ring),
+   LastFrameUploadMs(0.0f),
+   MaxFrameUploadMs(0.0f),
+   LastFrameUploads(0)
+   {
+}
+
+std::shared_ptr<ModelHandle> ModelLoader::loadAsync(const std::string& path, const ModelLoadOptions& options) {
+   std::shared_ptr<ModelHandle> handle(new ModelHandle(path, options));
+   handle->Cooking = ThreadPool::getShared().submit([handle]() { handle->cook(); });
+   Pending.push_back(handle);
+   return handle;
+}
+
+void ModelLoader::processUploads() {
+
+   typedef std::chrono::steady_clock Clock;
+   Clock::time_point start = Clock::now();
+   auto elapsedMs = [start]() {
+      return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+   };
+
+   unsigned int uploads = 0;
+   auto it = Pending.begin();
+   while (it != Pending.end() && (uploads == 0 || elapsedMs() < UploadBudgetMs)) {
+      ModelHandle& handle = **it;
+
+      if (handle.Cooking.valid()) {
+         if (handle.Cooking.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            it++;
+            continue;
+         }
+         try {
+            handle.Cooking.get();
+         }
+         catch (...) {
+            Pending.erase(it);
+            throw;
+         }
+      }
+
+      // At least one upload per frame so loading always makes progress.
+      while (!handle.isUploadDone() && (uploads == 0 || elapsedMs() < UploadBudgetMs)) {
+         handle.uploadNext(UploadRing);
+         uploads++;
+      }
+
+      if (handle.isUploadDone()) {
+         std::chrono::nanoseconds loadTime = Clock::now() - handle.LoadStart;
+         LoadProfiler::add(LoadStage::TOTAL, (std::uint64_t)loadTime.count(), 0);
+         handle.Ready.store(true, std::memory_order_release);
+         it = Pending.erase(it);
+      }
+   }
+
+   LastFrameUploads = uploads;
+   LastFrameUploadMs = uploads == 0 ? 0.0f : elapsedMs();
+   if (LastFrameUploadMs > MaxFrameUploadMs) {
+      MaxFrameUploadMs = LastFrameUploadMs;
+   }
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+
+#include "NodeHierarchy.h"
+#include "OpenGLErrorHandling.h"
+
+unsigned int NodeHierarchy::addNode(const std::string& name, int parent, const glm::mat4& localTransform) {
+   ASSERT(parent < (int)Parents.size());
+
+   bool wasDirty = isDirty();
+   unsigned int node = (unsigned int)Parents.size();
+   Parents.push_back(parent);
+   LocalTransforms.push_back(localTransform);
+   WorldTransforms.push_back(parent == NO_PARENT_NODE ? localTransform : WorldTransforms[parent] * localTransform);
+   DirtyFlags.push_back(0);
+   Names.push_back(name);
+
+   // A node added under a flagged parent is out of date as well.
+   if (parent != NO_PARENT_NODE && DirtyFlags[parent]) {
+      DirtyFlags[node] = 1;
+   }
+   if (!wasDirty) {
+      FirstDirty = Parents.size();
+   }
+   return node;
+}
+
+void NodeHierarchy::clear() {
+   Parents.clear();
+   LocalTransforms.clear();
+   WorldTransforms.clear();
+   DirtyFlags.clear();
+   Names.clear();
+   FirstDirty = 0;
+}
+
+void NodeHierarchy::reserve(size_t nodeCount) {
+   Parents.reserve(nodeCount);
+   LocalTransforms.reserve(nodeCount);
+   WorldTransforms.reserve(nodeCount);
+   DirtyFlags.reserve(nodeCount);
+   Names.reserve(nodeCount);
+}
+
+void NodeHierarchy::setLocalTransform(unsigned int node, const glm::mat4& localTransform) {
+   LocalTransforms[node] = localTransform;
+   DirtyFlags[node] = 1;
+   FirstDirty = std::min(FirstDirty, (size_t)node);
+}
+
+size_t NodeHierarchy::updateWorldTransforms() {
+
+   size_t nodeCount = Parents.size();
+   size_t updated = 0;
+   // Parents come before their children, so a parent's flag and world transform are final by the time its children are reached.
+   for (size_t i = FirstDirty; i < nodeCount; i++) {
+      int parent = Parents[i];
+      if (parent != NO_PARENT_NODE && DirtyFlags[parent]) {
+         DirtyFlags[i] = 1;
+      }
+      if (DirtyFlags[i]) {
+         WorldTransforms[i] = parent == NO_PARENT_NODE ? LocalTransforms[i] : WorldTransforms[parent] * LocalTransforms[i];
+         updated++;
+      }
+   }
+   if (FirstDirty < nodeCount) {
+      std::fill(DirtyFlags.begin() + FirstDirty, DirtyFlags.end(), 0);
+   }
+   FirstDirty = nodeCount;
+   return updated;
+}
+
+int NodeHierarchy::findNode(const std::string& name) const {
+   for (size_t i = 0; i < Names.size(); i++) {
+      if (Names[i] == name) {
+         return (int)i;
+      }
+   }
+   return -1;
+}
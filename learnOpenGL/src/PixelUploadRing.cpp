@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "PixelUploadRing.h"
+#include "GLStateCache.h"
+#include "OpenGLErrorHandling.h"
+
+PixelUploadRing::PixelUploadRing(std::size_t slotSize, unsigned int slotCount, ThreadPool* pool) :
+   SlotSize(slotSize),
+   CurrentSlot(0),
+   Offset(0),
+   Persistent(GLAD_GL_VERSION_4_4 && glBufferStorage != nullptr),
+   Pool(pool),
+   Stats()
+   {
+
+   Slots.resize(slotCount);
+   for (Slot& slot : Slots) {
+      slot.Fence = nullptr;
+      slot.Mapped = nullptr;
+      GLCall(glGenBuffers(1, &slot.Buffer));
+      GLStateCache::getShared().bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+      if (Persistent) {
+         // Coherent, so the copies are visible to the GPU without flushing them.
+         GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+         GLCall(glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SlotSize, nullptr, flags));
+         slot.Mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SlotSize, flags);
+      }
+      else {
+         GLCall(glBufferData(GL_PIXEL_UNPACK_BUFFER, SlotSize, nullptr, GL_STREAM_DRAW));
+      }
+   }
+   GLStateCache::getShared().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+PixelUploadRing::~PixelUploadRing() {
+   for (Slot& slot : Slots) {
+      if (slot.Fence != nullptr) {
+         glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+         GLCall(glDeleteSync(slot.Fence));
+      }
+      if (slot.Mapped != nullptr) {
+         GLStateCache::getShared().bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+         GLCall(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+      }
+      GLStateCache::getShared().deleteBuffers(1, &slot.Buffer);
+   }
+   GLStateCache::getShared().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool PixelUploadRing::uploadLevel(const TextureData& data, unsigned int level) {
+
+   const TextureLevel& source = data.Levels[level];
+   if (source.Size > SlotSize) {
+      Stats.directUploads++;
+      return false;
+   }
+   if (Offset + source.Size > SlotSize) {
+      advanceSlot();
+   }
+
+   Slot& slot = Slots[CurrentSlot];
+   GLStateCache::getShared().bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.Buffer);
+   unsigned char* destination;
+   if (Persistent) {
+      destination = slot.Mapped + Offset;
+   }
+   else {
+      // Nothing reads the range since the slot's fence signaled, so the mapping doesn't need to wait for the GPU.
+      destination = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, Offset, source.Size,
+         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+   }
+
+   std::size_t chunkCount = (source.Size + UPLOAD_COPY_CHUNK_SIZE - 1) / UPLOAD_COPY_CHUNK_SIZE;
+   auto copyChunk = [&](std::size_t chunk) {
+      std::size_t offset = chunk * UPLOAD_COPY_CHUNK_SIZE;
+      std::memcpy(destination + offset, source.Data + offset, std::min((std::size_t)UPLOAD_COPY_CHUNK_SIZE, source.Size - offset));
+   };
+   if (Pool != nullptr && chunkCount > 1) {
+      Pool->parallelFor(chunkCount, copyChunk);
+   }
+   else {
+      for (std::size_t chunk = 0; chunk < chunkCount; chunk++) {
+         copyChunk(chunk);
+      }
+   }
+
+   if (!Persistent) {
+      GLCall(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+   }
+   // With an unpack buffer bound, the pixels are an offset in it.
+   data.specifyLevel(level, (const void*)Offset);
+   GLStateCache::getShared().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+   Offset += (source.Size + UPLOAD_OFFSET_ALIGNMENT - 1) / UPLOAD_OFFSET_ALIGNMENT * UPLOAD_OFFSET_ALIGNMENT;
+   Stats.uploads++;
+   Stats.bytes += source.Size;
+   return true;
+}
+
+void PixelUploadRing::advanceSlot() {
+
+   Slots[CurrentSlot].Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   CurrentSlot = (CurrentSlot + 1) % (unsigned int)Slots.size();
+   Offset = 0;
+
+   Slot& slot = Slots[CurrentSlot];
+   if (slot.Fence == nullptr) {
+      return;
+   }
+   if (glClientWaitSync(slot.Fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      // The flush makes sure the fence reaches the GPU, or the wait could never end.
+      GLenum status = GL_TIMEOUT_EXPIRED;
+      while (status == GL_TIMEOUT_EXPIRED) {
+         status = glClientWaitSync(slot.Fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+      }
+      Stats.stalls++;
+      Stats.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   }
+   GLCall(glDeleteSync(slot.Fence));
+   slot.Fence = nullptr;
+}
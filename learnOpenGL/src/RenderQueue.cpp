@@ -0,0 +1,178 @@
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "MeshArena.h"
+#include "TexturePacker.h"
+#include "OpenGLErrorHandling.h"
+
+// The fields of the sort keys, from the most significant bits.
+#define SORT_KEY_PASS_SHIFT     62
+#define SORT_KEY_PROGRAM_SHIFT  48
+#define SORT_KEY_PROGRAM_MASK   0x3FFFu
+#define SORT_KEY_TEXTURES_SHIFT 32
+#define SORT_KEY_VAO_SHIFT      16
+#define SORT_KEY_FIELD_MASK     0xFFFFu
+// The transparent items are sorted by depth first, right after the pass.
+#define SORT_KEY_TRANSPARENT_DEPTH_SHIFT 46
+
+namespace {
+
+   /**
+      Gets the 16 most significant bits of the depth, which sort like it since it's positive.
+    */
+   std::uint64_t getDepthBits(float depth) {
+      depth = depth > 0.0f ? depth : 0.0f;
+      std::uint32_t bits;
+      std::memcpy(&bits, &depth, sizeof(bits));
+      return bits >> 16;
+   }
+}
+
+RenderQueue::RenderQueue() :
+   Stats()
+   {
+}
+
+void RenderQueue::push(const DrawItem& item, float depth, RenderPass pass) {
+   Entries.push_back({ getKey(item, depth, pass), (std::uint32_t)Items.size() });
+   Items.push_back(item);
+}
+
+void RenderQueue::submit() {
+
+   Stats.items = Items.size();
+   Stats.pushed = countStateChanges();
+   sortEntries();
+   Stats.sorted = countStateChanges();
+
+   const DrawItem* previous = nullptr;
+   const MeshArena* boundArena = nullptr;
+   const TexturePacker* boundTextures = nullptr;
+   for (const SortEntry& entry : Entries) {
+      const DrawItem& item = Items[entry.Item];
+      Shader& program = *item.Program;
+
+      bool programChanged = previous == nullptr || item.Program != previous->Program;
+      if (programChanged) {
+         program.use();
+      }
+      if (programChanged || item.ModelMat != previous->ModelMat) {
+         program.setUniform("ModelMat", item.ModelMat);
+      }
+      if (item.Arena != nullptr && item.Arena != boundArena) {
+         item.Arena->bind();
+         boundArena = item.Arena;
+      }
+      if (item.PackedTextures != nullptr && item.PackedTextures != boundTextures) {
+         item.PackedTextures->bind();
+         boundTextures = item.PackedTextures;
+      }
+      bool texturesBound = previous != nullptr && haveSameTextures(*previous, item);
+
+      Mesh& mesh = *item.DrawnMesh;
+      if (item.CullClusters) {
+         mesh.drawClusters(program, Frustum(item.ClusterViewProjection), item.ClusterCameraPosition, texturesBound);
+      }
+      else if (item.Arena != nullptr) {
+         mesh.drawInArena(program, item.Lod, texturesBound);
+      }
+      else {
+         mesh.draw(program, item.Lod, texturesBound);
+      }
+      if (item.Arena == nullptr) {
+         // The mesh bound its own VAO.
+         boundArena = nullptr;
+      }
+      previous = &item;
+   }
+   if (previous != nullptr) {
+      GLStateCache::getShared().bindVertexArray(0);
+   }
+
+   Items.clear();
+   Entries.clear();
+}
+
+void RenderQueue::printReport(std::ostream& stream) const {
+   stream << "RENDER QUEUE: " << Stats.items << " items, state changes as pushed / sorted: "
+      << Stats.pushed.programs << " / " << Stats.sorted.programs << " programs, "
+      << Stats.pushed.textures << " / " << Stats.sorted.textures << " textures, "
+      << Stats.pushed.vertexArrays << " / " << Stats.sorted.vertexArrays << " VAOs" << std::endl;
+}
+
+std::uint64_t RenderQueue::getKey(const DrawItem& item, float depth, RenderPass pass) {
+
+   std::uint64_t program = item.Program->getProgramId() & SORT_KEY_PROGRAM_MASK;
+   std::uint64_t textures = item.DrawnMesh->getTextureKey() & SORT_KEY_FIELD_MASK;
+   std::uint64_t vertexArray = getVertexArray(item) & SORT_KEY_FIELD_MASK;
+   std::uint64_t depthBits = getDepthBits(depth);
+
+   if (pass == RenderPass::TRANSPARENT) {
+      // Blending needs the items back to front, whatever their state.
+      return ((std::uint64_t)pass << SORT_KEY_PASS_SHIFT) | ((SORT_KEY_FIELD_MASK - depthBits) << SORT_KEY_TRANSPARENT_DEPTH_SHIFT)
+         | (program << SORT_KEY_TEXTURES_SHIFT) | (textures << SORT_KEY_VAO_SHIFT) | vertexArray;
+   }
+   return ((std::uint64_t)pass << SORT_KEY_PASS_SHIFT) | (program << SORT_KEY_PROGRAM_SHIFT)
+      | (textures << SORT_KEY_TEXTURES_SHIFT) | (vertexArray << SORT_KEY_VAO_SHIFT) | depthBits;
+}
+
+void RenderQueue::sortEntries() {
+
+   // The histograms of all the bytes are counted in a single pass over the keys.
+   std::size_t counts[8][256] = {};
+   for (const SortEntry& entry : Entries) {
+      for (unsigned int byte = 0; byte < 8; byte++) {
+         counts[byte][(entry.Key >> (byte * 8)) & 0xFF]++;
+      }
+   }
+
+   SortBuffer.resize(Entries.size());
+   for (unsigned int byte = 0; byte < 8; byte++) {
+      std::size_t* byteCounts = counts[byte];
+      // A byte all the keys share doesn't change the order.
+      if (Entries.empty() || byteCounts[(Entries[0].Key >> (byte * 8)) & 0xFF] == Entries.size()) {
+         continue;
+      }
+      std::size_t offsets[256];
+      std::size_t offset = 0;
+      for (unsigned int i = 0; i < 256; i++) {
+         offsets[i] = offset;
+         offset += byteCounts[i];
+      }
+      for (const SortEntry& entry : Entries) {
+         SortBuffer[offsets[(entry.Key >> (byte * 8)) & 0xFF]++] = entry;
+      }
+      Entries.swap(SortBuffer);
+   }
+}
+
+StateChanges RenderQueue::countStateChanges() const {
+   StateChanges changes = {};
+   const DrawItem* previous = nullptr;
+   for (const SortEntry& entry : Entries) {
+      const DrawItem& item = Items[entry.Item];
+      if (previous == nullptr || item.Program != previous->Program) {
+         changes.programs++;
+      }
+      if (previous == nullptr || !haveSameTextures(*previous, item)) {
+         changes.textures++;
+      }
+      if (previous == nullptr || getVertexArray(item) != getVertexArray(*previous)) {
+         changes.vertexArrays++;
+      }
+      previous = &item;
+   }
+   return changes;
+}
+
+unsigned int RenderQueue::getVertexArray(const DrawItem& item) {
+   return item.Arena != nullptr ? item.Arena->getVertexArray() : item.DrawnMesh->getVertexArray();
+}
+
+bool RenderQueue::haveSameTextures(const DrawItem& a, const DrawItem& b) {
+   return a.PackedTextures == b.PackedTextures && a.DrawnMesh->hasSameTextures(*b.DrawnMesh);
+}
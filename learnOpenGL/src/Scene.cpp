@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#include "Frustum.h"
+#include "Scene.h"
+
+unsigned int Scene::addInstance(Model& model, const glm::mat4& modelMat) {
+   Models.push_back(&model);
+   ModelMats.push_back(modelMat);
+   ModelBounds.push_back(model.getBounds());
+   return (unsigned int)Models.size() - 1;
+}
+
+void Scene::setTransform(unsigned int instance, const glm::mat4& modelMat) {
+   ModelMats[instance] = modelMat;
+   if (instance < InstanceBvh.getItemCount()) {
+      InstanceBvh.setItemBounds(instance, getInstanceBounds(instance));
+   }
+}
+
+void Scene::update() {
+
+   if (InstanceBvh.getItemCount() != Models.size()) {
+      std::vector<BoundingBox> instanceBounds(Models.size());
+      for (unsigned int i = 0; i < Models.size(); i++) {
+         ModelBounds[i] = Models[i]->getBounds();
+         instanceBounds[i] = getInstanceBounds(i);
+      }
+      InstanceBvh.build(instanceBounds);
+      return;
+   }
+
+   // Only the instances whose model's box changed dirty their leaf, on top of those that moved.
+   for (unsigned int i = 0; i < Models.size(); i++) {
+      BoundingBox bounds = Models[i]->getBounds();
+      if (bounds.Min != ModelBounds[i].Min || bounds.Max != ModelBounds[i].Max) {
+         ModelBounds[i] = bounds;
+         InstanceBvh.setItemBounds(i, getInstanceBounds(i));
+      }
+   }
+   InstanceBvh.refit();
+}
+
+void Scene::enqueue(RenderQueue& queue, Shader& shader) {
+   for (unsigned int i = 0; i < Models.size(); i++) {
+      Models[i]->enqueue(queue, shader, ModelMats[i]);
+   }
+}
+
+void Scene::enqueue(RenderQueue& queue, Shader& shader, const Camera& camera, const glm::mat4& projectionMat) {
+
+   update();
+   FoundInstances.clear();
+   InstanceBvh.queryFrustum(Frustum(camera, projectionMat), FoundInstances);
+   for (unsigned int instance : FoundInstances) {
+      Models[instance]->enqueue(queue, shader, camera, projectionMat, ModelMats[instance]);
+   }
+}
+
+bool Scene::pick(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ScenePick& outPick) {
+
+   update();
+   RayHits.clear();
+   InstanceBvh.queryRay(origin, direction, maxDistance, RayHits);
+   // The meshes of an instance are inside its box, so once the ray enters an instance's box
+   // past the closest mesh found, neither it nor the next ones can hold a closer one.
+   std::sort(RayHits.begin(), RayHits.end(), [](const BvhRayHit& a, const BvhRayHit& b) {
+      return a.distance < b.distance;
+   });
+
+   bool found = false;
+   outPick.distance = maxDistance;
+   for (const BvhRayHit& instanceHit : RayHits) {
+      if (instanceHit.distance > outPick.distance) {
+         break;
+      }
+      BvhRayHit meshHit;
+      if (Models[instanceHit.item]->pickMesh(origin, direction, ModelMats[instanceHit.item], outPick.distance, meshHit) &&
+         (!found || meshHit.distance < outPick.distance)) {
+         found = true;
+         outPick.instance = instanceHit.item;
+         outPick.mesh = meshHit.item;
+         outPick.distance = meshHit.distance;
+      }
+   }
+   return found;
+}
+
+bool Scene::findNearest(const glm::vec3& point, float maxDistance, ScenePick& outPick) {
+
+   update();
+   FoundInstances.clear();
+   InstanceBvh.querySphere(point, maxDistance, FoundInstances);
+
+   bool found = false;
+   outPick.distance = maxDistance;
+   for (unsigned int instance : FoundInstances) {
+      unsigned int mesh;
+      float distance;
+      if (Models[instance]->findNearestMesh(point, ModelMats[instance], outPick.distance, mesh, distance) &&
+         (!found || distance < outPick.distance)) {
+         found = true;
+         outPick.instance = instance;
+         outPick.mesh = mesh;
+         outPick.distance = distance;
+      }
+   }
+   return found;
+}
+
+BoundingBox Scene::getInstanceBounds(unsigned int instance) const {
+   MeshBounds bounds;
+   bounds.Box = ModelBounds[instance];
+   bounds.Sphere.Center = (bounds.Box.Min + bounds.Box.Max) * 0.5f;
+   bounds.Sphere.Radius = glm::length(bounds.Box.Max - bounds.Box.Min) * 0.5f;
+   return BoundingVolumes::transform(bounds, ModelMats[instance]).Box;
+}
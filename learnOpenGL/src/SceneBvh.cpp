@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+#include "SceneBvh.h"
+#include "OpenGLErrorHandling.h"
+
+// The parent of the root node.
+#define NO_PARENT UINT_MAX
+
+namespace {
+
+   BoundingBox emptyBox() {
+      float infinity = std::numeric_limits<float>::infinity();
+      return { glm::vec3(infinity), glm::vec3(-infinity) };
+   }
+
+   /**
+      Gets half the surface area of the box, which is all the heuristic needs to compare costs.
+    */
+   float getHalfArea(const BoundingBox& box) {
+      glm::vec3 size = box.Max - box.Min;
+      return size.x * size.y + size.y * size.z + size.z * size.x;
+   }
+
+   void growBox(BoundingBox& box, const BoundingBox& other) {
+      box.Min = glm::min(box.Min, other.Min);
+      box.Max = glm::max(box.Max, other.Max);
+   }
+}
+
+void SceneBvh::build(const std::vector<BoundingBox>& itemBounds, ThreadPool* pool) {
+
+   ItemBounds = itemBounds;
+   unsigned int itemCount = (unsigned int)ItemBounds.size();
+   ItemOrder.resize(itemCount);
+   std::iota(ItemOrder.begin(), ItemOrder.end(), 0u);
+   Nodes.clear();
+   DirtyLeaves.clear();
+   if (itemCount == 0) {
+      linkNodes();
+      return;
+   }
+
+   std::vector<glm::vec3> centroids(itemCount);
+   for (unsigned int i = 0; i < itemCount; i++) {
+      centroids[i] = (ItemBounds[i].Min + ItemBounds[i].Max) * 0.5f;
+   }
+
+   Nodes.reserve(2 * (size_t)itemCount);
+   Nodes.push_back(BvhNode());
+   bool parallel = pool != nullptr && pool->getThreadCount() > 0;
+   std::vector<PendingSubtree> pending;
+   buildNode(Nodes, centroids, 0, 0, itemCount, 0, parallel ? &pending : nullptr);
+   if (pending.empty()) {
+      linkNodes();
+      return;
+   }
+
+   // The subtrees own disjoint ranges of the item order, so each is built into a node vector of its own.
+   std::vector<std::vector<BvhNode>> subtrees(pending.size());
+   pool->parallelFor(pending.size(), [&](size_t i) {
+      const PendingSubtree& subtree = pending[i];
+      subtrees[i].reserve(2 * (size_t)(subtree.end - subtree.begin));
+      subtrees[i].push_back(BvhNode());
+      buildNode(subtrees[i], centroids, 0, subtree.begin, subtree.end, subtree.depth, nullptr);
+   });
+
+   // The root of each subtree replaces its placeholder and the other nodes are appended, so children still come after their parents.
+   for (size_t i = 0; i < pending.size(); i++) {
+      unsigned int offset = (unsigned int)Nodes.size() - 1;
+      for (BvhNode& node : subtrees[i]) {
+         if (node.Count == 0) {
+            node.First += offset;
+         }
+      }
+      Nodes[pending[i].node] = subtrees[i][0];
+      Nodes.insert(Nodes.end(), subtrees[i].begin() + 1, subtrees[i].end());
+   }
+   linkNodes();
+}
+
+void SceneBvh::setItemBounds(unsigned int item, const BoundingBox& bounds) {
+   ItemBounds[item] = bounds;
+   setOrderedBox(ItemSlots[item], bounds);
+   unsigned int leaf = ItemLeaves[item];
+   if (!LeafDirtyFlags[leaf]) {
+      LeafDirtyFlags[leaf] = 1;
+      DirtyLeaves.push_back(leaf);
+   }
+}
+
+size_t SceneBvh::refit() {
+
+   size_t refitted = 0;
+   for (unsigned int leaf : DirtyLeaves) {
+      LeafDirtyFlags[leaf] = 0;
+      // Once a node keeps its box, so do all its ancestors, which were fitted to it.
+      for (unsigned int node = leaf; node != NO_PARENT; node = Parents[node]) {
+         refitted++;
+         if (!refitNode(node)) {
+            break;
+         }
+      }
+   }
+   DirtyLeaves.clear();
+   return refitted;
+}
+
+void SceneBvh::refitAll() {
+   for (size_t i = Nodes.size(); i-- > 0;) {
+      refitNode((unsigned int)i);
+   }
+   for (unsigned int leaf : DirtyLeaves) {
+      LeafDirtyFlags[leaf] = 0;
+   }
+   DirtyLeaves.clear();
+}
+
+void SceneBvh::queryFrustum(const Frustum& frustum, std::vector<unsigned int>& outItems) const {
+
+   if (Nodes.empty()) {
+      return;
+   }
+   unsigned int stack[BVH_MAX_DEPTH + 1];
+   unsigned int stackSize = 0;
+   stack[stackSize++] = 0;
+   while (stackSize > 0) {
+      unsigned int index = stack[--stackSize];
+      const BvhNode& node = Nodes[index];
+      FrustumTest test = frustum.classifyBox((node.Min + node.Max) * 0.5f, (node.Max - node.Min) * 0.5f);
+      if (test == FrustumTest::OUTSIDE) {
+         continue;
+      }
+      if (test == FrustumTest::INSIDE) {
+         unsigned int begin, end;
+         getItemRange(index, begin, end);
+         outItems.insert(outItems.end(), ItemOrder.begin() + begin, ItemOrder.begin() + end);
+      }
+      else if (node.Count > 0) {
+         // Leaves at the depth limit may hold more than BVH_MAX_LEAF_SIZE items.
+         unsigned char visible[BVH_MAX_LEAF_SIZE];
+         unsigned int end = node.First + node.Count;
+         for (unsigned int first = node.First; first < end; first += BVH_MAX_LEAF_SIZE) {
+            unsigned int count = std::min(end - first, (unsigned int)BVH_MAX_LEAF_SIZE);
+            frustum.cullBoxes(getOrderedBoxes(first, count), visible);
+            for (unsigned int i = 0; i < count; i++) {
+               if (visible[i]) {
+                  outItems.push_back(ItemOrder[first + i]);
+               }
+            }
+         }
+      }
+      else {
+         stack[stackSize++] = node.First + 1;
+         stack[stackSize++] = node.First;
+      }
+   }
+}
+
+void SceneBvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<BvhRayHit>& outHits) const {
+
+   if (Nodes.empty()) {
+      return;
+   }
+   glm::vec3 inverseDirection = 1.0f / direction;
+   float distance;
+   unsigned int stack[BVH_MAX_DEPTH + 1];
+   unsigned int stackSize = 0;
+   stack[stackSize++] = 0;
+   while (stackSize > 0) {
+      const BvhNode& node = Nodes[stack[--stackSize]];
+      if (!intersectRay({ node.Min, node.Max }, origin, inverseDirection, maxDistance, distance)) {
+         continue;
+      }
+      if (node.Count > 0) {
+         for (unsigned int i = node.First; i < node.First + node.Count; i++) {
+            if (intersectRay(ItemBounds[ItemOrder[i]], origin, inverseDirection, maxDistance, distance)) {
+               outHits.push_back({ ItemOrder[i], distance });
+            }
+         }
+      }
+      else {
+         stack[stackSize++] = node.First + 1;
+         stack[stackSize++] = node.First;
+      }
+   }
+}
+
+bool SceneBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& outHit) const {
+
+   if (Nodes.empty()) {
+      return false;
+   }
+   glm::vec3 inverseDirection = 1.0f / direction;
+   float distance;
+   if (!intersectRay({ Nodes[0].Min, Nodes[0].Max }, origin, inverseDirection, maxDistance, distance)) {
+      return false;
+   }
+
+   bool hit = false;
+   outHit.distance = maxDistance;
+   std::pair<unsigned int, float> stack[BVH_MAX_DEPTH + 1];
+   unsigned int stackSize = 0;
+   stack[stackSize++] = { 0, distance };
+   while (stackSize > 0) {
+      std::pair<unsigned int, float> entry = stack[--stackSize];
+      // A closer hit was found since the node was pushed.
+      if (entry.second > outHit.distance) {
+         continue;
+      }
+      const BvhNode& node = Nodes[entry.first];
+      if (node.Count > 0) {
+         for (unsigned int i = node.First; i < node.First + node.Count; i++) {
+            if (intersectRay(ItemBounds[ItemOrder[i]], origin, inverseDirection, outHit.distance, distance)
+               && (!hit || distance < outHit.distance)) {
+               hit = true;
+               outHit.item = ItemOrder[i];
+               outHit.distance = distance;
+            }
+         }
+         continue;
+      }
+
+      // The nearer child is pushed last so it's visited first, and its hits can skip the farther one.
+      const BvhNode& left = Nodes[node.First];
+      const BvhNode& right = Nodes[node.First + 1];
+      float leftDistance, rightDistance;
+      bool hitsLeft = intersectRay({ left.Min, left.Max }, origin, inverseDirection, outHit.distance, leftDistance);
+      bool hitsRight = intersectRay({ right.Min, right.Max }, origin, inverseDirection, outHit.distance, rightDistance);
+      if (hitsLeft && hitsRight) {
+         if (leftDistance < rightDistance) {
+            stack[stackSize++] = { node.First + 1, rightDistance };
+            stack[stackSize++] = { node.First, leftDistance };
+         }
+         else {
+            stack[stackSize++] = { node.First, leftDistance };
+            stack[stackSize++] = { node.First + 1, rightDistance };
+         }
+      }
+      else if (hitsLeft) {
+         stack[stackSize++] = { node.First, leftDistance };
+      }
+      else if (hitsRight) {
+         stack[stackSize++] = { node.First + 1, rightDistance };
+      }
+   }
+   return hit;
+}
+
+void SceneBvh::querySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& outItems) const {
+
+   if (Nodes.empty()) {
+      return;
+   }
+   float radiusSquared = radius * radius;
+   unsigned int stack[BVH_MAX_DEPTH + 1];
+   unsigned int stackSize = 0;
+   stack[stackSize++] = 0;
+   while (stackSize > 0) {
+      const BvhNode& node = Nodes[stack[--stackSize]];
+      if (getDistanceSquared({ node.Min, node.Max }, center) > radiusSquared) {
+         continue;
+      }
+      if (node.Count > 0) {
+         for (unsigned int i = node.First; i < node.First + node.Count; i++) {
+            if (getDistanceSquared(ItemBounds[ItemOrder[i]], center) <= radiusSquared) {
+               outItems.push_back(ItemOrder[i]);
+            }
+         }
+      }
+      else {
+         stack[stackSize++] = node.First + 1;
+         stack[stackSize++] = node.First;
+      }
+   }
+}
+
+bool SceneBvh::findNearest(const glm::vec3& point, float maxDistance, unsigned int& outItem, float& outDistance) const {
+
+   if (Nodes.empty()) {
+      return false;
+   }
+   bool found = false;
+   float bestSquared = maxDistance * maxDistance;
+   std::pair<unsigned int, float> stack[BVH_MAX_DEPTH + 1];
+   unsigned int stackSize = 0;
+   stack[stackSize++] = { 0, getDistanceSquared({ Nodes[0].Min, Nodes[0].Max }, point) };
+   while (stackSize > 0) {
+      std::pair<unsigned int, float> entry = stack[--stackSize];
+      if (entry.second > bestSquared) {
+         continue;
+      }
+      const BvhNode& node = Nodes[entry.first];
+      if (node.Count > 0) {
+         for (unsigned int i = node.First; i < node.First + node.Count; i++) {
+            float distanceSquared = getDistanceSquared(ItemBounds[ItemOrder[i]], point);
+            if (distanceSquared <= bestSquared && (!found || distanceSquared < bestSquared)) {
+               found = true;
+               outItem = ItemOrder[i];
+               bestSquared = distanceSquared;
+            }
+         }
+         continue;
+      }
+
+      const BvhNode& left = Nodes[node.First];
+      const BvhNode& right = Nodes[node.First + 1];
+      float leftSquared = getDistanceSquared({ left.Min, left.Max }, point);
+      float rightSquared = getDistanceSquared({ right.Min, right.Max }, point);
+      if (leftSquared < rightSquared) {
+         stack[stackSize++] = { node.First + 1, rightSquared };
+         stack[stackSize++] = { node.First, leftSquared };
+      }
+      else {
+         stack[stackSize++] = { node.First, leftSquared };
+         stack[stackSize++] = { node.First + 1, rightSquared };
+      }
+   }
+   if (found) {
+      outDistance = glm::sqrt(bestSquared);
+   }
+   return found;
+}
+
+bool SceneBvh::intersectRay(const BoundingBox& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& outDistance) {
+   glm::vec3 toMin = (box.Min - origin) * inverseDirection;
+   glm::vec3 toMax = (box.Max - origin) * inverseDirection;
+   glm::vec3 nearDistances = glm::min(toMin, toMax);
+   glm::vec3 farDistances = glm::max(toMin, toMax);
+   float enter = std::max(std::max(nearDistances.x, nearDistances.y), std::max(nearDistances.z, 0.0f));
+   float exit = std::min(std::min(farDistances.x, farDistances.y), std::min(farDistances.z, maxDistance));
+   outDistance = enter;
+   return enter <= exit;
+}
+
+float SceneBvh::getDistanceSquared(const BoundingBox& box, const glm::vec3& point) {
+   glm::vec3 offset = point - glm::clamp(point, box.Min, box.Max);
+   return glm::dot(offset, offset);
+}
+
+void SceneBvh::buildNode(std::vector<BvhNode>& nodes, const std::vector<glm::vec3>& centroids, unsigned int node,
+   unsigned int begin, unsigned int end, unsigned int depth, std::vector<PendingSubtree>* outPending) {
+
+   BoundingBox bounds = computeRangeBounds(begin, end);
+   nodes[node].Min = bounds.Min;
+   nodes[node].Max = bounds.Max;
+   nodes[node].First = begin;
+   nodes[node].Count = end - begin;
+
+   if (outPending != nullptr && end - begin <= BVH_TASK_SIZE) {
+      outPending->push_back({ node, begin, end, depth });
+      return;
+   }
+   if (end - begin < BVH_MIN_SPLIT_SIZE || depth + 1 >= BVH_MAX_DEPTH) {
+      return;
+   }
+   unsigned int middle = partitionItems(centroids, bounds, begin, end);
+   if (middle == end) {
+      return;
+   }
+
+   // The children are pushed before either is built, so they're next to each other.
+   unsigned int first = (unsigned int)nodes.size();
+   nodes.push_back(BvhNode());
+   nodes.push_back(BvhNode());
+   nodes[node].First = first;
+   nodes[node].Count = 0;
+   buildNode(nodes, centroids, first, begin, middle, depth + 1, outPending);
+   buildNode(nodes, centroids, first + 1, middle, end, depth + 1, outPending);
+}
+
+unsigned int SceneBvh::partitionItems(const std::vector<glm::vec3>& centroids, const BoundingBox& nodeBounds, unsigned int begin, unsigned int end) {
+
+   unsigned int count = end - begin;
+   glm::vec3 centroidMin = centroids[ItemOrder[begin]];
+   glm::vec3 centroidMax = centroidMin;
+   for (unsigned int i = begin + 1; i < end; i++) {
+      centroidMin = glm::min(centroidMin, centroids[ItemOrder[i]]);
+      centroidMax = glm::max(centroidMax, centroids[ItemOrder[i]]);
+   }
+   glm::vec3 centroidExtent = centroidMax - centroidMin;
+
+   float bestCost = std::numeric_limits<float>::infinity();
+   int bestAxis = -1;
+   int bestSplit = 0;
+   for (int axis = 0; axis < 3; axis++) {
+      if (centroidExtent[axis] <= 0.0f) {
+         continue;
+      }
+      float scale = BVH_BIN_COUNT / centroidExtent[axis];
+      unsigned int binCounts[BVH_BIN_COUNT] = {};
+      BoundingBox binBounds[BVH_BIN_COUNT];
+      std::fill(binBounds, binBounds + BVH_BIN_COUNT, emptyBox());
+      for (unsigned int i = begin; i < end; i++) {
+         unsigned int item = ItemOrder[i];
+         int bin = std::min((int)((centroids[item][axis] - centroidMin[axis]) * scale), BVH_BIN_COUNT - 1);
+         binCounts[bin]++;
+         growBox(binBounds[bin], ItemBounds[item]);
+      }
+
+      // The costs of the items left of each split, then added to the costs of the items right of it.
+      float splitCosts[BVH_BIN_COUNT - 1];
+      BoundingBox sweep = emptyBox();
+      unsigned int sweepCount = 0;
+      for (int split = 0; split < BVH_BIN_COUNT - 1; split++) {
+         sweepCount += binCounts[split];
+         growBox(sweep, binBounds[split]);
+         splitCosts[split] = sweepCount > 0 ? sweepCount * getHalfArea(sweep) : 0.0f;
+      }
+      sweep = emptyBox();
+      sweepCount = 0;
+      for (int split = BVH_BIN_COUNT - 2; split >= 0; split--) {
+         sweepCount += binCounts[split + 1];
+         growBox(sweep, binBounds[split + 1]);
+         // Splits with an empty side don't divide anything.
+         if (sweepCount == 0 || sweepCount == count) {
+            continue;
+         }
+         float cost = splitCosts[split] + sweepCount * getHalfArea(sweep);
+         if (cost < bestCost) {
+            bestCost = cost;
+            bestAxis = axis;
+            bestSplit = split;
+         }
+      }
+   }
+
+   float nodeArea = getHalfArea(nodeBounds);
+   if (bestAxis == -1) {
+      // Every centroid is at the same place, so there's nothing to tell the items apart: keep them or cut the range in half.
+      return count <= BVH_MAX_LEAF_SIZE ? end : begin + count / 2;
+   }
+   bestCost = nodeArea > 0.0f ? BVH_TRAVERSAL_COST + bestCost / nodeArea : BVH_TRAVERSAL_COST;
+   if (bestCost >= (float)count && count <= BVH_MAX_LEAF_SIZE) {
+      return end;
+   }
+
+   float scale = BVH_BIN_COUNT / centroidExtent[bestAxis];
+   float axisMin = centroidMin[bestAxis];
+   auto middle = std::partition(ItemOrder.begin() + begin, ItemOrder.begin() + end, [&](unsigned int item) {
+      return std::min((int)((centroids[item][bestAxis] - axisMin) * scale), BVH_BIN_COUNT - 1) <= bestSplit;
+   });
+   return (unsigned int)(middle - ItemOrder.begin());
+}
+
+void SceneBvh::getItemRange(unsigned int node, unsigned int& outBegin, unsigned int& outEnd) const {
+   unsigned int first = node;
+   while (Nodes[first].Count == 0) {
+      first = Nodes[first].First;
+   }
+   unsigned int last = node;
+   while (Nodes[last].Count == 0) {
+      last = Nodes[last].First + 1;
+   }
+   outBegin = Nodes[first].First;
+   outEnd = Nodes[last].First + Nodes[last].Count;
+}
+
+BoundingBox SceneBvh::computeRangeBounds(unsigned int begin, unsigned int end) const {
+   BoundingBox bounds = emptyBox();
+   for (unsigned int i = begin; i < end; i++) {
+      growBox(bounds, ItemBounds[ItemOrder[i]]);
+   }
+   return bounds;
+}
+
+bool SceneBvh::refitNode(unsigned int node) {
+   BvhNode& current = Nodes[node];
+   BoundingBox bounds;
+   if (current.Count > 0) {
+      bounds = computeRangeBounds(current.First, current.First + current.Count);
+   }
+   else {
+      const BvhNode& left = Nodes[current.First];
+      const BvhNode& right = Nodes[current.First + 1];
+      bounds = { glm::min(left.Min, right.Min), glm::max(left.Max, right.Max) };
+   }
+   if (bounds.Min == current.Min && bounds.Max == current.Max) {
+      return false;
+   }
+   current.Min = bounds.Min;
+   current.Max = bounds.Max;
+   return true;
+}
+
+void SceneBvh::linkNodes() {
+   Parents.assign(Nodes.size(), NO_PARENT);
+   ItemLeaves.resize(ItemBounds.size());
+   ItemSlots.resize(ItemBounds.size());
+   OrderedBoxes.resize(6 * ItemBounds.size());
+   LeafDirtyFlags.assign(Nodes.size(), 0);
+   for (unsigned int i = 0; i < Nodes.size(); i++) {
+      const BvhNode& node = Nodes[i];
+      if (node.Count > 0) {
+         for (unsigned int j = node.First; j < node.First + node.Count; j++) {
+            ItemLeaves[ItemOrder[j]] = i;
+            ItemSlots[ItemOrder[j]] = j;
+            setOrderedBox(j, ItemBounds[ItemOrder[j]]);
+         }
+      }
+      else {
+         ASSERT(node.First > i);
+         Parents[node.First] = i;
+         Parents[node.First + 1] = i;
+      }
+   }
+}
+
+void SceneBvh::setOrderedBox(unsigned int slot, const BoundingBox& bounds) {
+   size_t itemCount = ItemBounds.size();
+   glm::vec3 center = (bounds.Min + bounds.Max) * 0.5f;
+   glm::vec3 extent = (bounds.Max - bounds.Min) * 0.5f;
+   for (int axis = 0; axis < 3; axis++) {
+      OrderedBoxes[axis * itemCount + slot] = center[axis];
+      OrderedBoxes[(3 + axis) * itemCount + slot] = extent[axis];
+   }
+}
+
+BoxBatch SceneBvh::getOrderedBoxes(unsigned int first, unsigned int count) const {
+   size_t itemCount = ItemBounds.size();
+   const float* boxes = OrderedBoxes.data() + first;
+   return { boxes, boxes + itemCount, boxes + 2 * itemCount, boxes + 3 * itemCount, boxes + 4 * itemCount, boxes + 5 * itemCount, count };
+}
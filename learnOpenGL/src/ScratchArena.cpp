@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "ScratchArena.h"
+
+ScratchArena::Scope::Scope(ScratchArena& arena) :
+   Arena(arena)
+   {
+   Arena.ScopeDepth++;
+}
+
+ScratchArena::Scope::~Scope() {
+   if (--Arena.ScopeDepth == 0) {
+      Arena.reset();
+   }
+}
+
+ScratchArena::ScratchArena() :
+   Used(0),
+   TotalUsed(0),
+   PeakUsed(0),
+   ScopeDepth(0)
+   {
+}
+
+ScratchArena& ScratchArena::getThreadLocal() {
+   static thread_local ScratchArena arena;
+   return arena;
+}
+
+void* ScratchArena::allocate(std::size_t size, std::size_t alignment) {
+
+   if (!Blocks.empty()) {
+      std::size_t offset = (Used + alignment - 1) / alignment * alignment;
+      if (offset + size <= BlockSizes.back()) {
+         TotalUsed += offset + size - Used;
+         Used = offset + size;
+         PeakUsed = std::max(PeakUsed, TotalUsed);
+         return Blocks.back().get() + offset;
+      }
+   }
+
+   // The new block at least doubles the arena, so a growing workload only adds a few blocks.
+   std::size_t blockSize = std::max<std::size_t>(DEFLT_SCRATCH_BLOCK_SIZE, size + alignment);
+   if (!BlockSizes.empty()) {
+      blockSize = std::max(blockSize, BlockSizes.back() * 2);
+   }
+   Blocks.emplace_back(new unsigned char[blockSize]);
+   BlockSizes.push_back(blockSize);
+
+   unsigned char* block = Blocks.back().get();
+   std::size_t offset = (alignment - (std::size_t)block % alignment) % alignment;
+   Used = offset + size;
+   TotalUsed += Used;
+   PeakUsed = std::max(PeakUsed, TotalUsed);
+   return block + offset;
+}
+
+void ScratchArena::reset() {
+   if (Blocks.size() > 1) {
+      std::size_t totalSize = 0;
+      for (std::size_t blockSize : BlockSizes) {
+         totalSize += blockSize;
+      }
+      Blocks.clear();
+      BlockSizes.clear();
+      Blocks.emplace_back(new unsigned char[totalSize]);
+      BlockSizes.push_back(totalSize);
+   }
+   Used = 0;
+   TotalUsed = 0;
+}
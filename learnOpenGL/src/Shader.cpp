@@ -51,7 +51,7 @@ void Shader::getShaderSrc(ShaderSrc& outShaderSrc, const char* vertexPath, const
 }
 
 Shader::~Shader() {
-	GLCall(glDeleteProgram(programId));
+	GLStateCache::getShared().deleteProgram(programId);
 }
 
 void Shader::compileShader(const ShaderSrc& shaderSrc) {
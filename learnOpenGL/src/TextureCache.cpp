@@ -0,0 +1,167 @@
+#include <cstdlib>
+#include <vector>
+
+#include "TextureCache.h"
+#include "TextureData.h"
+#include "GLStateCache.h"
+#include "OpenGLErrorHandling.h"
+
+#ifndef _WIN32
+#include <climits>
+#include <unistd.h>
+#endif
+
+TextureCache::TextureCache() :
+   Hits(0),
+   Misses(0),
+   Freed(0)
+   {
+}
+
+TextureCache& TextureCache::getShared() {
+   static TextureCache cache;
+   return cache;
+}
+
+std::string TextureCache::getKey(const std::string& path) {
+
+   std::string absolute;
+#ifdef _WIN32
+   char buffer[_MAX_PATH];
+   if (_fullpath(buffer, path.c_str(), _MAX_PATH) != nullptr) {
+      absolute = buffer;
+   }
+#else
+   char buffer[PATH_MAX];
+   if (path.empty() || path[0] == '/') {
+      absolute = path;
+   }
+   else if (getcwd(buffer, PATH_MAX) != nullptr) {
+      absolute = std::string(buffer) + '/' + path;
+   }
+#endif
+   if (absolute.empty()) {
+      absolute = path;
+   }
+
+   // The model files use both kinds of separators, and relative components resolve the same whether the file exists or not.
+   std::vector<std::string> components;
+   size_t start = 0;
+   for (size_t i = 0; i <= absolute.size(); i++) {
+      if (i < absolute.size() && absolute[i] != '/' && absolute[i] != '\\') {
+         continue;
+      }
+      std::string component = absolute.substr(start, i - start);
+      start = i + 1;
+      if (component == "..") {
+         if (!components.empty()) {
+            components.pop_back();
+         }
+      }
+      else if (!component.empty() && component != ".") {
+         components.push_back(component);
+      }
+   }
+
+   std::string key;
+#ifdef _WIN32
+   // The drive letter is the first component, and Windows paths aren't case sensitive.
+   for (const std::string& component : components) {
+      key += key.empty() ? component : '/' + component;
+   }
+   for (char& c : key) {
+      if (c >= 'A' && c <= 'Z') {
+         c = c - 'A' + 'a';
+      }
+   }
+#else
+   for (const std::string& component : components) {
+      key += '/' + component;
+   }
+#endif
+   return key;
+}
+
+std::shared_ptr<const Texture> TextureCache::find(const std::string& key) {
+   std::shared_ptr<const Texture> texture;
+   {
+      std::lock_guard<std::mutex> lock(Mutex);
+      auto it = Textures.find(key);
+      if (it != Textures.end()) {
+         texture = it->second.lock();
+      }
+   }
+   if (texture) {
+      Hits++;
+   }
+   else {
+      Misses++;
+   }
+   return texture;
+}
+
+bool TextureCache::contains(const std::string& key) const {
+   std::lock_guard<std::mutex> lock(Mutex);
+   auto it = Textures.find(key);
+   return it != Textures.end() && !it->second.expired();
+}
+
+std::shared_ptr<const Texture> TextureCache::insert(const std::string& key, const Texture& texture) {
+   std::shared_ptr<const Texture> added(new Texture(texture), [this, key](const Texture* released) {
+      release(key, released);
+   });
+
+   std::unique_lock<std::mutex> lock(Mutex);
+   std::weak_ptr<const Texture>& entry = Textures[key];
+   std::shared_ptr<const Texture> existing = entry.lock();
+   if (existing) {
+      // The duplicate is released outside the lock, since releasing it takes the lock.
+      lock.unlock();
+      added.reset();
+      return existing;
+   }
+   entry = added;
+   return added;
+}
+
+std::shared_ptr<const Texture> TextureCache::load(const std::string& path, const std::string& typeName) {
+   std::string key = getKey(path);
+   std::shared_ptr<const Texture> texture = find(key);
+   if (!texture) {
+      texture = insert(key, TextureData::load(path, typeName, false).createTexture(path, typeName));
+   }
+   return texture;
+}
+
+TextureCacheStats TextureCache::getStats() const {
+   TextureCacheStats stats;
+   stats.hits = Hits.load();
+   stats.misses = Misses.load();
+   stats.freed = Freed.load();
+   std::lock_guard<std::mutex> lock(Mutex);
+   stats.textureCount = 0;
+   for (const auto& entry : Textures) {
+      if (!entry.second.expired()) {
+         stats.textureCount++;
+      }
+   }
+   return stats;
+}
+
+void TextureCache::resetStats() {
+   Hits = 0;
+   Misses = 0;
+   Freed = 0;
+}
+
+void TextureCache::release(const std::string& key, const Texture* texture) {
+   GLStateCache::getShared().deleteTextures(1, &texture->Id);
+   delete texture;
+   Freed++;
+
+   std::lock_guard<std::mutex> lock(Mutex);
+   auto it = Textures.find(key);
+   if (it != Textures.end() && it->second.expired()) {
+      Textures.erase(it);
+   }
+}
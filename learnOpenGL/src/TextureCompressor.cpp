@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "TextureCompressor.h"
+#include "MipmapBuilder.h"
+#include "OpenGLErrorHandling.h"
+#include "Simd.h"
+
+namespace {
+
+   inline unsigned int packColor(int r, int g, int b) {
+      return (unsigned int)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+   }
+
+   inline void unpackColor(unsigned int color, int* outRgb) {
+      int r = (color >> 11) & 31;
+      int g = (color >> 5) & 63;
+      int b = color & 31;
+      outRgb[0] = (r << 3) | (r >> 2);
+      outRgb[1] = (g << 2) | (g >> 4);
+      outRgb[2] = (b << 3) | (b >> 2);
+   }
+
+   /**
+      Gets the 8 values of a BC4 block from its endpoints, in index order.
+    */
+   inline void getChannelPalette(int a0, int a1, int* outPalette) {
+      outPalette[0] = a0;
+      outPalette[1] = a1;
+      if (a0 > a1) {
+         for (int i = 1; i <= 6; i++) {
+            outPalette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+         }
+      }
+      else {
+         for (int i = 1; i <= 4; i++) {
+            outPalette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+         }
+         outPalette[6] = 0;
+         outPalette[7] = 255;
+      }
+   }
+}
+
+BlockFormat TextureCompressor::chooseFormat(const TextureImage& image, const std::string& typeName) {
+
+   BlockFormat format;
+   if (getTypeFormat(typeName, format)) {
+      return format;
+   }
+   if (image.Components == 1) {
+      return BlockFormat::BC4;
+   }
+
+   bool grayscale = true;
+   bool opaque = true;
+   const unsigned char* pixels = image.Pixels.get();
+   std::size_t pixelCount = (std::size_t)image.Width * image.Height;
+   for (std::size_t i = 0; i < pixelCount; i++) {
+      const unsigned char* pixel = pixels + i * image.Components;
+      if (image.Components == 2) {
+         opaque = opaque && pixel[1] == 255;
+         continue;
+      }
+      grayscale = grayscale && std::abs(pixel[0] - pixel[1]) <= GRAYSCALE_TOLERANCE && std::abs(pixel[1] - pixel[2]) <= GRAYSCALE_TOLERANCE;
+      if (image.Components == 4) {
+         opaque = opaque && pixel[3] == 255;
+      }
+   }
+   if (!opaque) {
+      return BlockFormat::BC3;
+   }
+   return grayscale ? BlockFormat::BC4 : BlockFormat::BC1;
+}
+
+bool TextureCompressor::getTypeFormat(const std::string& typeName, BlockFormat& outFormat) {
+   if (typeName == "texture_normal") {
+      outFormat = BlockFormat::BC5;
+      return true;
+   }
+   return false;
+}
+
+CompressedImage TextureCompressor::compress(const TextureImage& image, BlockFormat format, ThreadPool* pool) {
+
+   CompressedImage compressed;
+   compressed.Format = format;
+   std::size_t blockSize = getBlockSize(format);
+   std::vector<unsigned char> pixels = toRgba(image);
+   int width = image.Width;
+   int height = image.Height;
+
+   while (true) {
+      CompressedLevel level;
+      level.Width = width;
+      level.Height = height;
+      level.Data.resize(getLevelSize(format, width, height));
+      int blocksX = (width + 3) / 4;
+
+      auto encodeRow = [&](std::size_t blockY) {
+         unsigned char block[64];
+         for (int blockX = 0; blockX < blocksX; blockX++) {
+            // The blocks on the right and top edges repeat the last pixels of the image.
+            for (int y = 0; y < 4; y++) {
+               int sourceY = std::min((int)blockY * 4 + y, height - 1);
+               for (int x = 0; x < 4; x++) {
+                  int sourceX = std::min(blockX * 4 + x, width - 1);
+                  std::memcpy(block + (y * 4 + x) * 4, &pixels[((std::size_t)sourceY * width + sourceX) * 4], 4);
+               }
+            }
+
+            unsigned char* out = &level.Data[((std::size_t)blockY * blocksX + blockX) * blockSize];
+            switch (format) {
+               case BlockFormat::BC1: {
+                  encodeColorBlock(block, out);
+                  break;
+               }
+               case BlockFormat::BC3: {
+                  encodeChannelBlock(block, 3, out);
+                  encodeColorBlock(block, out + 8);
+                  break;
+               }
+               case BlockFormat::BC4: {
+                  encodeChannelBlock(block, 0, out);
+                  break;
+               }
+               case BlockFormat::BC5: {
+                  encodeChannelBlock(block, 0, out);
+                  encodeChannelBlock(block, 1, out + 8);
+                  break;
+               }
+            }
+         }
+      };
+
+      std::size_t blocksY = (height + 3) / 4;
+      if (pool != nullptr) {
+         pool->parallelFor(blocksY, encodeRow);
+      }
+      else {
+         for (std::size_t blockY = 0; blockY < blocksY; blockY++) {
+            encodeRow(blockY);
+         }
+      }
+      compressed.Levels.push_back(std::move(level));
+
+      if (width == 1 && height == 1) {
+         break;
+      }
+      std::vector<unsigned char> half((std::size_t)std::max(width / 2, 1) * std::max(height / 2, 1) * 4);
+      MipmapBuilder::downsample(pixels.data(), width, height, 4, half.data());
+      pixels = std::move(half);
+      width = std::max(width / 2, 1);
+      height = std::max(height / 2, 1);
+   }
+   return compressed;
+}
+
+TextureImage TextureCompressor::decompress(BlockFormat format, int width, int height, const unsigned char* blocks) {
+
+   TextureImage decoded;
+   decoded.Width = width;
+   decoded.Height = height;
+   decoded.Components = 4;
+   decoded.Pixels = std::shared_ptr<unsigned char>(new unsigned char[(std::size_t)width * height * 4], std::default_delete<unsigned char[]>());
+
+   std::size_t blockSize = getBlockSize(format);
+   int blocksX = (width + 3) / 4;
+   int blocksY = (height + 3) / 4;
+   unsigned char pixels[64];
+   for (int blockY = 0; blockY < blocksY; blockY++) {
+      for (int blockX = 0; blockX < blocksX; blockX++) {
+         const unsigned char* block = blocks + ((std::size_t)blockY * blocksX + blockX) * blockSize;
+         switch (format) {
+            case BlockFormat::BC1: {
+               decodeColorBlock(block, pixels);
+               break;
+            }
+            case BlockFormat::BC3: {
+               decodeColorBlock(block + 8, pixels);
+               decodeChannelBlock(block, 3, pixels);
+               break;
+            }
+            case BlockFormat::BC4: {
+               decodeChannelBlock(block, 0, pixels);
+               for (int i = 0; i < 16; i++) {
+                  pixels[i * 4 + 1] = pixels[i * 4 + 2] = pixels[i * 4];
+                  pixels[i * 4 + 3] = 255;
+               }
+               break;
+            }
+            case BlockFormat::BC5: {
+               decodeChannelBlock(block, 0, pixels);
+               decodeChannelBlock(block + 8, 1, pixels);
+               for (int i = 0; i < 16; i++) {
+                  pixels[i * 4 + 2] = 0;
+                  pixels[i * 4 + 3] = 255;
+               }
+               break;
+            }
+         }
+
+         for (int y = 0; y < 4 && blockY * 4 + y < height; y++) {
+            for (int x = 0; x < 4 && blockX * 4 + x < width; x++) {
+               std::memcpy(decoded.Pixels.get() + ((std::size_t)(blockY * 4 + y) * width + blockX * 4 + x) * 4, pixels + (y * 4 + x) * 4, 4);
+            }
+         }
+      }
+   }
+   return decoded;
+}
+
+std::size_t TextureCompressor::getBlockSize(BlockFormat format) {
+   return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+std::size_t TextureCompressor::getLevelSize(BlockFormat format, int width, int height) {
+   return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+unsigned int TextureCompressor::getGLFormat(BlockFormat format) {
+   switch (format) {
+      case BlockFormat::BC1: {
+         return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      }
+      case BlockFormat::BC3: {
+         return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+      }
+      case BlockFormat::BC4: {
+         return GL_COMPRESSED_RED_RGTC1;
+      }
+      default: {
+         return GL_COMPRESSED_RG_RGTC2;
+      }
+   }
+}
+
+bool TextureCompressor::isSupported(BlockFormat format) {
+   // RGTC is core since OpenGL 3.0.
+   if (format == BlockFormat::BC4 || format == BlockFormat::BC5) {
+      return true;
+   }
+   static const bool s3tcSupported = []() {
+      GLint extensionCount = 0;
+      GLCall(glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount));
+      for (GLint i = 0; i < extensionCount; i++) {
+         const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+         if (extension != nullptr && std::strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0) {
+            return true;
+         }
+      }
+      return false;
+   }();
+   return s3tcSupported;
+}
+
+void TextureCompressor::encodeColorBlock(const unsigned char* pixels, unsigned char* outBlock) {
+
+   float r[16], g[16], b[16];
+   float minColor[3] = { 255.0f, 255.0f, 255.0f };
+   float maxColor[3] = { 0.0f, 0.0f, 0.0f };
+   for (int i = 0; i < 16; i++) {
+      r[i] = pixels[i * 4];
+      g[i] = pixels[i * 4 + 1];
+      b[i] = pixels[i * 4 + 2];
+      minColor[0] = std::min(minColor[0], r[i]);
+      minColor[1] = std::min(minColor[1], g[i]);
+      minColor[2] = std::min(minColor[2], b[i]);
+      maxColor[0] = std::max(maxColor[0], r[i]);
+      maxColor[1] = std::max(maxColor[1], g[i]);
+      maxColor[2] = std::max(maxColor[2], b[i]);
+   }
+
+   // The box has two diagonals per pair of channels: the colors follow the one along which the channels covary.
+   float center[3];
+   int widest = 0;
+   for (int c = 0; c < 3; c++) {
+      center[c] = (minColor[c] + maxColor[c]) * 0.5f;
+      if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest]) {
+         widest = c;
+      }
+   }
+   const float* channels[3] = { r, g, b };
+   for (int c = 0; c < 3; c++) {
+      if (c == widest) {
+         continue;
+      }
+      float covariance = 0.0f;
+      for (int i = 0; i < 16; i++) {
+         covariance += (channels[c][i] - center[c]) * (channels[widest][i] - center[widest]);
+      }
+      if (covariance < 0.0f) {
+         std::swap(minColor[c], maxColor[c]);
+      }
+   }
+
+   // Insetting the endpoints by a sixteenth of the range lowers the error of the colors in between.
+   int endpoints[2][3];
+   for (int c = 0; c < 3; c++) {
+      float inset = (maxColor[c] - minColor[c]) / 16.0f;
+      endpoints[0][c] = (int)(maxColor[c] - inset + 0.5f);
+      endpoints[1][c] = (int)(minColor[c] + inset + 0.5f);
+   }
+   unsigned int color0 = packColor(endpoints[0][0], endpoints[0][1], endpoints[0][2]);
+   unsigned int color1 = packColor(endpoints[1][0], endpoints[1][1], endpoints[1][2]);
+   // The first endpoint must be the larger one, or the block would use the 3 color mode.
+   if (color0 < color1) {
+      std::swap(color0, color1);
+   }
+   outBlock[0] = color0 & 0xFF;
+   outBlock[1] = color0 >> 8;
+   outBlock[2] = color1 & 0xFF;
+   outBlock[3] = color1 >> 8;
+
+   std::uint32_t indices = 0;
+   if (color0 != color1) {
+      int rgb0[3], rgb1[3];
+      unpackColor(color0, rgb0);
+      unpackColor(color1, rgb1);
+      float palette[4][3];
+      for (int c = 0; c < 3; c++) {
+         palette[0][c] = (float)rgb0[c];
+         palette[1][c] = (float)rgb1[c];
+         palette[2][c] = (2.0f * rgb0[c] + rgb1[c]) / 3.0f;
+         palette[3][c] = (rgb0[c] + 2.0f * rgb1[c]) / 3.0f;
+      }
+
+      float bestIndices[16];
+      int i = 0;
+#ifdef SIMD_SSE
+      for (; i < 16; i += 4) {
+         __m128 red = _mm_loadu_ps(r + i);
+         __m128 green = _mm_loadu_ps(g + i);
+         __m128 blue = _mm_loadu_ps(b + i);
+         __m128 bestDistance = _mm_set1_ps(1e30f);
+         __m128 bestIndex = _mm_setzero_ps();
+         for (int p = 0; p < 4; p++) {
+            __m128 dr = _mm_sub_ps(red, _mm_set1_ps(palette[p][0]));
+            __m128 dg = _mm_sub_ps(green, _mm_set1_ps(palette[p][1]));
+            __m128 db = _mm_sub_ps(blue, _mm_set1_ps(palette[p][2]));
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+            __m128 closer = _mm_cmplt_ps(distance, bestDistance);
+            bestDistance = _mm_min_ps(distance, bestDistance);
+            bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)p)), _mm_andnot_ps(closer, bestIndex));
+         }
+         _mm_storeu_ps(bestIndices + i, bestIndex);
+      }
+#endif
+      for (; i < 16; i++) {
+         float bestDistance = 1e30f;
+         for (int p = 0; p < 4; p++) {
+            float dr = r[i] - palette[p][0];
+            float dg = g[i] - palette[p][1];
+            float db = b[i] - palette[p][2];
+            float distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+               bestDistance = distance;
+               bestIndices[i] = (float)p;
+            }
+         }
+      }
+      for (int j = 0; j < 16; j++) {
+         indices |= (std::uint32_t)bestIndices[j] << (j * 2);
+      }
+   }
+   for (int j = 0; j < 4; j++) {
+      outBlock[4 + j] = (indices >> (j * 8)) & 0xFF;
+   }
+}
+
+void TextureCompressor::encodeChannelBlock(const unsigned char* pixels, int channel, unsigned char* outBlock) {
+
+   int minValue = 255;
+   int maxValue = 0;
+   for (int i = 0; i < 16; i++) {
+      minValue = std::min(minValue, (int)pixels[i * 4 + channel]);
+      maxValue = std::max(maxValue, (int)pixels[i * 4 + channel]);
+   }
+   outBlock[0] = (unsigned char)maxValue;
+   outBlock[1] = (unsigned char)minValue;
+
+   // Endpoints in decreasing order select the 8 value mode, the values spread evenly from the maximum to the minimum.
+   std::uint64_t indices = 0;
+   int range = maxValue - minValue;
+   if (range > 0) {
+      for (int i = 0; i < 16; i++) {
+         int step = ((maxValue - pixels[i * 4 + channel]) * 14 + range) / (2 * range);
+         std::uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+         indices |= index << (i * 3);
+      }
+   }
+   for (int j = 0; j < 6; j++) {
+      outBlock[2 + j] = (indices >> (j * 8)) & 0xFF;
+   }
+}
+
+void TextureCompressor::decodeColorBlock(const unsigned char* block, unsigned char* outPixels) {
+
+   unsigned int color0 = block[0] | block[1] << 8;
+   unsigned int color1 = block[2] | block[3] << 8;
+   int palette[4][4];
+   unpackColor(color0, palette[0]);
+   unpackColor(color1, palette[1]);
+   palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+   for (int c = 0; c < 3; c++) {
+      if (color0 > color1) {
+         palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+         palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+      }
+      else {
+         palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+         palette[3][c] = 0;
+      }
+   }
+   if (color0 <= color1) {
+      palette[3][3] = 0;
+   }
+
+   std::uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (std::uint32_t)block[7] << 24;
+   for (int i = 0; i < 16; i++) {
+      const int* color = palette[(indices >> (i * 2)) & 3];
+      for (int c = 0; c < 4; c++) {
+         outPixels[i * 4 + c] = (unsigned char)color[c];
+      }
+   }
+}
+
+void TextureCompressor::decodeChannelBlock(const unsigned char* block, int channel, unsigned char* outPixels) {
+   int palette[8];
+   getChannelPalette(block[0], block[1], palette);
+   std::uint64_t indices = 0;
+   for (int j = 0; j < 6; j++) {
+      indices |= (std::uint64_t)block[2 + j] << (j * 8);
+   }
+   for (int i = 0; i < 16; i++) {
+      outPixels[i * 4 + channel] = (unsigned char)palette[(indices >> (i * 3)) & 7];
+   }
+}
+
+std::vector<unsigned char> TextureCompressor::toRgba(const TextureImage& image) {
+   std::size_t pixelCount = (std::size_t)image.Width * image.Height;
+   std::vector<unsigned char> pixels(pixelCount * 4);
+   const unsigned char* source = image.Pixels.get();
+   for (std::size_t i = 0; i < pixelCount; i++) {
+      const unsigned char* pixel = source + i * image.Components;
+      unsigned char* out = &pixels[i * 4];
+      switch (image.Components) {
+         case 1: {
+            out[0] = out[1] = out[2] = pixel[0];
+            out[3] = 255;
+            break;
+         }
+         case 2: {
+            out[0] = out[1] = out[2] = pixel[0];
+            out[3] = pixel[1];
+            break;
+         }
+         case 3: {
+            out[0] = pixel[0];
+            out[1] = pixel[1];
+            out[2] = pixel[2];
+            out[3] = 255;
+            break;
+         }
+         default: {
+            std::memcpy(out, pixel, 4);
+         }
+      }
+   }
+   return pixels;
+}
@@ -0,0 +1,316 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <glad/glad.h>
+
+#include "TextureContainer.h"
+#include "MappedFile.h"
+
+#define DDS_MAGIC 0x20534444u
+
+// The DDS header flags and caps of a compressed texture with a mip chain.
+#define DDSD_CAPS        0x1u
+#define DDSD_HEIGHT      0x2u
+#define DDSD_WIDTH       0x4u
+#define DDSD_PIXELFORMAT 0x1000u
+#define DDSD_MIPMAPCOUNT 0x20000u
+#define DDSD_LINEARSIZE  0x80000u
+#define DDPF_FOURCC      0x4u
+#define DDSCAPS_COMPLEX  0x8u
+#define DDSCAPS_TEXTURE  0x1000u
+#define DDSCAPS_MIPMAP   0x400000u
+
+// The DXGI formats of the DX10 header extension.
+#define DXGI_FORMAT_BC1_UNORM      71
+#define DXGI_FORMAT_BC1_UNORM_SRGB 72
+#define DXGI_FORMAT_BC3_UNORM      77
+#define DXGI_FORMAT_BC3_UNORM_SRGB 78
+#define DXGI_FORMAT_BC4_UNORM      80
+#define DXGI_FORMAT_BC5_UNORM      83
+
+#define KTX_ENDIANNESS 0x04030201u
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct DdsPixelFormat {
+   std::uint32_t size;
+   std::uint32_t flags;
+   std::uint32_t fourCC;
+   std::uint32_t rgbBitCount;
+   std::uint32_t masks[4];
+};
+
+struct DdsHeader {
+   std::uint32_t size;
+   std::uint32_t flags;
+   std::uint32_t height;
+   std::uint32_t width;
+   std::uint32_t pitchOrLinearSize;
+   std::uint32_t depth;
+   std::uint32_t mipMapCount;
+   std::uint32_t reserved1[11];
+   DdsPixelFormat pixelFormat;
+   std::uint32_t caps;
+   std::uint32_t caps2;
+   std::uint32_t caps3;
+   std::uint32_t caps4;
+   std::uint32_t reserved2;
+};
+
+struct DdsHeaderDx10 {
+   std::uint32_t dxgiFormat;
+   std::uint32_t resourceDimension;
+   std::uint32_t miscFlag;
+   std::uint32_t arraySize;
+   std::uint32_t miscFlags2;
+};
+
+struct KtxHeader {
+   unsigned char identifier[12];
+   std::uint32_t endianness;
+   std::uint32_t glType;
+   std::uint32_t glTypeSize;
+   std::uint32_t glFormat;
+   std::uint32_t glInternalFormat;
+   std::uint32_t glBaseInternalFormat;
+   std::uint32_t pixelWidth;
+   std::uint32_t pixelHeight;
+   std::uint32_t pixelDepth;
+   std::uint32_t numberOfArrayElements;
+   std::uint32_t numberOfFaces;
+   std::uint32_t numberOfMipmapLevels;
+   std::uint32_t bytesOfKeyValueData;
+};
+
+static inline std::uint32_t makeFourCC(char a, char b, char c, char d) {
+   return (std::uint32_t)(unsigned char)a | (std::uint32_t)(unsigned char)b << 8 | (std::uint32_t)(unsigned char)c << 16 | (std::uint32_t)(unsigned char)d << 24;
+}
+
+bool TextureContainer::saveDds(const std::string& path, const CompressedImage& image) {
+
+   DdsHeader header = {};
+   header.size = sizeof(DdsHeader);
+   header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+   header.height = image.Levels[0].Height;
+   header.width = image.Levels[0].Width;
+   header.pitchOrLinearSize = (std::uint32_t)image.Levels[0].Data.size();
+   header.mipMapCount = (std::uint32_t)image.Levels.size();
+   header.pixelFormat.size = sizeof(DdsPixelFormat);
+   header.pixelFormat.flags = DDPF_FOURCC;
+   header.caps = DDSCAPS_TEXTURE | (image.Levels.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+   switch (image.Format) {
+      case BlockFormat::BC1: {
+         header.pixelFormat.fourCC = makeFourCC('D', 'X', 'T', '1');
+         break;
+      }
+      case BlockFormat::BC3: {
+         header.pixelFormat.fourCC = makeFourCC('D', 'X', 'T', '5');
+         break;
+      }
+      case BlockFormat::BC4: {
+         header.pixelFormat.fourCC = makeFourCC('A', 'T', 'I', '1');
+         break;
+      }
+      case BlockFormat::BC5: {
+         header.pixelFormat.fourCC = makeFourCC('A', 'T', 'I', '2');
+         break;
+      }
+   }
+
+   std::string tempPath = path + ".tmp";
+   {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      if (!file) {
+         return false;
+      }
+      std::uint32_t magic = DDS_MAGIC;
+      file.write((const char*)&magic, sizeof(magic));
+      file.write((const char*)&header, sizeof(header));
+      for (const CompressedLevel& level : image.Levels) {
+         file.write((const char*)level.Data.data(), level.Data.size());
+      }
+      if (!file) {
+         file.close();
+         std::remove(tempPath.c_str());
+         return false;
+      }
+   }
+   std::remove(path.c_str());
+   return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool TextureContainer::load(const std::string& path, CompressedImage& outImage) {
+   try {
+      MappedFile file(path);
+      if (file.size() >= sizeof(KTX_IDENTIFIER) && std::memcmp(file.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0) {
+         return readKtx(file.data(), file.size(), outImage);
+      }
+      return readDds(file.data(), file.size(), outImage);
+   }
+   catch (const MappedFile::MappingFailure& e) {
+      return false;
+   }
+}
+
+bool TextureContainer::isContainerPath(const std::string& path) {
+   std::size_t dot = path.find_last_of('.');
+   if (dot == std::string::npos) {
+      return false;
+   }
+   std::string extension = path.substr(dot + 1);
+   for (char& c : extension) {
+      if (c >= 'A' && c <= 'Z') {
+         c = c - 'A' + 'a';
+      }
+   }
+   return extension == "dds" || extension == "ktx";
+}
+
+bool TextureContainer::readDds(const unsigned char* data, std::size_t size, CompressedImage& outImage) {
+
+   std::uint32_t magic;
+   DdsHeader header;
+   if (size < sizeof(magic) + sizeof(header)) {
+      return false;
+   }
+   std::memcpy(&magic, data, sizeof(magic));
+   std::memcpy(&header, data + sizeof(magic), sizeof(header));
+   if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || !(header.pixelFormat.flags & DDPF_FOURCC)) {
+      return false;
+   }
+   std::size_t offset = sizeof(magic) + sizeof(header);
+
+   std::uint32_t fourCC = header.pixelFormat.fourCC;
+   if (fourCC == makeFourCC('D', 'X', 'T', '1')) {
+      outImage.Format = BlockFormat::BC1;
+   }
+   else if (fourCC == makeFourCC('D', 'X', 'T', '5')) {
+      outImage.Format = BlockFormat::BC3;
+   }
+   else if (fourCC == makeFourCC('A', 'T', 'I', '1') || fourCC == makeFourCC('B', 'C', '4', 'U')) {
+      outImage.Format = BlockFormat::BC4;
+   }
+   else if (fourCC == makeFourCC('A', 'T', 'I', '2') || fourCC == makeFourCC('B', 'C', '5', 'U')) {
+      outImage.Format = BlockFormat::BC5;
+   }
+   else if (fourCC == makeFourCC('D', 'X', '1', '0')) {
+      DdsHeaderDx10 header10;
+      if (size < offset + sizeof(header10)) {
+         return false;
+      }
+      std::memcpy(&header10, data + offset, sizeof(header10));
+      offset += sizeof(header10);
+      switch (header10.dxgiFormat) {
+         case DXGI_FORMAT_BC1_UNORM:
+         case DXGI_FORMAT_BC1_UNORM_SRGB: {
+            outImage.Format = BlockFormat::BC1;
+            break;
+         }
+         case DXGI_FORMAT_BC3_UNORM:
+         case DXGI_FORMAT_BC3_UNORM_SRGB: {
+            outImage.Format = BlockFormat::BC3;
+            break;
+         }
+         case DXGI_FORMAT_BC4_UNORM: {
+            outImage.Format = BlockFormat::BC4;
+            break;
+         }
+         case DXGI_FORMAT_BC5_UNORM: {
+            outImage.Format = BlockFormat::BC5;
+            break;
+         }
+         default: {
+            return false;
+         }
+      }
+   }
+   else {
+      return false;
+   }
+
+   unsigned int levelCount = (header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount > 0 ? header.mipMapCount : 1;
+   return readLevels(data + offset, size - offset, (int)header.width, (int)header.height, levelCount, outImage);
+}
+
+bool TextureContainer::readKtx(const unsigned char* data, std::size_t size, CompressedImage& outImage) {
+
+   KtxHeader header;
+   if (size < sizeof(header)) {
+      return false;
+   }
+   std::memcpy(&header, data, sizeof(header));
+   // Only plain 2D textures written in the machine's byte order.
+   if (header.endianness != KTX_ENDIANNESS || header.glType != 0 || header.pixelDepth > 1 ||
+      header.numberOfArrayElements > 1 || header.numberOfFaces != 1) {
+      return false;
+   }
+   switch (header.glInternalFormat) {
+      case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+      case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: {
+         outImage.Format = BlockFormat::BC1;
+         break;
+      }
+      case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: {
+         outImage.Format = BlockFormat::BC3;
+         break;
+      }
+      case GL_COMPRESSED_RED_RGTC1: {
+         outImage.Format = BlockFormat::BC4;
+         break;
+      }
+      case GL_COMPRESSED_RG_RGTC2: {
+         outImage.Format = BlockFormat::BC5;
+         break;
+      }
+      default: {
+         return false;
+      }
+   }
+
+   // Every level is preceded by its size, and followed by padding to 4 bytes that the block sizes never need.
+   std::size_t offset = sizeof(header) + header.bytesOfKeyValueData;
+   unsigned int levelCount = header.numberOfMipmapLevels > 0 ? header.numberOfMipmapLevels : 1;
+   int width = (int)header.pixelWidth;
+   int height = (int)header.pixelHeight;
+   if (width <= 0 || height <= 0) {
+      return false;
+   }
+   outImage.Levels.clear();
+   for (unsigned int i = 0; i < levelCount; i++) {
+      std::uint32_t imageSize;
+      if (offset > size || size - offset < sizeof(imageSize)) {
+         return false;
+      }
+      std::memcpy(&imageSize, data + offset, sizeof(imageSize));
+      offset += sizeof(imageSize);
+      if (imageSize != TextureCompressor::getLevelSize(outImage.Format, width, height) || size - offset < imageSize) {
+         return false;
+      }
+      outImage.Levels.push_back({ width, height, std::vector<unsigned char>(data + offset, data + offset + imageSize) });
+      offset += (imageSize + 3) & ~3u;
+      width = width > 1 ? width / 2 : 1;
+      height = height > 1 ? height / 2 : 1;
+   }
+   return true;
+}
+
+bool TextureContainer::readLevels(const unsigned char* data, std::size_t size, int width, int height, unsigned int levelCount, CompressedImage& outImage) {
+   if (width <= 0 || height <= 0) {
+      return false;
+   }
+   outImage.Levels.clear();
+   std::size_t offset = 0;
+   for (unsigned int i = 0; i < levelCount; i++) {
+      std::size_t levelSize = TextureCompressor::getLevelSize(outImage.Format, width, height);
+      if (size - offset < levelSize) {
+         return false;
+      }
+      outImage.Levels.push_back({ width, height, std::vector<unsigned char>(data + offset, data + offset + levelSize) });
+      offset += levelSize;
+      width = width > 1 ? width / 2 : 1;
+      height = height > 1 ? height / 2 : 1;
+   }
+   return true;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "TextureData.h"
+#include "TextureContainer.h"
+#include "TextureDiskCache.h"
+#include "LoadProfiler.h"
+#include "MipmapBuilder.h"
+#include "OpenGLErrorHandling.h"
+#include "PixelUploadRing.h"
+
+std::size_t TextureData::getSize() const {
+   std::size_t size = 0;
+   for (const TextureLevel& level : Levels) {
+      size += level.Size;
+   }
+   return size;
+}
+
+TextureData TextureData::load(const std::string& path, const std::string& typeName, bool compress, bool useCache) {
+
+   if (TextureContainer::isContainerPath(path)) {
+      ScopedLoadTimer timer(LoadStage::TEXTURE_DECODE);
+      CompressedImage image;
+      if (!TextureContainer::load(path, image)) {
+         throw Texture::TextureLoadingFailure();
+      }
+      return fromCompressed(std::move(image));
+   }
+
+   TextureData data;
+   if (useCache && TextureDiskCache::load(path, typeName, compress, data)) {
+      return data;
+   }
+
+   TextureImage image = TextureImage::load(path);
+   if (compress) {
+      ScopedLoadTimer timer(LoadStage::TEXTURE_COMPRESS, (std::uint64_t)image.Width * image.Height * image.Components);
+      data = fromCompressed(TextureCompressor::compress(image, TextureCompressor::chooseFormat(image, typeName)));
+   }
+   else {
+      data = fromImage(image);
+   }
+   // Like the model cache, a cache that can't be written only means the next load cooks the texture again.
+   if (useCache) {
+      TextureDiskCache::save(path, typeName, data);
+   }
+   return data;
+}
+
+TextureData TextureData::fromImage(const TextureImage& image) {
+
+   std::vector<unsigned char> rgba;
+   const unsigned char* pixels = image.Pixels.get();
+   int components = image.Components;
+   if (components == 2 || components == 3) {
+      rgba = TextureCompressor::toRgba(image);
+      pixels = rgba.data();
+      components = 4;
+   }
+
+   unsigned int levelCount = MipmapBuilder::getLevelCount(image.Width, image.Height);
+   std::size_t size = 0;
+   for (unsigned int i = 0; i < levelCount; i++) {
+      size += MipmapBuilder::getLevelSize(image.Width, image.Height, components, i);
+   }
+   // The mip chain adds up to a third of the base level.
+   ScopedLoadTimer timer(LoadStage::MIPMAP_GENERATION, size - MipmapBuilder::getLevelSize(image.Width, image.Height, components, 0));
+   std::shared_ptr<unsigned char> storage(new unsigned char[size], std::default_delete<unsigned char[]>());
+
+   TextureData data;
+   data.Components = components;
+   unsigned char* level = storage.get();
+   std::memcpy(level, pixels, MipmapBuilder::getLevelSize(image.Width, image.Height, components, 0));
+   int width = image.Width;
+   int height = image.Height;
+   for (unsigned int i = 0; i < levelCount; i++) {
+      data.Levels.push_back({ width, height, level, MipmapBuilder::getLevelSize(image.Width, image.Height, components, i) });
+      if (i + 1 < levelCount) {
+         unsigned char* next = level + data.Levels.back().Size;
+         MipmapBuilder::downsample(level, width, height, components, next);
+         level = next;
+         width = std::max(width / 2, 1);
+         height = std::max(height / 2, 1);
+      }
+   }
+   data.Storage = std::move(storage);
+   return data;
+}
+
+TextureData TextureData::fromCompressed(CompressedImage&& image) {
+   std::shared_ptr<CompressedImage> storage = std::make_shared<CompressedImage>(std::move(image));
+   TextureData data;
+   data.Format = storage->Format;
+   for (const CompressedLevel& level : storage->Levels) {
+      data.Levels.push_back({ level.Width, level.Height, level.Data.data(), level.Data.size() });
+   }
+   data.Storage = std::move(storage);
+   return data;
+}
+
+Texture TextureData::createTexture(const std::string& path, const std::string& typeName, PixelUploadRing* ring) const {
+   return Texture(path, typeName, *this, 0, ring);
+}
+
+void TextureData::uploadLevel(unsigned int level, PixelUploadRing* ring) const {
+   if (ring == nullptr || !ring->uploadLevel(*this, level)) {
+      specifyLevel(level, Levels[level].Data);
+   }
+}
+
+void TextureData::specifyLevel(unsigned int level, const void* pixels) const {
+   const TextureLevel& source = Levels[level];
+   if (isCompressed()) {
+      GLCall(glCompressedTexImage2D(GL_TEXTURE_2D, level, TextureCompressor::getGLFormat(Format), source.Width, source.Height, 0, (GLsizei)source.Size, pixels));
+      return;
+   }
+   GLenum format = Components == 1 ? GL_RED : GL_RGBA;
+   // The rows of single channel levels aren't padded to 4 bytes.
+   GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+   GLCall(glTexImage2D(GL_TEXTURE_2D, level, format, source.Width, source.Height, 0, format, GL_UNSIGNED_BYTE, pixels));
+   GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
+void TextureData::releaseLevel(unsigned int level) const {
+   if (isCompressed()) {
+      GLCall(glCompressedTexImage2D(GL_TEXTURE_2D, level, TextureCompressor::getGLFormat(Format), 0, 0, 0, 0, nullptr));
+      return;
+   }
+   GLenum format = Components == 1 ? GL_RED : GL_RGBA;
+   GLCall(glTexImage2D(GL_TEXTURE_2D, level, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, nullptr));
+}
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "TextureDiskCache.h"
+#include "LoadProfiler.h"
+#include "MappedFile.h"
+
+static const char CACHE_MAGIC[8] = { 'T', 'E', 'X', 'C', 'A', 'C', 'H', 'E' };
+
+struct CacheHeader {
+   char magic[8];
+   std::uint32_t version;
+   // 0 for block compressed levels.
+   std::uint32_t components;
+   std::uint32_t format;
+   std::uint32_t levelCount;
+   std::uint64_t sourceSize;
+   std::int64_t sourceModificationTime;
+};
+
+struct CacheLevelRecord {
+   std::uint32_t width;
+   std::uint32_t height;
+   std::uint64_t offset;
+   std::uint64_t size;
+};
+
+static inline std::uint64_t alignOffset(std::uint64_t offset) {
+   return (offset + TEXTURE_DISK_CACHE_ALIGNMENT - 1) & ~(std::uint64_t)(TEXTURE_DISK_CACHE_ALIGNMENT - 1);
+}
+
+bool TextureDiskCache::load(const std::string& imagePath, const std::string& typeName, bool compressed, TextureData& outData) {
+
+   ScopedLoadTimer timer(LoadStage::TEXTURE_CACHE_LOAD);
+   FileInfo sourceInfo;
+   if (!MappedFile::getFileInfo(imagePath, sourceInfo)) {
+      return false;
+   }
+
+   try {
+      std::shared_ptr<MappedFile> cache = std::make_shared<MappedFile>(getCachePath(imagePath, typeName, compressed));
+      BlockFormat typeFormat;
+      bool hasTypeFormat = TextureCompressor::getTypeFormat(typeName, typeFormat);
+      CacheHeader header;
+      if (cache->size() < sizeof(header)) {
+         return false;
+      }
+      std::memcpy(&header, cache->data(), sizeof(header));
+      if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+         header.version != TEXTURE_DISK_CACHE_VERSION ||
+         (header.components == 0) != compressed ||
+         (header.components != 0 && header.components != 1 && header.components != 4) ||
+         header.format > (std::uint32_t)BlockFormat::BC5 ||
+         (compressed && hasTypeFormat && header.format != (std::uint32_t)typeFormat) ||
+         header.levelCount == 0 ||
+         header.sourceSize != sourceInfo.size ||
+         header.sourceModificationTime != sourceInfo.modificationTime ||
+         (cache->size() - sizeof(header)) / sizeof(CacheLevelRecord) < header.levelCount) {
+         return false;
+      }
+
+      TextureData data;
+      data.Components = (int)header.components;
+      data.Format = (BlockFormat)header.format;
+      data.Levels.reserve(header.levelCount);
+      for (std::uint32_t i = 0; i < header.levelCount; i++) {
+         CacheLevelRecord record;
+         std::memcpy(&record, cache->data() + sizeof(header) + i * sizeof(record), sizeof(record));
+         std::size_t expectedSize = data.isCompressed()
+            ? TextureCompressor::getLevelSize(data.Format, (int)record.width, (int)record.height)
+            : (std::size_t)record.width * record.height * data.Components;
+         if (record.width == 0 || record.height == 0 || record.size != expectedSize ||
+            record.offset > cache->size() || cache->size() - record.offset < record.size) {
+            return false;
+         }
+         data.Levels.push_back({ (int)record.width, (int)record.height, cache->data() + record.offset, (std::size_t)record.size });
+      }
+      timer.addBytes(cache->size());
+      data.Storage = std::move(cache);
+      outData = std::move(data);
+      return true;
+   }
+   catch (const MappedFile::MappingFailure& e) {
+      return false;
+   }
+}
+
+bool TextureDiskCache::save(const std::string& imagePath, const std::string& typeName, const TextureData& data) {
+
+   FileInfo sourceInfo;
+   if (!MappedFile::getFileInfo(imagePath, sourceInfo)) {
+      return false;
+   }
+   CacheHeader header;
+   std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+   header.version = TEXTURE_DISK_CACHE_VERSION;
+   header.components = (std::uint32_t)data.Components;
+   header.format = (std::uint32_t)data.Format;
+   header.levelCount = (std::uint32_t)data.Levels.size();
+   header.sourceSize = sourceInfo.size;
+   header.sourceModificationTime = sourceInfo.modificationTime;
+
+   std::vector<CacheLevelRecord> records;
+   std::uint64_t offset = sizeof(header) + data.Levels.size() * sizeof(CacheLevelRecord);
+   for (const TextureLevel& level : data.Levels) {
+      offset = alignOffset(offset);
+      records.push_back({ (std::uint32_t)level.Width, (std::uint32_t)level.Height, offset, level.Size });
+      offset += level.Size;
+   }
+
+   // Write to a temporary file first so an interrupted write never leaves a truncated cache behind.
+   std::string cachePath = getCachePath(imagePath, typeName, data.isCompressed());
+   std::string tempPath = cachePath + ".tmp";
+   {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      if (!file) {
+         return false;
+      }
+      file.write((const char*)&header, sizeof(header));
+      file.write((const char*)records.data(), records.size() * sizeof(CacheLevelRecord));
+      static const char padding[TEXTURE_DISK_CACHE_ALIGNMENT] = {};
+      for (std::size_t i = 0; i < data.Levels.size(); i++) {
+         file.write(padding, (std::streamsize)(records[i].offset - (std::uint64_t)file.tellp()));
+         file.write((const char*)data.Levels[i].Data, data.Levels[i].Size);
+      }
+      if (!file) {
+         file.close();
+         std::remove(tempPath.c_str());
+         return false;
+      }
+   }
+   std::remove(cachePath.c_str());
+   return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
+
+std::string TextureDiskCache::getCachePath(const std::string& imagePath, const std::string& typeName, bool compressed) {
+   static const char* FORMAT_NAMES[] = { "bc1", "bc3", "bc4", "bc5" };
+   if (!compressed) {
+      return imagePath + ".rgba" + TEXTURE_DISK_CACHE_EXTENSION;
+   }
+   BlockFormat format;
+   if (TextureCompressor::getTypeFormat(typeName, format)) {
+      return imagePath + '.' + FORMAT_NAMES[(int)format] + TEXTURE_DISK_CACHE_EXTENSION;
+   }
+   return imagePath + ".bc" + TEXTURE_DISK_CACHE_EXTENSION;
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "TexturePacker.h"
+#include "GLStateCache.h"
+#include "LoadProfiler.h"
+#include "OpenGLErrorHandling.h"
+#include "RenderStats.h"
+
+TexturePacker::TexturePacker() :
+   Bytes(0)
+   {
+}
+
+TexturePacker::~TexturePacker() {
+   if (!Arrays.empty()) {
+      GLStateCache::getShared().deleteTextures((GLsizei)Arrays.size(), Arrays.data());
+   }
+}
+
+void TexturePacker::add(const std::string& key, TextureData&& data) {
+
+   if (contains(key)) {
+      return;
+   }
+   if (data.isCompressed() && !TextureCompressor::isSupported(data.Format)) {
+      const TextureLevel& level = data.Levels[0];
+      data = TextureData::fromImage(TextureCompressor::decompress(data.Format, level.Width, level.Height, level.Data));
+   }
+
+   const TextureLevel& base = data.Levels[0];
+   unsigned int group = 0;
+   while (group < Groups.size()) {
+      const Group& candidate = Groups[group];
+      if (candidate.Width == base.Width && candidate.Height == base.Height && candidate.Components == data.Components
+         && (!data.isCompressed() || candidate.Format == data.Format) && candidate.LevelCount == data.Levels.size()
+         && candidate.Layers.size() < TEXTURE_ARRAY_MAX_LAYERS) {
+         break;
+      }
+      group++;
+   }
+   if (group == Groups.size()) {
+      Groups.push_back({ base.Width, base.Height, data.Components, data.Format, data.Levels.size(), std::vector<TextureData>() });
+   }
+
+   Placements[key] = { group, (unsigned int)Groups[group].Layers.size() };
+   Groups[group].Layers.push_back(std::move(data));
+}
+
+void TexturePacker::upload() {
+   Arrays.reserve(Groups.size());
+   for (Group& group : Groups) {
+      Arrays.push_back(uploadGroup(group));
+      // The arrays hold their own copy, so the cooked levels aren't needed anymore.
+      group.Layers.clear();
+      group.Layers.shrink_to_fit();
+   }
+   GLStateCache::getShared().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+TextureLayer TexturePacker::getLayer(const std::string& key, const std::string& typeName) const {
+   const Placement& placement = Placements.at(key);
+   TextureLayer layer;
+   layer.type = typeName;
+   layer.ArrayId = Arrays[placement.Group];
+   layer.Unit = getUnit(placement.Group);
+   layer.Layer = placement.Layer;
+   layer.SharedUnit = Groups.size() > TEXTURE_ARRAY_UNIT_COUNT && placement.Group >= TEXTURE_ARRAY_UNIT_COUNT - 1;
+   return layer;
+}
+
+void TexturePacker::bind() const {
+   if (Arrays.empty()) {
+      return;
+   }
+   // The arrays sharing the last unit are bound by their meshes.
+   unsigned int boundCount = std::min((unsigned int)Arrays.size(), (unsigned int)TEXTURE_ARRAY_UNIT_COUNT - (Arrays.size() > TEXTURE_ARRAY_UNIT_COUNT ? 1 : 0));
+   GLStateCache& state = GLStateCache::getShared();
+   for (unsigned int i = 0; i < boundCount; i++) {
+      state.bindTexture(getUnit(i), GL_TEXTURE_2D_ARRAY, Arrays[i]);
+   }
+   RenderStats::get().textureBinds += boundCount;
+}
+
+unsigned int TexturePacker::getUnit(unsigned int group) {
+   return std::min(group, (unsigned int)TEXTURE_ARRAY_UNIT_COUNT - 1);
+}
+
+unsigned int TexturePacker::uploadGroup(const Group& group) {
+
+   GLsizei layerCount = (GLsizei)group.Layers.size();
+   bool compressed = group.Components == 0;
+   GLenum format = group.Components == 1 ? GL_RED : GL_RGBA;
+
+   ScopedLoadTimer timer(LoadStage::TEXTURE_UPLOAD, 0, true);
+   unsigned int id;
+   GLCall(glGenTextures(1, &id));
+   GLStateCache::getShared().bindTexture(GL_TEXTURE_2D_ARRAY, id);
+   // The rows of single channel levels aren't padded to 4 bytes.
+   GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+   for (unsigned int level = 0; level < group.LevelCount; level++) {
+      const TextureLevel& first = group.Layers[0].Levels[level];
+      // Every level is allocated for all the layers at once, then filled in a layer at a time.
+      if (compressed) {
+         GLenum glFormat = TextureCompressor::getGLFormat(group.Format);
+         GLCall(glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, glFormat, first.Width, first.Height, layerCount, 0, (GLsizei)(first.Size * layerCount), nullptr));
+         for (GLsizei layer = 0; layer < layerCount; layer++) {
+            const TextureLevel& source = group.Layers[layer].Levels[level];
+            GLCall(glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, source.Width, source.Height, 1, glFormat, (GLsizei)source.Size, source.Data));
+         }
+      }
+      else {
+         GLCall(glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, first.Width, first.Height, layerCount, 0, format, GL_UNSIGNED_BYTE, nullptr));
+         for (GLsizei layer = 0; layer < layerCount; layer++) {
+            const TextureLevel& source = group.Layers[layer].Levels[level];
+            GLCall(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, source.Width, source.Height, 1, format, GL_UNSIGNED_BYTE, source.Data));
+         }
+      }
+      timer.addBytes(first.Size * layerCount);
+      Bytes += first.Size * layerCount;
+   }
+   GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+   GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)group.LevelCount - 1));
+   if (compressed ? group.Format == BlockFormat::BC4 : group.Components == 1) {
+      GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_RED));
+      GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED));
+   }
+   GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT));
+   GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT));
+   GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
+   GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+   return id;
+}
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include <glad/glad.h>
+
+#include "TextureStreamer.h"
+#include "GLStateCache.h"
+#include "OpenGLErrorHandling.h"
+
+namespace {
+
+   /**
+      Gets the first level of the tail, which stays resident.
+    */
+   unsigned int getTailLevel(const TextureData& data) {
+      for (unsigned int i = 0; i < data.Levels.size(); i++) {
+         if (std::max(data.Levels[i].Width, data.Levels[i].Height) <= TEXTURE_STREAMING_TAIL_SIZE) {
+            return i;
+         }
+      }
+      return (unsigned int)data.Levels.size() - 1;
+   }
+
+   std::string getLevelDimensions(const TextureData& data, unsigned int level) {
+      return std::to_string(data.Levels[level].Width) + "x" + std::to_string(data.Levels[level].Height);
+   }
+}
+
+TextureStreamer::TextureStreamer() :
+   Budget(DEFLT_TEXTURE_BUDGET),
+   UsedBytes(0),
+   ScreenHeight((float)DEFLT_STREAMING_SCREEN_HEIGHT),
+   UploadRing(nullptr),
+   PendingRequests(0),
+   UploadedBytes(0),
+   EvictedLevels(0)
+   {
+}
+
+TextureStreamer& TextureStreamer::getShared() {
+   static TextureStreamer streamer;
+   return streamer;
+}
+
+bool TextureStreamer::isStreamable(const TextureData& data) {
+   if (data.isCompressed() && !TextureCompressor::isSupported(data.Format)) {
+      return false;
+   }
+   return data.Levels.size() > 1 && getTailLevel(data) > 0;
+}
+
+Texture TextureStreamer::createTexture(const std::string& path, const std::string& typeName, const TextureData& data, PixelUploadRing* ring) {
+   return Texture(path, typeName, data, getTailLevel(data), ring);
+}
+
+void TextureStreamer::add(const std::shared_ptr<const Texture>& texture, TextureData&& data) {
+
+   auto found = Textures.find(texture->Id);
+   if (found != Textures.end()) {
+      if (!found->second.Owner.expired()) {
+         return;
+      }
+      // The name was freed and given to this texture before the update could forget it.
+      UsedBytes -= found->second.ResidentBytes;
+      Textures.erase(found);
+   }
+
+   StreamedTexture streamed;
+   streamed.Owner = texture;
+   streamed.Path = texture->path;
+   streamed.TailLevel = getTailLevel(data);
+   streamed.ResidentLevel = streamed.TailLevel;
+   streamed.RequestedLevel = streamed.TailLevel;
+   streamed.RequestedCoverage = 0.0f;
+   streamed.WantedLevel = streamed.TailLevel;
+   streamed.Coverage = 0.0f;
+   streamed.ResidentBytes = 0;
+   for (unsigned int i = streamed.TailLevel; i < data.Levels.size(); i++) {
+      streamed.ResidentBytes += data.Levels[i].Size;
+   }
+   streamed.TailBytes = streamed.ResidentBytes;
+   streamed.Data = std::move(data);
+   UsedBytes += streamed.ResidentBytes;
+   Textures.emplace(texture->Id, std::move(streamed));
+}
+
+void TextureStreamer::request(unsigned int textureId, float screenSize) {
+   auto found = Textures.find(textureId);
+   if (found == Textures.end()) {
+      return;
+   }
+   StreamedTexture& texture = found->second;
+   float coverage = screenSize * ScreenHeight;
+   texture.RequestedLevel = std::min(texture.RequestedLevel, getNeededLevel(texture, coverage));
+   texture.RequestedCoverage = std::max(texture.RequestedCoverage, coverage);
+}
+
+void TextureStreamer::update() {
+
+   // The texture cache already deleted the textures their last model released.
+   for (auto it = Textures.begin(); it != Textures.end();) {
+      if (it->second.Owner.expired()) {
+         UsedBytes -= it->second.ResidentBytes;
+         it = Textures.erase(it);
+      }
+      else {
+         ++it;
+      }
+   }
+
+   std::vector<StreamedTexture*> requests;
+   for (auto& entry : Textures) {
+      StreamedTexture& texture = entry.second;
+      texture.WantedLevel = texture.RequestedLevel;
+      texture.Coverage = texture.RequestedCoverage;
+      texture.RequestedLevel = texture.TailLevel;
+      texture.RequestedCoverage = 0.0f;
+      if (texture.WantedLevel < texture.ResidentLevel) {
+         requests.push_back(&texture);
+      }
+   }
+   // The textures that are the blurriest for the most pixels first.
+   std::sort(requests.begin(), requests.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+      return (a->ResidentLevel - a->WantedLevel) * a->Coverage > (b->ResidentLevel - b->WantedLevel) * b->Coverage;
+   });
+
+   UploadedBytes = 0;
+   EvictedLevels = 0;
+   for (StreamedTexture* texture : requests) {
+      // A single level a texture per update, so the upload bytes are spread over the most visible textures.
+      std::size_t bytes = texture->Data.Levels[texture->ResidentLevel - 1].Size;
+      if (UploadedBytes > 0 && UploadedBytes + bytes > TEXTURE_STREAMING_UPDATE_BYTES) {
+         break;
+      }
+      if (makeRoom(bytes, *texture)) {
+         loadLevel(*texture);
+      }
+   }
+   if (UploadedBytes > 0 || EvictedLevels > 0) {
+      GLStateCache::getShared().bindTexture(GL_TEXTURE_2D, 0);
+   }
+
+   PendingRequests = 0;
+   for (const StreamedTexture* texture : requests) {
+      if (texture->WantedLevel < texture->ResidentLevel) {
+         PendingRequests++;
+      }
+   }
+}
+
+TextureStreamingStats TextureStreamer::getStats() const {
+   TextureStreamingStats stats;
+   stats.budget = Budget;
+   stats.usedBytes = UsedBytes;
+   stats.textureCount = Textures.size();
+   stats.pendingRequests = PendingRequests;
+   stats.uploadedBytes = UploadedBytes;
+   stats.evictedLevels = EvictedLevels;
+   return stats;
+}
+
+void TextureStreamer::printReport(std::ostream& stream) const {
+   stream << "TEXTURE STREAMING: " << UsedBytes / (1024 * 1024) << " of " << Budget / (1024 * 1024) << " MB, "
+      << Textures.size() << " textures, " << PendingRequests << " pending requests\n";
+   stream << "   " << std::left << std::setw(32) << "texture" << std::right << std::setw(12) << "size" << std::setw(12) << "resident"
+      << std::setw(12) << "wanted" << std::setw(6) << "bias" << std::setw(10) << "KB" << "\n";
+   for (const auto& entry : Textures) {
+      const StreamedTexture& texture = entry.second;
+      if (texture.Owner.expired()) {
+         continue;
+      }
+      stream << "   " << std::left << std::setw(32) << texture.Path << std::right << std::setw(12) << getLevelDimensions(texture.Data, 0)
+         << std::setw(12) << getLevelDimensions(texture.Data, texture.ResidentLevel) << std::setw(12) << getLevelDimensions(texture.Data, texture.WantedLevel)
+         << std::setw(6) << (int)texture.ResidentLevel - (int)texture.WantedLevel << std::setw(10) << texture.ResidentBytes / 1024 << "\n";
+   }
+   stream << std::flush;
+}
+
+unsigned int TextureStreamer::getNeededLevel(const StreamedTexture& texture, float coverage) {
+   // Assumes the texture is mapped once over the mesh, so its largest dimension spans the mesh's height on screen.
+   const TextureLevel& base = texture.Data.Levels[0];
+   float texels = (float)std::max(base.Width, base.Height);
+   if (coverage >= texels) {
+      return 0;
+   }
+   if (coverage <= 1.0f) {
+      return texture.TailLevel;
+   }
+   return std::min((unsigned int)std::log2(texels / coverage), texture.TailLevel);
+}
+
+void TextureStreamer::loadLevel(StreamedTexture& texture) {
+   unsigned int level = texture.ResidentLevel - 1;
+   GLStateCache::getShared().bindTexture(GL_TEXTURE_2D, texture.Owner.lock()->Id);
+   texture.Data.uploadLevel(level, UploadRing);
+   GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level));
+   texture.ResidentLevel = level;
+
+   std::size_t bytes = texture.Data.Levels[level].Size;
+   texture.ResidentBytes += bytes;
+   UsedBytes += bytes;
+   UploadedBytes += bytes;
+}
+
+void TextureStreamer::evictLevel(StreamedTexture& texture) {
+   unsigned int level = texture.ResidentLevel;
+   GLStateCache::getShared().bindTexture(GL_TEXTURE_2D, texture.Owner.lock()->Id);
+   // The base level moves up first, so the texture stays complete without the level.
+   GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level + 1));
+   texture.Data.releaseLevel(level);
+   texture.ResidentLevel = level + 1;
+
+   std::size_t bytes = texture.Data.Levels[level].Size;
+   texture.ResidentBytes -= bytes;
+   UsedBytes -= bytes;
+   EvictedLevels++;
+}
+
+bool TextureStreamer::makeRoom(std::size_t bytes, const StreamedTexture& requester) {
+
+   // The levels no mesh wanted in the last frame go first, then those of the textures covering the fewest pixels.
+   auto isUnneeded = [](const StreamedTexture& texture) {
+      return texture.ResidentLevel < texture.WantedLevel;
+   };
+   auto isEvictable = [&](const StreamedTexture& texture) {
+      return &texture != &requester && texture.ResidentLevel < texture.TailLevel && (isUnneeded(texture) || texture.Coverage < requester.Coverage);
+   };
+
+   // Nothing is evicted unless it makes enough room, or the levels would be loaded back and evicted again every frame.
+   std::size_t evictableBytes = 0;
+   for (const auto& entry : Textures) {
+      if (isEvictable(entry.second)) {
+         evictableBytes += entry.second.ResidentBytes - entry.second.TailBytes;
+      }
+   }
+   if (UsedBytes + bytes > Budget + evictableBytes) {
+      return false;
+   }
+
+   while (UsedBytes + bytes > Budget) {
+      StreamedTexture* victim = nullptr;
+      for (auto& entry : Textures) {
+         StreamedTexture& texture = entry.second;
+         if (!isEvictable(texture)) {
+            continue;
+         }
+         if (victim == nullptr || (isUnneeded(texture) && !isUnneeded(*victim)) ||
+            (isUnneeded(texture) == isUnneeded(*victim) && texture.Coverage < victim->Coverage)) {
+            victim = &texture;
+         }
+      }
+      if (victim == nullptr) {
+         return false;
+      }
+      evictLevel(*victim);
+   }
+   return true;
+}
@@ -0,0 +1,49 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) :
+   Stopping(false)
+   {
+   for (unsigned int i = 0; i < threadCount; i++) {
+      Workers.emplace_back(&ThreadPool::workerLoop, this);
+   }
+}
+
+ThreadPool::~ThreadPool() {
+   {
+      std::lock_guard<std::mutex> lock(TasksMutex);
+      Stopping = true;
+   }
+   TasksCondition.notify_all();
+   for (std::thread& worker : Workers) {
+      worker.join();
+   }
+}
+
+ThreadPool& ThreadPool::getShared() {
+   static ThreadPool sharedPool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1);
+   return sharedPool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+   {
+      std::lock_guard<std::mutex> lock(TasksMutex);
+      Tasks.push(std::move(task));
+   }
+   TasksCondition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+   while (true) {
+      std::function<void()> task;
+      {
+         std::unique_lock<std::mutex> lock(TasksMutex);
+         TasksCondition.wait(lock, [this]() { return Stopping || !Tasks.empty(); });
+         if (Tasks.empty()) {
+            return;
+         }
+         task = std::move(Tasks.front());
+         Tasks.pop();
+      }
+      task();
+   }
+}
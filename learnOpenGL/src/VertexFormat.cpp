@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <gtc/packing.hpp>
+
+#include "VertexFormat.h"
+#include "Mesh.h"
+#include "OpenGLErrorHandling.h"
+
+/**
+   The layout of the HALF and QUANTIZED16 formats.
+ */
+struct PackedVertex16 {
+   std::uint16_t position[4];
+   std::int16_t normal[2];
+   std::uint16_t texCoords[2];
+};
+static_assert(sizeof(PackedVertex16) == 16, "PackedVertex16 must be 16 bytes");
+
+static inline std::int16_t toSnorm16(float value) {
+   return (std::int16_t)std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static inline std::uint16_t toUnorm16(float value) {
+   return (std::uint16_t)std::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+std::size_t VertexPacker::getStride(VertexFormat format) {
+   switch (format) {
+      case VertexFormat::HALF:
+      case VertexFormat::QUANTIZED16: {
+         return sizeof(PackedVertex16);
+      }
+      default: {
+         return sizeof(Vertex);
+      }
+   }
+}
+
+static inline bool fitsShortIndices(const std::vector<unsigned int>& indices) {
+   for (unsigned int index : indices) {
+      if (index > 0xFFFF) {
+         return false;
+      }
+   }
+   return true;
+}
+
+PackedIndices VertexPacker::packIndices(const std::vector<unsigned int>& indices, const std::vector<std::vector<unsigned int>>& lodIndices, ScratchArena& scratch) {
+
+   // The levels of detail only reference vertices of the full detail indices, so they fit the same type.
+   PackedIndices packed;
+   packed.type = fitsShortIndices(indices) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+   std::size_t indexCount = indices.size();
+   for (const std::vector<unsigned int>& lod : lodIndices) {
+      indexCount += lod.size();
+   }
+
+   if (packed.type == GL_UNSIGNED_INT && lodIndices.empty()) {
+      packed.data = (const unsigned char*)indices.data();
+      packed.size = indices.size() * sizeof(unsigned int);
+      return packed;
+   }
+
+   if (packed.type == GL_UNSIGNED_SHORT) {
+      std::uint16_t* out = scratch.allocateArray<std::uint16_t>(indexCount);
+      packed.data = (const unsigned char*)out;
+      packed.size = indexCount * sizeof(std::uint16_t);
+      for (unsigned int index : indices) {
+         *out++ = (std::uint16_t)index;
+      }
+      for (const std::vector<unsigned int>& lod : lodIndices) {
+         for (unsigned int index : lod) {
+            *out++ = (std::uint16_t)index;
+         }
+      }
+   }
+   else {
+      unsigned int* out = scratch.allocateArray<unsigned int>(indexCount);
+      packed.data = (const unsigned char*)out;
+      packed.size = indexCount * sizeof(unsigned int);
+      if (!indices.empty()) {
+         std::memcpy(out, indices.data(), indices.size() * sizeof(unsigned int));
+      }
+      out += indices.size();
+      for (const std::vector<unsigned int>& lod : lodIndices) {
+         if (!lod.empty()) {
+            std::memcpy(out, lod.data(), lod.size() * sizeof(unsigned int));
+         }
+         out += lod.size();
+      }
+   }
+   return packed;
+}
+
+std::size_t VertexPacker::getPackedIndicesSize(const std::vector<unsigned int>& indices) {
+   return indices.size() * getPackedIndexSize(indices);
+}
+
+std::size_t VertexPacker::getPackedIndexSize(const std::vector<unsigned int>& indices) {
+   return fitsShortIndices(indices) ? sizeof(std::uint16_t) : sizeof(unsigned int);
+}
+
+glm::vec2 VertexPacker::encodeOctahedral(const glm::vec3& normal) {
+   float l1Norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+   if (l1Norm == 0.0f) {
+      return glm::vec2(0.0f, 0.0f);
+   }
+   glm::vec2 encoded = glm::vec2(normal.x, normal.y) / l1Norm;
+   if (normal.z < 0.0f) {
+      // Fold the lower hemisphere over the diagonals.
+      glm::vec2 folded = glm::vec2(1.0f - std::abs(encoded.y), 1.0f - std::abs(encoded.x));
+      encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+      encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+   }
+   return encoded;
+}
+
+PackedVertices VertexPacker::pack(const std::vector<Vertex>& vertices, VertexFormat format, ScratchArena& scratch) {
+
+   PackedVertices packed;
+   packed.positionScale = glm::vec3(1.0f);
+   packed.positionOffset = glm::vec3(0.0f);
+
+   if (format == VertexFormat::FLOAT32) {
+      // The vertices are already in the layout of the format.
+      packed.data = (const unsigned char*)vertices.data();
+      packed.size = vertices.size() * sizeof(Vertex);
+      return packed;
+   }
+
+   glm::vec3 minPosition(0.0f);
+   glm::vec3 maxPosition(0.0f);
+   if (!vertices.empty()) {
+      minPosition = maxPosition = vertices[0].Position;
+   }
+   for (const Vertex& vertex : vertices) {
+      minPosition = glm::min(minPosition, vertex.Position);
+      maxPosition = glm::max(maxPosition, vertex.Position);
+   }
+
+   if (format == VertexFormat::HALF) {
+      // Positions relative to the center keep the most precision out of the half floats.
+      packed.positionOffset = (minPosition + maxPosition) * 0.5f;
+   }
+   else {
+      packed.positionOffset = minPosition;
+      packed.positionScale = maxPosition - minPosition;
+   }
+
+   PackedVertex16* out = scratch.allocateArray<PackedVertex16>(vertices.size());
+   packed.data = (const unsigned char*)out;
+   packed.size = vertices.size() * sizeof(PackedVertex16);
+   for (std::size_t i = 0; i < vertices.size(); i++) {
+      const Vertex& vertex = vertices[i];
+      glm::vec3 position = vertex.Position - packed.positionOffset;
+
+      for (int c = 0; c < 3; c++) {
+         if (format == VertexFormat::HALF) {
+            out[i].position[c] = glm::packHalf1x16(position[c]);
+         }
+         else {
+            out[i].position[c] = packed.positionScale[c] > 0.0f ? toUnorm16(position[c] / packed.positionScale[c]) : 0;
+         }
+      }
+      out[i].position[3] = 0;
+
+      glm::vec2 normal = encodeOctahedral(vertex.Normal);
+      out[i].normal[0] = toSnorm16(normal.x);
+      out[i].normal[1] = toSnorm16(normal.y);
+
+      out[i].texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+      out[i].texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+   }
+   return packed;
+}
+
+void VertexPacker::setupAttributes(VertexFormat format) {
+
+   if (format == VertexFormat::FLOAT32) {
+      // Vertex positions
+      GLCall(glEnableVertexAttribArray(0));
+      GLCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Position)));
+      //Vertex normals
+      GLCall(glEnableVertexAttribArray(1));
+      GLCall(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal)));
+      // Vertex texture coords
+      GLCall(glEnableVertexAttribArray(2));
+      GLCall(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords)));
+      return;
+   }
+
+   // Vertex positions
+   GLCall(glEnableVertexAttribArray(0));
+   if (format == VertexFormat::HALF) {
+      GLCall(glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex16), (void*)offsetof(PackedVertex16, position)));
+   }
+   else {
+      GLCall(glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex16), (void*)offsetof(PackedVertex16, position)));
+   }
+   // Vertex normals, octahedral encoded
+   GLCall(glEnableVertexAttribArray(1));
+   GLCall(glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex16), (void*)offsetof(PackedVertex16, normal)));
+   // Vertex texture coords
+   GLCall(glEnableVertexAttribArray(2));
+   GLCall(glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex16), (void*)offsetof(PackedVertex16, texCoords)));
+}
+
+void VertexPacker::setupInstanceAttributes() {
+   // A mat4 attribute takes 4 consecutive locations, one vec4 column each.
+   for (unsigned int column = 0; column < 4; column++) {
+      GLCall(glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column));
+      GLCall(glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4))));
+      GLCall(glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1));
+   }
+}
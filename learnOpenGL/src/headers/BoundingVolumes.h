@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm.hpp>
+
+struct Vertex;
+
+/**
+   An axis aligned bounding box.
+ */
+struct BoundingBox {
+   glm::vec3 Min;
+   glm::vec3 Max;
+};
+
+struct BoundingSphere {
+   glm::vec3 Center;
+   float Radius;
+};
+
+/**
+   The bounding volumes of a mesh or a model. The sphere is centered on the box.
+ */
+struct MeshBounds {
+   BoundingBox Box;
+   BoundingSphere Sphere;
+};
+
+/**
+   Computes and combines bounding volumes.
+
+   The positions are reduced 4 vertices at a time with SSE: the 4 positions are transposed into
+   a register of x, one of y and one of z, so each min, max and distance instruction works on 4
+   vertices at once. Targets without SSE2 fall back to the scalar loop.
+ */
+class BoundingVolumes {
+public:
+
+   /**
+      Computes the bounding box of the vertices' positions and the sphere around its center
+      that contains them all. Empty meshes get an empty box and sphere at the origin.
+    */
+   static MeshBounds compute(const std::vector<Vertex>& vertices);
+
+   /**
+      Computes the bounds of the bounds transformed by the indicated matrix.
+    */
+   static MeshBounds transform(const MeshBounds& bounds, const glm::mat4& transform);
+
+   /**
+      Computes the bounds that contain both bounds.
+    */
+   static MeshBounds merge(const MeshBounds& a, const MeshBounds& b);
+
+private:
+
+   /**
+      Computes the bounding box of the positions of the vertices. The vertex count must be greater than 0.
+    */
+   static BoundingBox computeBox(const Vertex* vertices, std::size_t vertexCount);
+
+   /**
+      Computes the largest squared distance from the center to the positions of the vertices.
+    */
+   static float computeMaxDistanceSquared(const Vertex* vertices, std::size_t vertexCount, const glm::vec3& center);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm.hpp>
+
+#include "Camera.h"
+
+/**
+   Axis aligned boxes stored as one array per coordinate of their centers and half extents,
+   so they can be tested against the frustum 4 at a time.
+ */
+struct BoxBatch {
+   const float* centerX;
+   const float* centerY;
+   const float* centerZ;
+   const float* extentX;
+   const float* extentY;
+   const float* extentZ;
+   size_t count;
+};
+
+/**
+   Where a volume is relative to a frustum.
+ */
+enum class FrustumTest {
+   OUTSIDE,
+   INTERSECTING,
+   INSIDE
+};
+
+/**
+   The six planes of a view frustum, pointing inwards.
+ */
+class Frustum {
+private:
+
+   // Left, right, bottom, top, near and far, as (normal, distance) with unit normals.
+   glm::vec4 Planes[6];
+
+public:
+
+   /**
+      Extracts the planes of the frustum from a combined projection, view (and model) matrix
+      (Gribb and Hartmann). The planes are in the space the matrix transforms from.
+    */
+   explicit Frustum(const glm::mat4& viewProjection);
+
+   /**
+      Extracts the world space planes of the frustum the camera sees through the indicated projection.
+    */
+   inline Frustum(const Camera& camera, const glm::mat4& projectionMat) :
+      Frustum(projectionMat * camera.getViewMatrix())
+      {
+   }
+
+   /**
+      Indicates whether the sphere is at least partly inside the frustum.
+    */
+   bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+   /**
+      Indicates whether the axis aligned box is at least partly inside the frustum. Boxes near
+      the corners of the frustum may be reported inside while being outside.
+    */
+   bool intersectsBox(const glm::vec3& center, const glm::vec3& halfExtent) const;
+
+   /**
+      Classifies the axis aligned box as outside the frustum, crossing one of its planes or inside all of them.
+      Outside is only reported when intersectsBox would return false.
+    */
+   FrustumTest classifyBox(const glm::vec3& center, const glm::vec3& halfExtent) const;
+
+   /**
+      Tests every box of the batch, 4 at a time with SSE.
+      @param outVisible Set to 1 for the boxes at least partly inside the frustum, 0 for the others.
+      @return The number of boxes inside.
+    */
+   size_t cullBoxes(const BoxBatch& boxes, unsigned char* outVisible) const;
+};
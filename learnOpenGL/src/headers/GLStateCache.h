@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// The texture units whose bindings are tracked. Binds on units past them are always issued.
+#define GL_STATE_TEXTURE_UNIT_COUNT 32
+
+// The binding the cache doesn't know, so the next bind is issued whatever it binds.
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+/**
+   The calls of one kind that reached OpenGL, and those skipped since they changed nothing.
+ */
+struct GLStateCounter {
+   std::size_t issued;
+   std::size_t elided;
+};
+
+/**
+   The calls that went through the state cache since its stats were last reset.
+ */
+struct GLStateStats {
+   GLStateCounter programs;
+   GLStateCounter vertexArrays;
+   GLStateCounter buffers;
+   GLStateCounter activeTextures;
+   GLStateCounter textures;
+
+   inline std::size_t getIssued() const {
+      return programs.issued + vertexArrays.issued + buffers.issued + activeTextures.issued + textures.issued;
+   }
+
+   inline std::size_t getElided() const {
+      return programs.elided + vertexArrays.elided + buffers.elided + activeTextures.elided + textures.elided;
+   }
+};
+
+/**
+   A shadow of the OpenGL binding state: the program in use, the VAO, the buffer bindings, the
+   active texture unit and the texture bound to every unit. The engine binds through it, and the
+   calls that would bind what is already bound are skipped.
+
+   The cache only knows the state set through it, so the objects must be deleted through it as
+   well, since OpenGL unbinds them, and invalidate() must be called after anything else binds.
+   Everything starts unknown, so the first bind of each kind is always issued. Only meant for the
+   render thread, and for a single context.
+ */
+class GLStateCache {
+private:
+
+   // The buffer targets that are tracked. Binds to the other targets are always issued.
+   enum BufferTarget {
+      ARRAY_BUFFER,
+      ELEMENT_ARRAY_BUFFER,
+      PIXEL_UNPACK_BUFFER,
+      UNIFORM_BUFFER,
+      BUFFER_TARGET_COUNT
+   };
+
+   // The texture targets that are tracked. Binds to the other targets are always issued.
+   enum TextureTarget {
+      TEXTURE_2D,
+      TEXTURE_2D_ARRAY,
+      TEXTURE_TARGET_COUNT
+   };
+
+   unsigned int Program;
+   unsigned int VertexArray;
+   // The element buffer binding belongs to the VAO, so it's forgotten when the VAO changes.
+   unsigned int Buffers[BUFFER_TARGET_COUNT];
+   unsigned int ActiveTexture;
+   unsigned int Textures[GL_STATE_TEXTURE_UNIT_COUNT][TEXTURE_TARGET_COUNT];
+   GLStateStats Stats;
+
+   GLStateCache();
+
+public:
+
+   GLStateCache(const GLStateCache& cache) = delete;
+   GLStateCache& operator=(const GLStateCache& cache) = delete;
+
+   static GLStateCache& getShared();
+
+   void useProgram(unsigned int program);
+
+   void bindVertexArray(unsigned int vertexArray);
+
+   void bindBuffer(GLenum target, unsigned int buffer);
+
+   /**
+      Makes the indicated unit, counted from 0 rather than from GL_TEXTURE0, the active one.
+    */
+   void activeTexture(unsigned int unit);
+
+   /**
+      Binds the texture on the active unit.
+    */
+   void bindTexture(GLenum target, unsigned int texture);
+
+   /**
+      Binds the texture on the indicated unit. The active unit is only changed if the texture
+      isn't bound there already.
+    */
+   void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+   void deleteProgram(unsigned int program);
+
+   void deleteVertexArrays(GLsizei count, const unsigned int* vertexArrays);
+
+   void deleteBuffers(GLsizei count, const unsigned int* buffers);
+
+   void deleteTextures(GLsizei count, const unsigned int* textures);
+
+   /**
+      Forgets all the state, after it was changed without going through the cache.
+    */
+   void invalidate();
+
+   inline const GLStateStats& getStats() const {
+      return Stats;
+   }
+
+   void resetStats();
+
+private:
+
+   /**
+      Gets the tracked target of a buffer target, or BUFFER_TARGET_COUNT if it isn't tracked.
+    */
+   static BufferTarget getBufferTarget(GLenum target);
+
+   /**
+      Gets the tracked target of a texture target, or TEXTURE_TARGET_COUNT if it isn't tracked.
+    */
+   static TextureTarget getTextureTarget(GLenum target);
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+/**
+   A file opened by Assimp through the ImportFileSystem.
+ */
+class ImportFileStream : public Assimp::IOStream {
+private:
+
+   std::FILE* File;
+   size_t Size;
+
+public:
+
+   /**
+      Takes ownership of the indicated open file, closing it when the stream is destroyed.
+    */
+   explicit ImportFileStream(std::FILE* file);
+
+   ~ImportFileStream();
+
+   ImportFileStream(const ImportFileStream& stream) = delete;
+   ImportFileStream& operator=(const ImportFileStream& stream) = delete;
+
+   size_t Read(void* buffer, size_t size, size_t count) override;
+
+   size_t Write(const void* buffer, size_t size, size_t count) override;
+
+   aiReturn Seek(size_t offset, aiOrigin origin) override;
+
+   size_t Tell() const override;
+
+   size_t FileSize() const override;
+
+   void Flush() override;
+};
+
+/**
+   The file system Assimp reads the model through, which records every file it opened, such as
+   the material libraries of an OBJ, so the model cache can tell when any of them changes.
+   The importer takes ownership of it once set as its IO handler.
+ */
+class ImportFileSystem : public Assimp::IOSystem {
+private:
+
+   std::vector<std::string> OpenedFiles;
+
+public:
+
+   bool Exists(const char* path) const override;
+
+   char getOsSeparator() const override;
+
+   Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+
+   void Close(Assimp::IOStream* stream) override;
+
+   /**
+      Gets the paths of the files that were opened for reading, once each, in the order they were first opened.
+    */
+   inline const std::vector<std::string>& getOpenedFiles() const {
+      return OpenedFiles;
+   }
+};
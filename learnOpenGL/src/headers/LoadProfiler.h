@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/**
+   The stages of loading a model, in pipeline order.
+ */
+enum class LoadStage {
+   CACHE_LOAD,
+   ASSIMP_PARSE,
+   PROCESS_MESH,
+   OPTIMIZE,
+   LOD_GENERATION,
+   CLUSTER_BUILD,
+   CACHE_SAVE,
+   TEXTURE_DECODE,
+   TEXTURE_CACHE_LOAD,
+   TEXTURE_COMPRESS,
+   TEXTURE_UPLOAD,
+   MIPMAP_GENERATION,
+   MESH_UPLOAD,
+   TOTAL,
+   COUNT
+};
+
+/**
+   The time spent and bytes produced by a stage.
+   The stages that run on several threads add up the time of every thread.
+ */
+struct LoadStageStats {
+   double milliseconds;
+   std::uint64_t bytes;
+   std::uint32_t calls;
+};
+
+/**
+   The stats of every stage, indexed by LoadStage.
+ */
+struct LoadProfile {
+   LoadStageStats stages[(int)LoadStage::COUNT];
+
+   inline const LoadStageStats& operator[](LoadStage stage) const {
+      return stages[(int)stage];
+   }
+};
+
+/**
+   Process wide counters of where the time of loading models goes, filled in by ScopedLoadTimers.
+   Safe to use from any thread.
+ */
+class LoadProfiler {
+private:
+
+   static std::atomic<std::uint64_t> Nanoseconds[(int)LoadStage::COUNT];
+   static std::atomic<std::uint64_t> Bytes[(int)LoadStage::COUNT];
+   static std::atomic<std::uint32_t> Calls[(int)LoadStage::COUNT];
+   static std::atomic<bool> GpuSynchronized;
+
+public:
+
+   /**
+      Adds a run of the indicated stage.
+    */
+   static void add(LoadStage stage, std::uint64_t nanoseconds, std::uint64_t bytes);
+
+   /**
+      Gets the stats accumulated since the last reset.
+    */
+   static LoadProfile getProfile();
+
+   /**
+      Clears the stats.
+    */
+   static void reset();
+
+   /**
+      Makes the timers of the GL stages wait for the GPU to finish, so they measure the work
+      of the driver and not just the submission of the commands. Slows down loading.
+    */
+   static inline void setGpuSynchronized(bool synchronized) {
+      GpuSynchronized = synchronized;
+   }
+
+   static inline bool isGpuSynchronized() {
+      return GpuSynchronized;
+   }
+
+   /**
+      Gets the display name of the stage.
+    */
+   static const char* getStageName(LoadStage stage);
+
+   /**
+      Prints the time, calls and bytes of every stage that ran.
+    */
+   static void printReport(std::ostream& stream, const LoadProfile& profile);
+};
+
+/**
+   Times the scope it lives in and adds it to the indicated stage of the LoadProfiler.
+ */
+class ScopedLoadTimer {
+private:
+
+   LoadStage Stage;
+   std::uint64_t Bytes;
+   bool GpuStage;
+   std::chrono::steady_clock::time_point Start;
+
+public:
+
+   /**
+      @param gpuStage Indicates whether the scope issues GL work that should be waited for when
+      the profiler synchronizes with the GPU.
+    */
+   explicit ScopedLoadTimer(LoadStage stage, std::uint64_t bytes = 0, bool gpuStage = false);
+
+   ~ScopedLoadTimer();
+
+   ScopedLoadTimer(const ScopedLoadTimer& timer) = delete;
+   ScopedLoadTimer& operator=(const ScopedLoadTimer& timer) = delete;
+
+   /**
+      Adds to the bytes the stage produced, for when they are only known at the end of the scope.
+    */
+   inline void addBytes(std::uint64_t bytes) {
+      Bytes += bytes;
+   }
+};
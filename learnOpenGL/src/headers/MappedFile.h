@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+   Size and last modification time of a file on disk.
+ */
+struct FileInfo {
+   std::uint64_t size;
+   std::int64_t modificationTime;
+};
+
+/**
+   A read only view of a whole file mapped into memory.
+ */
+class MappedFile {
+private:
+
+   const unsigned char* Data;
+   std::size_t Size;
+
+#ifdef _WIN32
+   void* FileHandle;
+   void* MappingHandle;
+#endif
+
+public:
+
+   /**
+      Exception that indicates that a file couldn't be opened or mapped.
+    */
+   class MappingFailure : public std::exception {
+   public:
+      explicit MappingFailure() {}
+   };
+
+   /**
+      Maps the file with the indicated path into memory.
+      @throws MappingFailure if the file couldn't be opened or mapped.
+    */
+   explicit MappedFile(const std::string& path);
+
+   /**
+      Unmaps the file.
+    */
+   ~MappedFile();
+
+   /**
+      A mapped file shouldn't be copied since it unmaps the file when it goes out of scope.
+    */
+   MappedFile(const MappedFile& file) = delete;
+   MappedFile& operator=(const MappedFile& file) = delete;
+
+   /**
+      Gets a pointer to the first byte of the file.
+    */
+   inline const unsigned char* data() const {
+      return Data;
+   }
+
+   /**
+      Gets the size of the file in bytes.
+    */
+   inline std::size_t size() const {
+      return Size;
+   }
+
+   /**
+      Gets the size and modification time of the file with the indicated path.
+      @return false if the file doesn't exist.
+    */
+   static bool getFileInfo(const std::string& path, FileInfo& outInfo);
+};
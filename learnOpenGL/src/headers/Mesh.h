@@ -1,12 +1,15 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
+#include "BoundingVolumes.h"
 #include "Shader.h"
+#include "VertexFormat.h"
 
 struct Vertex {
    glm::vec3 Position;
@@ -14,6 +17,10 @@ struct Vertex {
    glm::vec2 TexCoords;
 };
 
+struct TextureImage;
+struct TextureData;
+class PixelUploadRing;
+
 struct Texture {
    unsigned int Id;
    std::string type;
@@ -32,34 +39,358 @@ struct Texture {
       Loads a texture form the file with the indicated path.
    */
    Texture(const std::string& path, const std::string& directory, const std::string& typeName);
+
+   /**
+      Uploads an already decoded image as a texture.
+    */
+   Texture(const std::string& path, const std::string& typeName, const TextureImage& image);
+
+   /**
+      Uploads a cooked texture with the levels of its mip chain from the indicated one on. The
+      block compressed formats the context can't sample are decompressed first, with all their
+      levels. Single channel images are sampled as gray.
+      @param ring The ring the levels are uploaded through, or nullptr to upload them from client memory.
+    */
+   Texture(const std::string& path, const std::string& typeName, const TextureData& data, unsigned int firstLevel = 0, PixelUploadRing* ring = nullptr);
+
+private:
+
+   /**
+      Creates the texture from the decoded image and generates its mipmaps.
+    */
+   void upload(const TextureImage& image);
+
+   /**
+      Sets the wrapping and filtering of the bound texture.
+    */
+   void setSamplingParameters();
+};
+
+/**
+   The decoded pixels of a texture, before they are uploaded to the GPU.
+ */
+struct TextureImage {
+   int Width;
+   int Height;
+   int Components;
+   std::shared_ptr<unsigned char> Pixels;
+
+   /**
+      Decodes the image file with the indicated path. Safe to call from any thread.
+      @throws Texture::TextureLoadingFailure if the image couldn't be decoded.
+    */
+   static TextureImage load(const std::string& fileName);
+};
+
+/**
+   Where a texture of a mesh was packed in its model's texture arrays (see TexturePacker).
+ */
+struct TextureLayer {
+   std::string type;
+   unsigned int ArrayId;
+   // The texture unit the array is bound to, and the layer of the texture in it.
+   unsigned int Unit;
+   unsigned int Layer;
+   // Whether the array shares its unit with other arrays, so the mesh has to bind it itself.
+   bool SharedUnit;
+};
+
+/**
+   Reference to a texture of a mesh's material, as found in the model file.
+ */
+struct TextureRef {
+   std::string type;
+   std::string path;
+};
+
+/**
+   A small group of consecutive triangles of a mesh, with the bounds used to cull it on its own.
+ */
+struct MeshCluster {
+   // The range of the cluster in the mesh's full detail indices, in indices.
+   unsigned int IndexOffset;
+   unsigned int IndexCount;
+
+   // The bounding sphere of the cluster's triangles, in model space.
+   glm::vec3 Center;
+   float Radius;
+
+   // The cone that contains the normals of all the triangles. ConeCutoff is the sine of the cone's
+   // half angle, or 1 when the normals spread too much for the cluster to ever be back-facing.
+   glm::vec3 ConeAxis;
+   float ConeCutoff;
+};
+
+/**
+   The CPU side data of a mesh, before any of it is uploaded to the GPU.
+ */
+struct MeshData {
+   std::vector<Vertex> Vertices;
+   std::vector<unsigned int> Indices;
+   std::vector<TextureRef> Textures;
+
+   // The simplified levels of detail, coarsest last. They index the same vertices as Indices.
+   std::vector<std::vector<unsigned int>> LodIndices;
+
+   // The clusters that partition the full detail indices, if they were built.
+   std::vector<MeshCluster> Clusters;
+
+   // The index of the node the mesh hangs from in the model's NodeHierarchy.
+   unsigned int Node = 0;
+
+   // The bounding volumes of the vertices, in the space of the mesh's node.
+   MeshBounds Bounds;
+};
+
+/**
+   How much GPU memory the index buffers of some meshes take, compared to storing every index in 32 bits.
+ */
+struct IndexMemoryStats {
+   size_t meshCount;
+   size_t shortIndexMeshCount;
+   size_t bytes;
+   size_t bytesAs32Bit;
 };
 
+/**
+   How many triangles some meshes have at full detail and at their coarsest level of detail.
+ */
+struct LodTriangleStats {
+   size_t fullDetailTriangles;
+   size_t coarsestTriangles;
+};
+
+/**
+   Where the indices of a level of detail of a mesh start in its index buffer.
+ */
+struct MeshLod {
+   // In bytes from the start of the element buffer.
+   size_t IndexOffset;
+   unsigned int IndexCount;
+};
+
+class MeshArena;
+class Frustum;
+
 class Mesh {
 private:
 
    std::vector<Vertex> Vertices;
    std::vector<unsigned int> Indices;
    std::vector<Texture> Textures;
+   // The layers of the packed textures the mesh is drawn with instead, when its model packs them.
+   std::vector<TextureLayer> TextureLayers;
    unsigned int VAO;
    unsigned int VBO;
    unsigned int EBO;
 
+   // How the vertices are stored on the GPU, and how to bring the stored positions back to model space.
+   VertexFormat Format;
+   glm::vec3 PositionScale;
+   glm::vec3 PositionOffset;
+
+   // GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise.
+   unsigned int IndexType;
+
+   // Where the mesh lives in its model's shared arena, if it's stored in one.
+   int BaseVertex;
+
+   // The full detail indices followed by the simplified ones, all in the same element buffer.
+   std::vector<MeshLod> Lods;
+
+   // The clusters of the full detail indices, with the offsets of their indices in bytes.
+   std::vector<MeshCluster> Clusters;
+
+   // The bounding volumes of the mesh in the space of its node.
+   MeshBounds Bounds;
+
 public:
 
    /**
       Creates and initializes a mesh with all the OpenGL Configurations.
+      Pass the vectors with std::move to hand them over to the mesh without copying them.
+    */
+   Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, VertexFormat format = VertexFormat::FLOAT32);
+
+   /**
+      Creates and initializes a mesh from cooked data, with its levels of detail and clusters.
+      The vertices and indices are moved into the mesh, not copied.
+    */
+   Mesh(MeshData&& data, std::vector<Texture> textures, VertexFormat format = VertexFormat::FLOAT32);
+
+   /**
+      Creates a mesh whose vertices and indices are stored in the indicated shared arena
+      instead of buffers of its own, in the arena's vertex format.
     */
-   Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+   Mesh(MeshData&& data, std::vector<Texture> textures, MeshArena& arena);
+
+   /**
+      Deletes the VAO and buffers of the mesh from the GPU. A mesh stored in an arena has none.
+    */
+   ~Mesh();
+
+   /**
+      A mesh shouldn't be copied since it deletes its VAO and buffers when it goes out of scope,
+      but it can be moved, which hands them over to the new mesh.
+    */
+   Mesh(const Mesh& mesh) = delete;
+   Mesh& operator=(const Mesh& mesh) = delete;
+   Mesh(Mesh&& mesh) noexcept;
+   Mesh& operator=(Mesh&& mesh) = delete;
 
    /**
       Draws a mesh using the indicated shader.
+      @param lod The level of detail to draw, 0 being the full detail. Clamped to the coarsest one.
+      @param texturesBound Whether the textures of the mesh are still bound from the previous draw,
+      so only the shader's sampler uniforms are set.
     */
-   void draw(Shader& shader);
-   
+   void draw(Shader& shader, unsigned int lod = 0, bool texturesBound = false);
+
+   /**
+      Draws a mesh stored in a shared arena. The arena must already be bound.
+    */
+   void drawInArena(Shader& shader, unsigned int lod = 0, bool texturesBound = false);
+
+   /**
+      Draws the full detail mesh without its clusters that are outside the frustum or face away
+      from the camera. Consecutive visible clusters are drawn together. If the mesh is stored in
+      a shared arena, the arena must already be bound.
+      @param frustum The view frustum, in the mesh's model space.
+      @param cameraPosition The position of the camera, in the mesh's model space.
+    */
+   void drawClusters(Shader& shader, const Frustum& frustum, const glm::vec3& cameraPosition, bool texturesBound = false);
+
+   /**
+      Draws the indicated number of instances of the mesh in a single draw call. The instance
+      buffer must have been attached with attachInstanceBuffer. If the mesh is stored in a shared
+      arena, the arena must already be bound.
+    */
+   void drawInstanced(Shader& shader, unsigned int instanceCount, unsigned int lod = 0);
+
+   /**
+      Makes the mesh's VAO read the per-instance model matrices from the indicated buffer.
+      Meshes stored in a shared arena have no VAO of their own, the arena is attached instead.
+    */
+   void attachInstanceBuffer(unsigned int instanceVBO);
+
+   /**
+      Indicates whether the mesh was partitioned in clusters.
+    */
+   inline bool hasClusters() const {
+      return !Clusters.empty();
+   }
+
+   /**
+      Gets the number of levels of detail of the mesh, including the full detail one.
+    */
+   inline unsigned int getLodCount() const {
+      return (unsigned int)Lods.size();
+   }
+
+   /**
+      Gets the bounding box and sphere of the mesh, in the space of its node.
+    */
+   inline const MeshBounds& getBounds() const {
+      return Bounds;
+   }
+
+   /**
+      Gets the center of the bounding sphere of the mesh, in the space of its node.
+    */
+   inline const glm::vec3& getBoundsCenter() const {
+      return Bounds.Sphere.Center;
+   }
+
+   /**
+      Gets the radius of the bounding sphere of the mesh, in the space of its node.
+    */
+   inline float getBoundsRadius() const {
+      return Bounds.Sphere.Radius;
+   }
+
+   /**
+      Gets the textures the mesh is drawn with.
+    */
+   inline const std::vector<Texture>& getTextures() const {
+      return Textures;
+   }
+
+   /**
+      Indicates whether the mesh binds the same textures as the other one.
+    */
+   bool hasSameTextures(const Mesh& other) const;
+
+   /**
+      Gets a number that tells the textures of the mesh apart, to sort the draws by: the name
+      of its first texture or texture array, or 0 if it has none.
+    */
+   inline unsigned int getTextureKey() const {
+      return !Textures.empty() ? Textures[0].Id : !TextureLayers.empty() ? TextureLayers[0].ArrayId : 0;
+   }
+
+   /**
+      Gets the VAO of the mesh, or 0 if it's stored in a shared arena.
+    */
+   inline unsigned int getVertexArray() const {
+      return VAO;
+   }
+
+   /**
+      Makes the mesh sample the indicated layers of its model's texture arrays instead of its
+      textures. The arrays are expected to be bound to their units when the mesh is drawn.
+    */
+   inline void setTextureLayers(std::vector<TextureLayer> layers) {
+      TextureLayers = std::move(layers);
+   }
+
+   /**
+      Gets the GPU memory taken by the mesh's indices.
+    */
+   IndexMemoryStats getIndexMemoryStats() const;
+
+   /**
+      Gets the triangles of the mesh at full detail and at its coarsest level of detail.
+    */
+   LodTriangleStats getLodTriangleStats() const;
+
 private:
 
    /**
       Sets up all the OpenGL configuration of the mesh.
     */
-   void setupMesh();
+   void setupMesh(const std::vector<std::vector<unsigned int>>& lodIndices);
+
+   /**
+      Fills in the levels of detail with their offsets, in indices, once the indicated levels
+      are packed after the full detail indices.
+    */
+   void initLods(const std::vector<std::vector<unsigned int>>& lodIndices);
+
+   /**
+      Converts the offsets of the levels of detail and of the clusters from indices to bytes in the element buffer.
+    */
+   void placeLods(size_t baseOffset, unsigned int indexType);
+
+   /**
+      Issues the draw call for the indicated range of the mesh's element buffer.
+      @param indexOffset The offset of the range, in bytes.
+    */
+   void drawRange(size_t indexOffset, unsigned int indexCount);
+
+   /**
+      Picks the level of detail to draw and counts its triangles in the frame's stats.
+    */
+   const MeshLod& getLod(unsigned int lod, unsigned int instanceCount = 1) const;
+
+   /**
+      Binds the textures of the mesh and sets the shader's sampler uniforms. For packed textures,
+      sets the sampler uniforms to the units of their arrays and the layer uniforms to their layers.
+      @param bind Whether the textures are bound, rather than only setting the uniforms.
+    */
+   void bindTextures(Shader& shader, bool bind = true);
+
+   /**
+      Sets the uniforms that tell the shader how to decode the mesh's vertex format.
+    */
+   void setVertexFormatUniforms(Shader& shader);
 };
\ No newline at end of file
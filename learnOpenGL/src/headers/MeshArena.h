@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+/**
+   The location of a mesh in a MeshArena.
+ */
+struct MeshArenaRange {
+   int baseVertex;
+   // In bytes from the start of the index buffer.
+   std::size_t indexOffset;
+   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+   unsigned int indexType;
+};
+
+/**
+   A single vertex buffer and index buffer, behind a single VAO, shared by all the meshes of a model.
+
+   The meshes are drawn with glDrawElementsBaseVertex, so the arena only needs to be bound once
+   per model instead of once per mesh.
+ */
+class MeshArena {
+private:
+
+   unsigned int VAO;
+   unsigned int VBO;
+   unsigned int EBO;
+   VertexFormat Format;
+   std::size_t VertexCapacity;
+   std::size_t IndexCapacityBytes;
+   std::size_t VertexCount;
+   std::size_t IndexBytes;
+
+public:
+
+   /**
+      Exception that indicates that a mesh doesn't fit in the remaining space of the arena.
+    */
+   class ArenaFull : public std::exception {
+   public:
+      explicit ArenaFull() {}
+   };
+
+   /**
+      Allocates the GPU storage for the indicated number of vertices, in the indicated format, and bytes of indices.
+      Every mesh's indices are stored in 16 bits when they fit, so getIndexCapacity gives the space a set of meshes needs.
+    */
+   MeshArena(VertexFormat format, std::size_t vertexCapacity, std::size_t indexCapacityBytes);
+
+   /**
+      Deletes the buffers and the VAO from the GPU.
+    */
+   ~MeshArena();
+
+   /**
+      An arena shouldn't be copied since it deletes its buffers when it goes out of scope.
+    */
+   MeshArena(const MeshArena& arena) = delete;
+   MeshArena& operator=(const MeshArena& arena) = delete;
+
+   /**
+      Uploads the vertices, already packed in the arena's format, and the packed indices of a mesh to the end of the arena.
+      @return Where the mesh was stored in the arena.
+      @throws ArenaFull if there isn't enough space left.
+    */
+   MeshArenaRange append(const PackedVertices& packedVertices, const PackedIndices& packedIndices);
+
+   /**
+      Gets the bytes of index storage the indicated meshes need in an arena.
+    */
+   static std::size_t getIndexCapacity(const std::vector<MeshData>& meshesData);
+
+   /**
+      Gets the format the vertices are stored in.
+    */
+   inline VertexFormat getFormat() const {
+      return Format;
+   }
+
+   /**
+      Binds the VAO of the arena.
+    */
+   void bind() const;
+
+   inline unsigned int getVertexArray() const {
+      return VAO;
+   }
+
+   /**
+      Makes the arena's VAO read the per-instance model matrices from the indicated buffer.
+    */
+   void attachInstanceBuffer(unsigned int instanceVBO);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+#define DEFLT_CLUSTER_MAX_VERTICES  64
+#define DEFLT_CLUSTER_MAX_TRIANGLES 124
+
+/**
+   Partitions the triangles of meshes into small clusters that can be culled one by one.
+
+   Clusters are consecutive runs of triangles, so they don't change the mesh's index buffer
+   and each of them is drawn as a sub-range of it. The runs are only as compact as the triangle
+   order, so the clusters are best built after the vertex cache optimization of MeshOptimizer.
+ */
+class MeshClusterizer {
+public:
+
+   /**
+      Fills in the clusters of the full detail indices of the mesh.
+      @param maxVertices The most distinct vertices a cluster may reference.
+      @param maxTriangles The most triangles a cluster may hold.
+    */
+   static void buildClusters(MeshData& mesh, std::size_t maxVertices = DEFLT_CLUSTER_MAX_VERTICES, std::size_t maxTriangles = DEFLT_CLUSTER_MAX_TRIANGLES);
+
+   /**
+      Indicates whether every triangle of the cluster faces away from the camera.
+      @param cameraPosition The position of the camera, in the cluster's model space.
+    */
+   static inline bool isBackFacing(const MeshCluster& cluster, const glm::vec3& cameraPosition) {
+      glm::vec3 toCluster = cluster.Center - cameraPosition;
+      return glm::dot(toCluster, cluster.ConeAxis) >= cluster.ConeCutoff * glm::length(toCluster) + cluster.Radius;
+   }
+
+private:
+
+   /**
+      Computes the bounding sphere and normal cone of the cluster from its triangles.
+    */
+   static void computeClusterBounds(MeshCluster& cluster, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+#define DEFLT_VERTEX_CACHE_SIZE     16
+#define DEFLT_OVERDRAW_THRESHOLD    1.05f
+#define MAX_SHORT_INDEX_VERTICES    65536
+
+/**
+   Post-transform vertex cache efficiency of an index buffer, measured with a FIFO cache.
+ */
+struct VertexCacheStats {
+   // Average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3 is worst).
+   float acmr;
+   // Average transform to vertex ratio: transformed vertices per referenced vertex (1 is ideal).
+   float atvr;
+   std::size_t triangleCount;
+   std::size_t vertexCount;
+   std::size_t transformedCount;
+};
+
+/**
+   Vertex cache efficiency of a mesh, or of a whole model, before and after optimization.
+ */
+struct MeshOptimizationStats {
+   VertexCacheStats before;
+   VertexCacheStats after;
+};
+
+/**
+   Reorders the triangles and vertices of meshes so they render faster.
+
+   The passes are meant to run in order: vertex cache, overdraw, vertex fetch. The vertex cache pass
+   is Tipsify (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"),
+   the overdraw pass sorts the clusters it produces front to back as seen from outside the mesh,
+   and the vertex fetch pass renumbers the vertices in the order they are first used. The passes
+   only work on triangle lists, so they leave index lists whose size isn't a multiple of 3 as they are.
+ */
+class MeshOptimizer {
+public:
+
+   /**
+      Runs all the passes on the mesh.
+      @return The vertex cache efficiency of the mesh before and after.
+    */
+   static MeshOptimizationStats optimize(MeshData& mesh);
+
+   /**
+      Reorders the triangles so consecutive triangles share vertices.
+    */
+   static void optimizeVertexCache(std::vector<unsigned int>& indices, std::size_t vertexCount, unsigned int cacheSize = DEFLT_VERTEX_CACHE_SIZE);
+
+   /**
+      Reorders clusters of triangles so the ones that are likely to occlude others are drawn first.
+      Keeps the vertex cache efficiency within the indicated factor of the incoming order.
+    */
+   static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = DEFLT_OVERDRAW_THRESHOLD, unsigned int cacheSize = DEFLT_VERTEX_CACHE_SIZE);
+
+   /**
+      Reorders the vertices in the order the indices first reference them, and drops the
+      vertices that aren't referenced at all.
+    */
+   static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+   /**
+      Splits the mesh into meshes of at most the indicated number of vertices, keeping the triangle
+      order, so each part can use 16 bit indices. Meshes that are small enough are left as they are.
+      @param outMeshes The vector to which the parts are appended.
+    */
+   static void splitMesh(MeshData& mesh, std::vector<MeshData>& outMeshes, std::size_t maxVertices = MAX_SHORT_INDEX_VERTICES);
+
+   /**
+      Simulates a FIFO post-transform vertex cache of the indicated size over the indices.
+    */
+   static VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, std::size_t vertexCount, unsigned int cacheSize = DEFLT_VERTEX_CACHE_SIZE);
+
+   /**
+      Adds up the stats of several meshes.
+    */
+   static void accumulate(VertexCacheStats& total, const VertexCacheStats& stats);
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+#define DEFLT_LOD_REDUCTION      0.5f
+#define DEFLT_LOD_MAX_ERROR      0.05f
+
+/**
+   Builds simplified versions of meshes with quadric error metric edge collapses
+   (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics").
+
+   Vertices are only ever collapsed onto other existing vertices, so every level of detail
+   indexes the same vertex buffer as the full detail mesh. Identical vertices are welded first, so
+   meshes with a vertex per triangle corner simplify too. Vertices on the borders of the mesh and
+   on attribute seams (distinct vertices at the same position) are never moved, so the simplified
+   meshes have no cracks.
+ */
+class MeshSimplifier {
+public:
+
+   /**
+      Simplifies the triangles of a mesh down to about the target number of indices.
+      @param maxError The largest error allowed for a collapse, relative to the mesh's size.
+      @return The indices of the simplified mesh. It may have more indices than the target when
+      the error limit is reached first.
+    */
+   static std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, std::size_t targetIndexCount, float maxError = DEFLT_LOD_MAX_ERROR);
+
+   /**
+      Fills in the levels of detail of the mesh, each with about the indicated fraction of the
+      triangles of the previous one. Stops early when a level doesn't get simpler anymore.
+    */
+   static void generateLods(MeshData& mesh, unsigned int levelCount, float reduction = DEFLT_LOD_REDUCTION);
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+   Builds mip chains on the CPU, so textures can be uploaded with every level instead of
+   generating them on the GPU after each upload.
+
+   Every level is a 2x2 box filter of the previous one, rounded to nearest. The 1 and 4 component
+   images are filtered 16 source bytes at a time with SSE, the other ones a pixel at a time.
+ */
+class MipmapBuilder {
+public:
+
+   /**
+      Halves the dimensions of the image, averaging every 2x2 square. Odd dimensions drop their
+      last row or column, and a dimension of 1 stays 1.
+      @param outPixels The half size image, which must have room for max(width / 2, 1) * max(height / 2, 1) pixels.
+    */
+   static void downsample(const unsigned char* pixels, int width, int height, int components, unsigned char* outPixels);
+
+   /**
+      Gets the number of levels of the full mip chain of an image with the indicated dimensions, down to 1x1.
+    */
+   static unsigned int getLevelCount(int width, int height);
+
+   /**
+      Gets the size of the indicated level of the mip chain of an image, in bytes.
+    */
+   static std::size_t getLevelSize(int width, int height, int components, unsigned int level);
+};
@@ -1,53 +1,432 @@
 #pragma once
 
+#include <memory>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "Camera.h"
 #include "Mesh.h"
+#include "MeshArena.h"
+#include "MeshClusterizer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "NodeHierarchy.h"
+#include "RenderQueue.h"
+#include "SceneBvh.h"
+#include "TextureCache.h"
+#include "TextureData.h"
+#include "TexturePacker.h"
+#include "TextureStreamer.h"
+
+#define DEFLT_LOD_SCREEN_SIZE 0.5f
+
+/**
+   Settings that control how a model is loaded.
+ */
+struct ModelLoadOptions {
+   /**
+      Converts the Assimp meshes concurrently on the shared thread pool instead of one by one.
+      The resulting meshes are the same, in the same order.
+    */
+   bool parallelImport = true;
+
+   /**
+      Packs all the meshes into a single vertex and index buffer behind one VAO, so drawing the
+      model binds a single VAO instead of one per mesh.
+    */
+   bool sharedBuffers = false;
+
+   /**
+      Reorders the triangles and vertices of every mesh at import time for vertex cache
+      locality, then overdraw, then vertex fetch locality. The optimized meshes are cached.
+    */
+   bool optimizeMeshes = false;
+
+   /**
+      The layout the vertices are stored in on the GPU. The packed formats halve the vertex
+      bandwidth and memory of the meshes.
+    */
+   VertexFormat vertexFormat = VertexFormat::FLOAT32;
+
+   /**
+      Splits the meshes with more than 65536 vertices at import time so every mesh can use
+      16 bit indices. The split meshes are cached.
+    */
+   bool splitLargeMeshes = true;
+
+   /**
+      The number of simplified levels of detail built for every mesh at import time, each with
+      about lodReduction times the triangles of the previous one. The levels of detail are cached.
+    */
+   unsigned int lodLevels = 0;
+   float lodReduction = DEFLT_LOD_REDUCTION;
+
+   /**
+      The height of a mesh's bounding sphere on screen, as a fraction of the screen's height, under which
+      the first simplified level of detail is drawn. Every halving of the size moves to the next level.
+    */
+   float lodScreenSize = DEFLT_LOD_SCREEN_SIZE;
+
+   /**
+      Partitions the full detail triangles of every mesh in clusters at import time, so the
+      clusters that are off-screen or facing away from the camera are skipped when drawing.
+      The clusters are cached.
+    */
+   bool buildClusters = false;
+
+   /**
+      Uploads the textures block compressed, BC1 or BC3 for color maps and BC4 for grayscale
+      maps, instead of uncompressed. Either way the mip chain is built on the CPU.
+    */
+   bool compressTextures = false;
+
+   /**
+      Writes every cooked texture to a cache file next to its image on the first load, and maps
+      it on the next ones instead of decoding the image and building its mip chain again.
+    */
+   bool cacheTextures = true;
+
+   /**
+      Uploads only the small tail levels of the textures, and leaves the larger ones to the
+      shared TextureStreamer, which loads them as the meshes using them grow on screen within
+      its memory budget. The streamer is updated once per frame by the application.
+    */
+   bool streamTextures = false;
+
+   /**
+      Packs the textures of the same size and format in texture arrays owned by the model, so a
+      draw binds the model's few arrays once instead of every mesh binding its textures. The
+      model must then be drawn with a shader that samples them as arrays, like
+      modelShaderArray.frag. Packed textures aren't shared through the texture cache nor streamed.
+    */
+   bool packTextures = false;
+};
 
 class Model {
 private:
 
-   static std::vector<Texture> loadedTextures;
    std::vector<Mesh> Meshes;
+   // The textures of the meshes, shared through the texture cache with the other models using them.
+   std::vector<std::shared_ptr<const Texture>> Textures;
+   // The texture cache keys of the held textures, so a texture used by several meshes is held once.
+   std::unordered_set<std::string> TextureKeys;
+   // The textures of the meshes packed in arrays instead, with packTextures.
+   TexturePacker PackedTextures;
+   // The node of every mesh, parallel to Meshes.
+   std::vector<unsigned int> MeshNodes;
+   NodeHierarchy Nodes;
    std::string Directory;
+   ModelLoadOptions Options;
+   std::unique_ptr<MeshArena> Arena;
+   MeshOptimizationStats OptimizationStats;
+
+   // The per-instance model matrices of drawInstanced, created and attached to the meshes on its first call.
+   unsigned int InstanceVBO;
+   size_t InstanceCapacity;
+
+   // The hierarchy over the boxes of the meshes in model space, placed by their nodes, for
+   // culling and queries. Built once the meshes are loaded, refitted when their nodes move.
+   SceneBvh MeshBvh;
+   // The meshes the last frustum query found, kept so the query doesn't allocate every frame.
+   std::vector<unsigned int> VisibleMeshes;
 
 public:
 
+   /**
+      Exception that indicates that Assimp couldn't import the model's source file.
+    */
+   class ModelImportFailure : public std::exception {
+   public:
+      explicit ModelImportFailure() {}
+   };
+
    /**
       Loads a model form the indicated file path.
+      @throws ModelImportFailure if there is no valid cache for the model and Assimp couldn't import it.
     */
-   inline Model(const std::string& path) {
+   inline Model(const std::string& path, const ModelLoadOptions& options = ModelLoadOptions()) :
+      Options(options),
+      OptimizationStats(),
+      InstanceVBO(0),
+      InstanceCapacity(0)
+      {
       loadModel(path);
    }
 
    /**
-      Draws the model using the shader pased as a parameter.
+      Deletes the instance buffer from the GPU, and the textures no other model uses.
+    */
+   ~Model();
+
+   /**
+      A model shouldn't be copied since it deletes its instance buffer when it goes out of scope.
+    */
+   Model(const Model& model) = delete;
+   Model& operator=(const Model& model) = delete;
+
+   /**
+      Draws the model using the shader pased as a parameter. Every mesh is drawn with the
+      world transform of its node, set as the shader's ModelMat.
+      @param modelMat The model matrix the model is drawn with.
+    */
+   void draw(Shader& shader, const glm::mat4& modelMat = glm::mat4(1.0f));
+
+   /**
+      Pushes the meshes of the model to the render queue, to be drawn like draw does when the
+      queue is submitted, sorted with the items of the other models. The shader's other uniforms
+      must be set before the submission, and the model must stay alive until then.
+    */
+   void enqueue(RenderQueue& queue, Shader& shader, const glm::mat4& modelMat = glm::mat4(1.0f));
+
+   /**
+      Draws the model using the shader pased as a parameter, every mesh at the level of detail
+      that fits its size on screen as seen by the camera. The meshes whose bounding box is
+      outside the camera's frustum aren't submitted, and the clusters of the meshes drawn at
+      full detail are culled against the frustum and the view direction.
+      @param projectionMat The projection matrix the model is drawn with.
+      @param modelMat The model matrix the model is drawn with.
+    */
+   void draw(Shader& shader, const Camera& camera, const glm::mat4& projectionMat, const glm::mat4& modelMat);
+
+   /**
+      Pushes the visible meshes of the model to the render queue, at the level of detail the
+      camera sees them at, like the camera's draw does. The items of every model are sorted
+      together, front to back within the same state.
+    */
+   void enqueue(RenderQueue& queue, Shader& shader, const Camera& camera, const glm::mat4& projectionMat, const glm::mat4& modelMat);
+
+   /**
+      Draws a copy of the model per model matrix, with one draw call per mesh. The shader must
+      read its model matrix from the per-instance attribute at INSTANCE_MATRIX_LOCATION instead
+      of the ModelMat uniform, and the world transform of the mesh's node from NodeMat
+      (see modelShaderInstanced.vert).
+      @param lod The level of detail every copy is drawn at.
+    */
+   void drawInstanced(Shader& shader, const glm::mat4* modelMats, unsigned int instanceCount, unsigned int lod = 0);
+
+   inline void drawInstanced(Shader& shader, const std::vector<glm::mat4>& modelMats, unsigned int lod = 0) {
+      drawInstanced(shader, modelMats.data(), (unsigned int)modelMats.size(), lod);
+   }
+
+   /**
+      Gets the vertex cache efficiency of all the meshes before and after they were optimized.
+      Only filled in when the model was imported with optimizeMeshes, not when read from the cache.
+    */
+   inline const MeshOptimizationStats& getOptimizationStats() const {
+      return OptimizationStats;
+   }
+
+   /**
+      Gets the node hierarchy of the model, to move its parts. The world transforms are
+      brought up to date when the model is drawn.
+    */
+   inline NodeHierarchy& getNodes() {
+      return Nodes;
+   }
+
+   /**
+      Gets the box of all the meshes in the space of the model, with the nodes where they are now.
+    */
+   BoundingBox getBounds();
+
+   /**
+      Finds the mesh whose box the ray hits first, for picking, with the model placed by the model matrix.
+      @param maxDistance The length of the ray, in units of the direction.
+      @param outHit The index of the mesh and the distance to its box, in units of the direction.
+      @return false if the ray hits no mesh box within the distance.
     */
-   void draw(Shader& shader);
+   bool pickMesh(const glm::vec3& origin, const glm::vec3& direction, const glm::mat4& modelMat, float maxDistance, BvhRayHit& outHit);
+
+   /**
+      Finds the mesh whose box is closest to the point, with the model placed by the model
+      matrix. The distances are exact for model matrices of uniform scale.
+      @return false if no mesh box is within the indicated distance of the point.
+    */
+   bool findNearestMesh(const glm::vec3& point, const glm::mat4& modelMat, float maxDistance, unsigned int& outMesh, float& outDistance);
+
+   /**
+      Gets the GPU memory taken by the index buffers of all the meshes.
+    */
+   IndexMemoryStats getIndexMemoryStats() const;
+
+   /**
+      Gets the triangles of all the meshes at full detail and at their coarsest level of detail.
+    */
+   LodTriangleStats getLodTriangleStats() const;
+
+   /**
+      Converts the Assimp mesh. Every vertex and index is written once, straight into the
+      returned data, whose vectors are sized up front. Safe to call from any thread.
+    */
+   static MeshData processMesh(const aiMesh* mesh, const aiScene* scene);
 
 private:
 
+   friend class ModelHandle;
+
+   /**
+      Creates an empty model, to be filled in by a ModelHandle.
+    */
+   inline explicit Model(const ModelLoadOptions& options) :
+      Options(options),
+      OptimizationStats(),
+      InstanceVBO(0),
+      InstanceCapacity(0)
+      {
+   }
+
    /**
       Loads the model from the indicated file path.
+      @throws ModelImportFailure if Assimp couldn't import the model.
     */
    void loadModel(const std::string& path);
 
    /**
-      Recursively processes the indicated node.
+      Reads the meshes and the node hierarchy of the model from its cache, or imports them from the indicated file path.
+      Doesn't make any OpenGL call, so it can run on any thread.
+      @throws ModelImportFailure if Assimp couldn't import the model.
+    */
+   void cookModel(const std::string& path, std::vector<MeshData>& outMeshes);
+
+   /**
+      Decodes the images of the textures of the meshes that aren't loaded yet on the thread
+      pool, and uploads them on this thread as they're decoded. With packTextures, every
+      image is decoded and the arrays are uploaded once they all are.
+      @throws Texture::TextureLoadingFailure if an image couldn't be decoded.
+    */
+   void loadTextures(const std::vector<MeshData>& meshesData);
+
+   /**
+      Allocates the shared arena with enough space for all the indicated meshes.
+    */
+   void createArena(const std::vector<MeshData>& meshesData);
+
+   /**
+      Creates the GPU side mesh from the cooked data, in the shared arena if the model uses one.
+      The vertices and indices are moved out of the data into the mesh.
+    */
+   void uploadMesh(MeshData&& meshData);
+
+   /**
+      Gets the cook flags that describe the processing the options apply to the meshes.
+    */
+   std::uint32_t getCookFlags() const;
+
+   /**
+      Runs the mesh optimizer on every mesh and reports the gain.
+    */
+   void optimizeMeshes(std::vector<MeshData>& meshesData);
+
+   /**
+      Builds the levels of detail of every mesh.
+    */
+   void generateLods(std::vector<MeshData>& meshesData);
+
+   /**
+      Partitions every mesh in clusters.
+    */
+   void buildClusters(std::vector<MeshData>& meshesData);
+
+   /**
+      Picks the level of detail of the mesh from the size of its bounding sphere on screen.
+    */
+   unsigned int selectLod(const Mesh& mesh, const glm::vec3& cameraPosition, float tanHalfFov, const glm::mat4& modelMat, float modelScale) const;
+
+   /**
+      Gets the height of the mesh's bounding sphere over the height of the screen, or the
+      largest float when the camera is inside the sphere.
+    */
+   static float getScreenSize(const Mesh& mesh, const glm::vec3& cameraPosition, float tanHalfFov, const glm::mat4& modelMat, float modelScale);
+
+   /**
+      Imports the meshes of the model from the indicated file path with Assimp.
+      @param outDependencies The vector to which the paths of the other files Assimp read, such as material libraries, are appended.
+      @return false if Assimp couldn't import the model.
+    */
+   bool importModel(const std::string& path, std::vector<MeshData>& outMeshes, std::vector<std::string>& outDependencies);
+
+   /**
+      Recursively adds the indicated node and its descendants to the node hierarchy, and
+      collects their meshes, parents before children.
+      @param parent The index of the node's parent in the hierarchy.
+      @param outMeshNodes The node of every collected mesh.
+    */
+   void processNode(aiNode* node, const aiScene* scene, int parent, std::vector<aiMesh*>& outMeshes, std::vector<unsigned int>& outMeshNodes);
+
+   /**
+      Brings the world transforms of the nodes up to date, and the mesh hierarchy with them:
+      builds it once all the meshes are loaded, and refits the boxes of the meshes whose node moved.
+    */
+   void updateBounds();
+
+   /**
+      Collects the meshes whose box, placed by the model matrix and its node, is at least partly
+      inside the frustum of the view projection in VisibleMeshes, in the order of the meshes.
+    */
+   void cullMeshes(const glm::mat4& viewProjectionMat, const glm::mat4& modelMat);
+
+   /**
+      Gets the largest scale along the axes of the transform.
+    */
+   static float getMaxScale(const glm::mat4& transform);
+
+   /**
+      Gets the references to the textures of the indicated type from the Assimp material.
+    */
+   static void getMaterialTextureRefs(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<TextureRef>& outTextures);
+
+   /**
+      Uploads the model matrices to the instance buffer, creating it or growing it if needed.
+    */
+   void uploadInstances(const glm::mat4* modelMats, unsigned int instanceCount);
+
+   /**
+      Gets the size of the vertices and indices of the mesh, in bytes.
+    */
+   static std::size_t getMeshDataSize(const MeshData& meshData);
+
+   /**
+      Loads the referenced textures through the texture cache, reusing the ones that have
+      already been loaded by this model or another one, and keeps them alive for the model.
+    */
+   std::vector<Texture> loadMaterialTextures(const std::vector<TextureRef>& textureRefs);
+
+   /**
+      Creates a draw item of the model with the indicated shader, for its meshes to fill in.
+    */
+   DrawItem createDrawItem(Shader& shader) const;
+
+   /**
+      Gets the queue the draw methods push the meshes to and submit right away.
+    */
+   static RenderQueue& getImmediateQueue();
+
+   /**
+      Gets the layers the referenced textures were packed in.
+    */
+   std::vector<TextureLayer> getTextureLayers(const std::vector<TextureRef>& textureRefs) const;
+
+   /**
+      Uploads the cooked texture and adds it to the texture cache under the indicated key. With
+      streamTextures, only its tail is uploaded and the texture streamer takes over its levels.
+      @param ring The ring the levels are uploaded through, or nullptr to upload them from client memory.
+      @return The texture in the cache, which is another thread's if it added one first.
     */
-   void processNode(aiNode* node, const aiScene* scene);
+   std::shared_ptr<const Texture> addTexture(const std::string& key, TextureData&& data, const TextureRef& ref, PixelUploadRing* ring = nullptr);
 
    /**
-      Processes the Assimp mesh.
+      Keeps the texture with the indicated cache key alive for the model, unless it already is.
     */
-   Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+   void holdTexture(const std::string& key, std::shared_ptr<const Texture> texture);
 
    /**
-      Loads the textures from the Assimp data structures.
+      Requests the levels of the mesh's textures that fit its size on screen from the texture streamer.
+      @param screenSize The height of the mesh's bounding sphere over the height of the screen.
     */
-   std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+   void requestTextureLevels(const Mesh& mesh, float screenSize) const;
 };
\ No newline at end of file
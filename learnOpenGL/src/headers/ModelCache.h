@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "NodeHierarchy.h"
+
+#define MODEL_CACHE_EXTENSION ".meshcache"
+#define MODEL_CACHE_VERSION   9
+
+// Cook flags: the processing the cached meshes went through. A cache is only valid for the same flags.
+#define MODEL_COOK_OPTIMIZED_MESHES 0x1u
+#define MODEL_COOK_SPLIT_MESHES     0x2u
+#define MODEL_COOK_CLUSTERS         0x4u
+// The number of levels of detail and their reduction, in percent, are stored in the upper bits.
+#define MODEL_COOK_LOD_LEVELS_SHIFT    8
+#define MODEL_COOK_LOD_REDUCTION_SHIFT 16
+
+/**
+   Binary cache of the cooked meshes of a model, stored next to the model's source file.
+
+   The cache holds the interleaved vertices, the indices, the levels of detail, the clusters, the node, the bounds and the texture references of every mesh,
+   followed by the node hierarchy, so a warm start doesn't need to parse the source file with Assimp. It is validated against the
+   size and modification time of the source file and of every other file Assimp read with it, such as
+   the material libraries of an OBJ, falling back to a hash of their content when only the modification
+   time changed. The modification times are then rewritten, so the next load doesn't hash again.
+ */
+class ModelCache {
+public:
+
+   /**
+      Loads the cooked meshes of the model with the indicated source path.
+      @param modelPath The path of the model's source file.
+      @param cookFlags The processing the meshes are expected to have gone through.
+      @param outMeshes The vector to which the cached meshes are appended.
+      @param outNodes The hierarchy the cached nodes are added to. Must be empty.
+      @return false if there is no valid cache for the model and flags.
+    */
+   static bool load(const std::string& modelPath, std::uint32_t cookFlags, std::vector<MeshData>& outMeshes, NodeHierarchy& outNodes);
+
+   /**
+      Writes the cooked meshes of the model with the indicated source path to its cache.
+      @param dependencies The paths of the other files the model was imported from, such as its material libraries.
+      @return false if the cache couldn't be written.
+    */
+   static bool save(const std::string& modelPath, std::uint32_t cookFlags, const std::vector<std::string>& dependencies,
+      const std::vector<MeshData>& meshes, const NodeHierarchy& nodes);
+
+   /**
+      Gets the path of the cache of the model with the indicated source path.
+    */
+   static inline std::string getCachePath(const std::string& modelPath) {
+      return modelPath + MODEL_CACHE_EXTENSION;
+   }
+
+private:
+
+   /**
+      Computes the FNV-1a hash of the file with the indicated path.
+      @return false if the file couldn't be read.
+    */
+   static bool hashFile(const std::string& path, std::uint64_t& outHash);
+
+   /**
+      Checks whether the file with the indicated path still has the recorded size and content.
+      @param modificationTime The recorded modification time, set to the current one if only it changed.
+      @param outTouched Set to true if only the modification time changed.
+      @return false if the file is missing or was modified.
+    */
+   static bool checkFile(const std::string& path, std::uint64_t size, std::int64_t& modificationTime, std::uint64_t hash, bool& outTouched);
+};
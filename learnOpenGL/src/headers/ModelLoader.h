@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+
+#define DEFLT_UPLOAD_BUDGET_MS 4.0f
+
+/**
+   A model that is being loaded in the background by a ModelLoader.
+ */
+class ModelHandle {
+private:
+
+   friend class ModelLoader;
+
+   std::unique_ptr<Model> LoadedModel;
+   std::string Path;
+
+   // Filled in by the background task, read by the render thread once the task has finished.
+   std::future<void> Cooking;
+   std::vector<MeshData> MeshesData;
+   std::vector<TextureRef> TextureRefs;
+   // The texture cache keys of the unique texture references.
+   std::vector<std::string> TextureKeys;
+   // Left empty for the textures that were already in the cache when the model was cooked.
+   std::vector<TextureData> DecodedTextures;
+
+   // The next texture and mesh to upload to the GPU.
+   size_t NextTexture;
+   size_t NextMesh;
+
+   std::atomic<bool> Ready;
+   // When the load was started, for its total time, which spans the background task and the uploads of many frames.
+   std::chrono::steady_clock::time_point LoadStart;
+   std::atomic<unsigned int> DoneUnits;
+   std::atomic<unsigned int> TotalUnits;
+
+public:
+
+   /**
+      Indicates whether the model is completely loaded and can be drawn.
+    */
+   inline bool isReady() const {
+      return Ready.load(std::memory_order_acquire);
+   }
+
+   /**
+      Gets the fraction of the loading work that is already done, from 0 to 1.
+      The work is counted in parsing, texture decodes and GL uploads.
+    */
+   inline float getProgress() const {
+      unsigned int total = TotalUnits.load();
+      return total == 0 ? 0.0f : (float)DoneUnits.load() / (float)total;
+   }
+
+   /**
+      Gets the loaded model. Must only be called once the handle is ready.
+    */
+   inline Model& getModel() {
+      return *LoadedModel;
+   }
+
+   /**
+      Gets the path of the model's source file.
+    */
+   inline const std::string& getPath() const {
+      return Path;
+   }
+
+private:
+
+   ModelHandle(const std::string& path, const ModelLoadOptions& options);
+
+   /**
+      Reads the meshes of the model and decodes its textures. Runs on the thread pool.
+      @throws Model::ModelImportFailure if the model couldn't be imported, which processUploads rethrows.
+    */
+   void cook();
+
+   /**
+      Indicates whether there is nothing left to upload to the GPU.
+    */
+   inline bool isUploadDone() const {
+      return NextTexture == TextureRefs.size() && NextMesh == MeshesData.size();
+   }
+
+   /**
+      Uploads the next texture or mesh of the model to the GPU, the textures through the ring if there is one.
+    */
+   void uploadNext(PixelUploadRing* ring);
+};
+
+/**
+   Loads models without blocking the render thread.
+
+   Parsing and texture decoding run on the shared thread pool, while the GL uploads are queued
+   and run on the render thread by processUploads, a few at a time so the frame rate holds.
+ */
+class ModelLoader {
+private:
+
+   std::list<std::shared_ptr<ModelHandle>> Pending;
+   float UploadBudgetMs;
+   PixelUploadRing* UploadRing;
+
+   float LastFrameUploadMs;
+   float MaxFrameUploadMs;
+   unsigned int LastFrameUploads;
+
+public:
+
+   /**
+      Creates a loader that spends about the indicated time on GL uploads every frame.
+      @param ring The ring the textures are uploaded through, which must outlive the loader, or nullptr to upload them from client memory.
+    */
+   explicit ModelLoader(float uploadBudgetMs = DEFLT_UPLOAD_BUDGET_MS, PixelUploadRing* ring = nullptr);
+
+   /**
+      Starts loading the model from the indicated file path and returns right away.
+    */
+   std::shared_ptr<ModelHandle> loadAsync(const std::string& path, const ModelLoadOptions& options = ModelLoadOptions());
+
+   /**
+      Runs the pending GL uploads until the frame's upload budget is spent.
+      Must be called once per frame on the thread that owns the OpenGL context.
+      @throws The exception thrown by the background loading of a model, e.g. Model::ModelImportFailure or Texture::TextureLoadingFailure.
+         The model's handle is dropped and never becomes ready.
+    */
+   void processUploads();
+
+   /**
+      Gets the number of models that are still loading.
+    */
+   inline size_t getPendingCount() const {
+      return Pending.size();
+   }
+
+   /**
+      Gets the time spent on GL uploads in the last call to processUploads, in milliseconds.
+    */
+   inline float getLastFrameUploadMs() const {
+      return LastFrameUploadMs;
+   }
+
+   /**
+      Gets the longest time spent on GL uploads in a single frame, in milliseconds.
+    */
+   inline float getMaxFrameUploadMs() const {
+      return MaxFrameUploadMs;
+   }
+
+   /**
+      Gets the number of textures and meshes uploaded in the last call to processUploads.
+    */
+   inline unsigned int getLastFrameUploads() const {
+      return LastFrameUploads;
+   }
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm.hpp>
+
+// The parent of the root nodes.
+#define NO_PARENT_NODE -1
+
+/**
+   The node hierarchy of a model as a flat table, every node stored after its parent.
+
+   Each property is an array of its own (local transforms, world transforms, parents, dirty
+   flags), so the update walks them linearly without touching the cold data like the names.
+   Changing a local transform only flags the node: the world transforms of the flagged nodes
+   and their descendants are recomputed by updateWorldTransforms in a single pass that starts
+   at the first flagged node.
+ */
+class NodeHierarchy {
+private:
+
+   std::vector<int> Parents;
+   std::vector<glm::mat4> LocalTransforms;
+   std::vector<glm::mat4> WorldTransforms;
+   std::vector<unsigned char> DirtyFlags;
+   std::vector<std::string> Names;
+
+   // The index of the first flagged node, the node count when none is.
+   size_t FirstDirty;
+
+public:
+
+   inline NodeHierarchy() :
+      FirstDirty(0)
+      {
+   }
+
+   /**
+      Adds a node at the end of the table.
+      @param parent The index of the parent node, which must already be in the table, or NO_PARENT_NODE.
+      @return The index of the node.
+    */
+   unsigned int addNode(const std::string& name, int parent, const glm::mat4& localTransform);
+
+   /**
+      Removes every node.
+    */
+   void clear();
+
+   /**
+      Reserves room for the indicated number of nodes.
+    */
+   void reserve(size_t nodeCount);
+
+   /**
+      Sets the transform of the node relative to its parent. Its world transform, and the ones
+      of its descendants, are out of date until the next updateWorldTransforms.
+    */
+   void setLocalTransform(unsigned int node, const glm::mat4& localTransform);
+
+   /**
+      Recomputes the world transforms of the nodes whose local transform changed and of their descendants.
+      @return The number of world transforms recomputed.
+    */
+   size_t updateWorldTransforms();
+
+   /**
+      Gets the index of the first node with the indicated name.
+      @return -1 if no node has the name.
+    */
+   int findNode(const std::string& name) const;
+
+   inline const glm::mat4& getLocalTransform(unsigned int node) const {
+      return LocalTransforms[node];
+   }
+
+   /**
+      Gets the transform of the node relative to the model, as of the last updateWorldTransforms.
+    */
+   inline const glm::mat4& getWorldTransform(unsigned int node) const {
+      return WorldTransforms[node];
+   }
+
+   inline int getParent(unsigned int node) const {
+      return Parents[node];
+   }
+
+   inline const std::string& getName(unsigned int node) const {
+      return Names[node];
+   }
+
+   inline size_t getNodeCount() const {
+      return Parents.size();
+   }
+
+   inline bool isDirty() const {
+      return FirstDirty < Parents.size();
+   }
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "TextureData.h"
+#include "ThreadPool.h"
+
+#define DEFLT_UPLOAD_SLOT_COUNT 4
+#define DEFLT_UPLOAD_SLOT_SIZE  (16u << 20)
+
+// The copy of a level into a slot is split in chunks of this size across the thread pool.
+#define UPLOAD_COPY_CHUNK_SIZE (1u << 20)
+
+// The levels are placed in a slot at offsets aligned to this many bytes.
+#define UPLOAD_OFFSET_ALIGNMENT 16
+
+/**
+   The uploads of a pixel upload ring since its stats were last reset.
+ */
+struct PixelUploadStats {
+   // The levels uploaded through the ring, and those too large for a slot, uploaded from client memory.
+   std::size_t uploads;
+   std::size_t directUploads;
+   std::uint64_t bytes;
+   // The slots that were still being read by the GPU when the ring came back to them, and the time spent waiting for them.
+   std::size_t stalls;
+   double stallMilliseconds;
+};
+
+/**
+   Uploads texture levels through a ring of pixel unpack buffers, so the render thread doesn't
+   wait for the driver to copy them from client memory.
+
+   Every level is copied after the previous one in the current slot of the ring, by the thread
+   pool's threads for the large ones, and the texture is specified from the slot, which the GPU
+   reads asynchronously. When a level doesn't fit, the slot is closed with a fence and the ring
+   moves on to the next one; it only waits when it comes back around to a slot the GPU is still
+   reading. The slots are mapped once and for all when the context supports persistent mapping
+   (OpenGL 4.4), and otherwise the range of every level is mapped unsynchronized for its copy,
+   which the fences make safe. Must be used on the OpenGL thread.
+ */
+class PixelUploadRing {
+private:
+
+   struct Slot {
+      unsigned int Buffer;
+      GLsync Fence;
+      unsigned char* Mapped;
+   };
+
+   std::vector<Slot> Slots;
+   std::size_t SlotSize;
+   unsigned int CurrentSlot;
+   // The bytes of the current slot already used by the levels uploaded since it was acquired.
+   std::size_t Offset;
+   bool Persistent;
+   ThreadPool* Pool;
+   PixelUploadStats Stats;
+
+public:
+
+   /**
+      Creates the buffers of the ring.
+      @param slotSize The size of every slot, the largest level the ring can take.
+      @param pool The thread pool the large copies are spread on, or nullptr to copy on the calling thread.
+    */
+   explicit PixelUploadRing(std::size_t slotSize = DEFLT_UPLOAD_SLOT_SIZE, unsigned int slotCount = DEFLT_UPLOAD_SLOT_COUNT, ThreadPool* pool = &ThreadPool::getShared());
+
+   /**
+      Waits for the pending transfers and deletes the buffers.
+    */
+   ~PixelUploadRing();
+
+   /**
+      A ring shouldn't be copied since it deletes its buffers when it goes out of scope.
+    */
+   PixelUploadRing(const PixelUploadRing& ring) = delete;
+   PixelUploadRing& operator=(const PixelUploadRing& ring) = delete;
+
+   /**
+      Uploads the indicated level of the texture data to the texture bound to GL_TEXTURE_2D.
+      @return false if the level doesn't fit in a slot, for the caller to upload it from client memory.
+    */
+   bool uploadLevel(const TextureData& data, unsigned int level);
+
+   inline bool isPersistent() const {
+      return Persistent;
+   }
+
+   inline const PixelUploadStats& getStats() const {
+      return Stats;
+   }
+
+   inline void resetStats() {
+      Stats = PixelUploadStats();
+   }
+
+private:
+
+   /**
+      Fences the current slot and moves on to the next one, waiting until the GPU is done reading it.
+    */
+   void advanceSlot();
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "Mesh.h"
+#include "Shader.h"
+
+class MeshArena;
+class TexturePacker;
+
+/**
+   The passes of a frame, drawn in this order. The opaque items are drawn front to back, so
+   the depth test rejects the hidden fragments early, and the transparent ones back to front.
+ */
+enum class RenderPass {
+   OPAQUE,
+   TRANSPARENT
+};
+
+/**
+   A mesh to draw, with the state it's drawn with.
+ */
+struct DrawItem {
+   Shader* Program;
+   Mesh* DrawnMesh;
+   // The arena the mesh is stored in, or nullptr if it has a VAO of its own.
+   const MeshArena* Arena;
+   // The texture arrays the mesh's textures are packed in, or nullptr if they aren't.
+   const TexturePacker* PackedTextures;
+   glm::mat4 ModelMat;
+   unsigned int Lod;
+   // Whether the clusters of the full detail mesh are culled, against the frustum of this
+   // matrix, the view projection in the space of the mesh's node, and the camera position in that space.
+   bool CullClusters;
+   glm::mat4 ClusterViewProjection;
+   glm::vec3 ClusterCameraPosition;
+};
+
+/**
+   The state changes drawing some items took.
+ */
+struct StateChanges {
+   std::size_t programs;
+   std::size_t textures;
+   std::size_t vertexArrays;
+
+   inline std::size_t getTotal() const {
+      return programs + textures + vertexArrays;
+   }
+};
+
+/**
+   The items of the last submitted frame and its state changes, in the order they were pushed
+   and in the order they were drawn.
+ */
+struct RenderQueueStats {
+   std::size_t items;
+   StateChanges pushed;
+   StateChanges sorted;
+};
+
+/**
+   Collects the draws of a frame and submits them sorted by the state they need, so the
+   programs, textures and VAOs are changed as few times as possible.
+
+   Every item gets a 64 bit key, its pass, program, textures, VAO and depth from the most to
+   the least significant bits, and the keys are radix sorted. The submission then only changes
+   the state that differs from the previous item's. Only meant for the render thread.
+ */
+class RenderQueue {
+private:
+
+   struct SortEntry {
+      std::uint64_t Key;
+      std::uint32_t Item;
+   };
+
+   std::vector<DrawItem> Items;
+   std::vector<SortEntry> Entries;
+   // The second buffer of the radix sort, kept so sorting doesn't allocate once warmed up.
+   std::vector<SortEntry> SortBuffer;
+   RenderQueueStats Stats;
+
+public:
+
+   RenderQueue();
+
+   RenderQueue(const RenderQueue& queue) = delete;
+   RenderQueue& operator=(const RenderQueue& queue) = delete;
+
+   /**
+      Adds an item to draw in the next submission.
+      @param depth The distance from the camera to the item, to order the items of the same state.
+    */
+   void push(const DrawItem& item, float depth, RenderPass pass = RenderPass::OPAQUE);
+
+   /**
+      Sorts the items, draws them and empties the queue.
+    */
+   void submit();
+
+   inline std::size_t getSize() const {
+      return Items.size();
+   }
+
+   /**
+      Gets the stats of the last submission.
+    */
+   inline const RenderQueueStats& getStats() const {
+      return Stats;
+   }
+
+   /**
+      Prints the state changes of the last submission, as pushed and as drawn.
+    */
+   void printReport(std::ostream& stream) const;
+
+   /**
+      Builds the sort key of an item.
+    */
+   static std::uint64_t getKey(const DrawItem& item, float depth, RenderPass pass);
+
+private:
+
+   /**
+      Sorts the entries by key, least significant byte first, skipping the bytes all the keys share.
+    */
+   void sortEntries();
+
+   /**
+      Counts the state changes of drawing the items in the order of the entries.
+    */
+   StateChanges countStateChanges() const;
+
+   /**
+      Gets the VAO the item is drawn from.
+    */
+   static unsigned int getVertexArray(const DrawItem& item);
+
+   /**
+      Indicates whether the items are drawn with the same textures.
+    */
+   static bool haveSameTextures(const DrawItem& a, const DrawItem& b);
+};
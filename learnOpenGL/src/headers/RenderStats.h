@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+   What was submitted to the GPU during a frame.
+ */
+struct FrameStats {
+   size_t drawCalls;
+   // The textures and texture arrays bound.
+   size_t textureBinds;
+   // The triangles of the levels of detail that were drawn.
+   size_t triangles;
+   // The triangles that would have been drawn with every mesh at full detail.
+   size_t fullDetailTriangles;
+   // The clusters checked against the frustum and their normal cone, and the ones that were skipped.
+   size_t clustersTested;
+   size_t clustersRejected;
+   // The meshes inside the view frustum, and the ones outside it that weren't submitted.
+   size_t meshesVisible;
+   size_t meshesCulled;
+};
+
+/**
+   Counters of the current frame, filled in by the draw calls. Only meant for the render thread.
+ */
+class RenderStats {
+public:
+
+   /**
+      Gets the counters of the current frame.
+    */
+   static inline FrameStats& get() {
+      static FrameStats stats = {};
+      return stats;
+   }
+
+   /**
+      Clears the counters, at the start of a frame.
+    */
+   static inline void reset() {
+      get() = FrameStats();
+   }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+#include "Camera.h"
+#include "Model.h"
+#include "RenderQueue.h"
+#include "SceneBvh.h"
+#include "Shader.h"
+
+/**
+   The mesh of an instance of the scene found by a query.
+ */
+struct ScenePick {
+   unsigned int instance;
+   unsigned int mesh;
+   // Along the ray in units of its direction for picks, in world units for the nearest mesh.
+   float distance;
+};
+
+/**
+   The instances of the models drawn together, each a model placed by its model matrix.
+
+   The world space boxes of the instances are kept in a SceneBvh, one item per instance, built
+   once the instances are added and refitted when an instance moves or the nodes of its model do.
+   Culling and the spatial queries walk it to find the instances, then the mesh hierarchy of each
+   instance's model to find its meshes. The models must outlive the scene.
+ */
+class Scene {
+private:
+
+   std::vector<Model*> Models;
+   std::vector<glm::mat4> ModelMats;
+   // The box of every instance's model, in the space of the model, when the instance's box was computed.
+   std::vector<BoundingBox> ModelBounds;
+   SceneBvh InstanceBvh;
+
+   // Reused by the queries so they don't allocate every frame.
+   std::vector<unsigned int> FoundInstances;
+   std::vector<BvhRayHit> RayHits;
+
+public:
+
+   /**
+      Adds an instance of the model, which must already be loaded.
+      @return The index of the instance.
+    */
+   unsigned int addInstance(Model& model, const glm::mat4& modelMat = glm::mat4(1.0f));
+
+   /**
+      Moves the instance. Its box is refitted on the next update.
+    */
+   void setTransform(unsigned int instance, const glm::mat4& modelMat);
+
+   inline const glm::mat4& getTransform(unsigned int instance) const {
+      return ModelMats[instance];
+   }
+
+   inline Model& getModel(unsigned int instance) {
+      return *Models[instance];
+   }
+
+   inline size_t getInstanceCount() const {
+      return Models.size();
+   }
+
+   /**
+      Brings the instance hierarchy up to date: builds it when instances were added, and
+      refits the boxes of the instances that moved or whose model's nodes moved.
+    */
+   void update();
+
+   /**
+      Pushes the meshes of every instance to the render queue at full detail, like Model::enqueue without a camera.
+    */
+   void enqueue(RenderQueue& queue, Shader& shader);
+
+   /**
+      Pushes the visible meshes of the instances whose box is at least partly inside the camera's
+      frustum to the render queue, like Model::enqueue with a camera does for each of them.
+    */
+   void enqueue(RenderQueue& queue, Shader& shader, const Camera& camera, const glm::mat4& projectionMat);
+
+   /**
+      Finds the mesh whose box the ray hits first among all the instances, for picking.
+      @param maxDistance The length of the ray, in units of the direction.
+      @return false if the ray hits no mesh box within the distance.
+    */
+   bool pick(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ScenePick& outPick);
+
+   /**
+      Finds the mesh whose box is closest to the point among all the instances.
+      @return false if no mesh box is within the indicated distance of the point.
+    */
+   bool findNearest(const glm::vec3& point, float maxDistance, ScenePick& outPick);
+
+private:
+
+   /**
+      Gets the world space box of the instance from the box of its model.
+    */
+   BoundingBox getInstanceBounds(unsigned int instance) const;
+};
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+
+#include <glm.hpp>
+
+#include "BoundingVolumes.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+// The number of buckets the item centroids are sorted in along each axis to evaluate the split costs.
+#define BVH_BIN_COUNT 16
+// The item count under which a node is never split.
+#define BVH_MIN_SPLIT_SIZE 2
+// The item count over which a node is always split, even if the surface area heuristic prefers a leaf.
+#define BVH_MAX_LEAF_SIZE 16
+// The cost of visiting a node, relative to the cost of testing an item.
+#define BVH_TRAVERSAL_COST 1.0f
+// The deepest a node can be. Deeper nodes become leaves, so the traversal stacks have a fixed size.
+#define BVH_MAX_DEPTH 64
+// The item count under which a subtree is built by a single task of the thread pool.
+#define BVH_TASK_SIZE 4096
+
+/**
+   A node of the hierarchy. Interior nodes have two children stored next to each other, after the node.
+ */
+struct BvhNode {
+   glm::vec3 Min;
+   // The index of the first child of an interior node, or of the first item of a leaf in the item order.
+   unsigned int First;
+   glm::vec3 Max;
+   // The number of items of a leaf, 0 for interior nodes.
+   unsigned int Count;
+};
+
+/**
+   The item whose box a ray hits first.
+ */
+struct BvhRayHit {
+   unsigned int item;
+   // The distance along the ray to the item's box, in units of the ray's direction.
+   float distance;
+};
+
+/**
+   Bounding volume hierarchy over the world space boxes of the items of a scene, such as the
+   meshes of every model instance, for culling and spatial queries.
+
+   The hierarchy is built top-down, choosing every split with the surface area heuristic over
+   binned centroids. The top levels are split on the calling thread until the subtrees are
+   small enough, then the subtrees are built in parallel on the thread pool. When items move,
+   their leaves and the ancestors whose box changed are refitted, without changing the tree.
+   The queries walk the tree with a fixed size stack.
+ */
+class SceneBvh {
+private:
+
+   std::vector<BvhNode> Nodes;
+   std::vector<unsigned int> Parents;
+   // The items sorted by leaf, each leaf owning a contiguous range.
+   std::vector<unsigned int> ItemOrder;
+   std::vector<unsigned int> ItemLeaves;
+   std::vector<BoundingBox> ItemBounds;
+   // The centers and half extents of the item boxes in the item order, one array per coordinate
+   // (center x, y, z, then extent x, y, z), so the items of a leaf are culled 4 at a time.
+   std::vector<float> OrderedBoxes;
+   // The position of every item in the item order.
+   std::vector<unsigned int> ItemSlots;
+
+   // The leaves with an item that moved since the last refit.
+   std::vector<unsigned int> DirtyLeaves;
+   std::vector<unsigned char> LeafDirtyFlags;
+
+public:
+
+   /**
+      Builds the hierarchy over the indicated item boxes, replacing the previous one. The items
+      are identified by their index in the vector.
+      @param pool The thread pool the subtrees are built on, or nullptr to build on the calling thread only.
+    */
+   void build(const std::vector<BoundingBox>& itemBounds, ThreadPool* pool = &ThreadPool::getShared());
+
+   /**
+      Changes the box of the item. The hierarchy is out of date until the next refit.
+    */
+   void setItemBounds(unsigned int item, const BoundingBox& bounds);
+
+   /**
+      Refits the leaves of the items that moved and their ancestors, stopping at the first ancestor whose box is unchanged.
+      @return The number of nodes recomputed.
+    */
+   size_t refit();
+
+   /**
+      Refits every node in a single backwards pass, for when most of the items moved.
+    */
+   void refitAll();
+
+   /**
+      Collects the items whose box is at least partly inside the frustum. Subtrees fully inside
+      the frustum are collected without testing their items, and the items of the leaves crossing
+      it are tested together with Frustum::cullBoxes.
+    */
+   void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& outItems) const;
+
+   /**
+      Finds the item whose box the ray hits first, for picking.
+      @param maxDistance The length of the ray, in units of the direction.
+      @return false if the ray hits no item box within the distance.
+    */
+   bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& outHit) const;
+
+   /**
+      Collects every item whose box the ray hits, with the distance to the box, in no particular order.
+      @param maxDistance The length of the ray, in units of the direction.
+    */
+   void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<BvhRayHit>& outHits) const;
+
+   /**
+      Collects the items whose box overlaps the sphere.
+    */
+   void querySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& outItems) const;
+
+   /**
+      Finds the item whose box is closest to the point.
+      @return false if no item box is within the indicated distance of the point.
+    */
+   bool findNearest(const glm::vec3& point, float maxDistance, unsigned int& outItem, float& outDistance) const;
+
+   /**
+      Intersects the ray with the box (slab test).
+      @param inverseDirection The reciprocal of every component of the ray's direction.
+      @param outDistance The distance along the ray where it enters the box, 0 if it starts inside.
+    */
+   static bool intersectRay(const BoundingBox& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& outDistance);
+
+   /**
+      Gets the squared distance from the point to the closest point of the box, 0 if it's inside.
+    */
+   static float getDistanceSquared(const BoundingBox& box, const glm::vec3& point);
+
+   inline size_t getNodeCount() const {
+      return Nodes.size();
+   }
+
+   inline size_t getItemCount() const {
+      return ItemBounds.size();
+   }
+
+   inline const BoundingBox& getItemBounds(unsigned int item) const {
+      return ItemBounds[item];
+   }
+
+   /**
+      Gets the box of all the items as of the last build or refit, an empty box at the origin if there are none.
+    */
+   inline BoundingBox getBounds() const {
+      return Nodes.empty() ? BoundingBox{ glm::vec3(0.0f), glm::vec3(0.0f) } : BoundingBox{ Nodes[0].Min, Nodes[0].Max };
+   }
+
+private:
+
+   /**
+      A subtree left for a task of the thread pool: a placeholder node and its item range.
+    */
+   struct PendingSubtree {
+      unsigned int node;
+      unsigned int begin;
+      unsigned int end;
+      unsigned int depth;
+   };
+
+   /**
+      Makes the node a leaf or splits its items in two and builds its children, recursively.
+      @param centroids The centroid of every item's box.
+      @param outPending If not null, the subtrees under BVH_TASK_SIZE items are left as leaves
+      and recorded there instead of being built.
+    */
+   void buildNode(std::vector<BvhNode>& nodes, const std::vector<glm::vec3>& centroids, unsigned int node,
+      unsigned int begin, unsigned int end, unsigned int depth, std::vector<PendingSubtree>* outPending);
+
+   /**
+      Finds the split of the item range with the lowest surface area heuristic cost and partitions the items around it.
+      @return The index of the first item of the second half, or end if keeping the range in a leaf is cheaper.
+    */
+   unsigned int partitionItems(const std::vector<glm::vec3>& centroids, const BoundingBox& nodeBounds, unsigned int begin, unsigned int end);
+
+   /**
+      Gets the range of the item order covered by the subtree of the node, which is contiguous
+      since every split partitions its parent's range.
+    */
+   void getItemRange(unsigned int node, unsigned int& outBegin, unsigned int& outEnd) const;
+
+   /**
+      Computes the box of the items of the range.
+    */
+   BoundingBox computeRangeBounds(unsigned int begin, unsigned int end) const;
+
+   /**
+      Recomputes the box of the node from its items or children.
+      @return false if the box didn't change.
+    */
+   bool refitNode(unsigned int node);
+
+   /**
+      Fills in the parents of the nodes, the leaves and slots of the items and the ordered boxes from the tree.
+    */
+   void linkNodes();
+
+   /**
+      Writes the center and half extent of the box to the indicated position of the ordered boxes.
+    */
+   void setOrderedBox(unsigned int slot, const BoundingBox& bounds);
+
+   /**
+      Gets the batch of the ordered boxes from the indicated position of the item order.
+    */
+   BoxBatch getOrderedBoxes(unsigned int first, unsigned int count) const;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#define DEFLT_SCRATCH_BLOCK_SIZE (1 << 20)
+
+/**
+   A bump allocator for temporary buffers, such as the packed vertices and indices of a mesh
+   on their way to the GPU.
+
+   Allocations are only released all at once, when the outermost Scope ends. The memory is kept
+   for the next allocations, and the blocks are merged into a single one big enough for all of
+   them, so once warmed up the arena doesn't allocate anymore.
+ */
+class ScratchArena {
+private:
+
+   std::vector<std::unique_ptr<unsigned char[]>> Blocks;
+   std::vector<std::size_t> BlockSizes;
+   std::size_t Used;
+   std::size_t TotalUsed;
+   std::size_t PeakUsed;
+   unsigned int ScopeDepth;
+
+public:
+
+   /**
+      Releases the allocations of the arena when it ends, unless it is nested in another scope.
+    */
+   class Scope {
+   private:
+      ScratchArena& Arena;
+
+   public:
+      explicit Scope(ScratchArena& arena);
+      ~Scope();
+
+      Scope(const Scope& scope) = delete;
+      Scope& operator=(const Scope& scope) = delete;
+   };
+
+   ScratchArena();
+
+   ScratchArena(const ScratchArena& arena) = delete;
+   ScratchArena& operator=(const ScratchArena& arena) = delete;
+
+   /**
+      Gets the arena of the calling thread.
+    */
+   static ScratchArena& getThreadLocal();
+
+   /**
+      Allocates uninitialized memory, valid until the outermost scope ends.
+    */
+   void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+   /**
+      Allocates an uninitialized array of the indicated type, valid until the outermost scope ends.
+    */
+   template<typename T>
+   inline T* allocateArray(std::size_t count) {
+      return (T*)allocate(count * sizeof(T), alignof(T));
+   }
+
+   /**
+      Gets the most bytes that were in use at once.
+    */
+   inline std::size_t getPeakUsed() const {
+      return PeakUsed;
+   }
+
+private:
+
+   /**
+      Releases every allocation, merging the blocks into a single one.
+    */
+   void reset();
+};
@@ -8,6 +8,7 @@
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 
+#include "GLStateCache.h"
 #include "OpenGLErrorHandling.h"
 
 #define INFO_LOG_BUFFER_SIZE 1024
@@ -104,7 +105,14 @@ public:
 		Use/activate the shader. 
 	 */
 	inline void use() const {
-		GLCall(glUseProgram(programId));
+		GLStateCache::getShared().useProgram(programId);
+	}
+
+	/**
+		Gets the OpenGL name of the shader program.
+	 */
+	inline unsigned int getProgramId() const {
+		return programId;
 	}
 
 	/**
@@ -0,0 +1,8 @@
+#pragma once
+
+// SIMD_SSE is defined when the target has SSE2: x64 always does, and 32 bit MSVC builds use it by default.
+// Code using the intrinsics keeps a scalar path for the other targets.
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_SSE
+#include <emmintrin.h>
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Mesh.h"
+
+/**
+   The lookups of a texture cache since its stats were last reset, and what it holds now.
+ */
+struct TextureCacheStats {
+   std::size_t hits;
+   std::size_t misses;
+   // The textures deleted from the GPU because their last user released them.
+   std::size_t freed;
+   std::size_t textureCount;
+};
+
+/**
+   The textures loaded by every model, keyed by the absolute path of their image file so the
+   files with the same name in different directories stay apart.
+
+   Lookups go through a hash map behind a mutex, so any thread can look up and add textures,
+   while the textures are created on the thread that owns the OpenGL context. The cache only
+   keeps weak references: the models own their textures through shared pointers, and the last
+   one to release a texture deletes it from the GPU and removes it from the cache. That must
+   happen on the OpenGL thread too.
+ */
+class TextureCache {
+private:
+
+   std::unordered_map<std::string, std::weak_ptr<const Texture>> Textures;
+   mutable std::mutex Mutex;
+
+   std::atomic<std::size_t> Hits;
+   std::atomic<std::size_t> Misses;
+   std::atomic<std::size_t> Freed;
+
+public:
+
+   TextureCache();
+
+   TextureCache(const TextureCache& cache) = delete;
+   TextureCache& operator=(const TextureCache& cache) = delete;
+
+   /**
+      Gets the cache shared by all the models.
+    */
+   static TextureCache& getShared();
+
+   /**
+      Gets the key of the image file with the indicated path: its absolute path with the . and
+      .. components resolved and forward slashes.
+    */
+   static std::string getKey(const std::string& path);
+
+   /**
+      Gets the texture with the indicated key, counting a hit, or nullptr if it isn't loaded, counting a miss.
+    */
+   std::shared_ptr<const Texture> find(const std::string& key);
+
+   /**
+      Indicates whether the texture with the indicated key is loaded, without counting a lookup.
+    */
+   bool contains(const std::string& key) const;
+
+   /**
+      Adds the texture under the indicated key. If another thread added one with the same key
+      in the meantime, the indicated texture is deleted and the other one is returned instead.
+      Must be called on the OpenGL thread.
+    */
+   std::shared_ptr<const Texture> insert(const std::string& key, const Texture& texture);
+
+   /**
+      Gets the texture of the image file with the indicated path, reading it from its texture
+      cache or decoding it, and uploading it if it isn't loaded yet. Must be called on the OpenGL thread.
+      @throws Texture::TextureLoadingFailure if the image couldn't be decoded.
+    */
+   std::shared_ptr<const Texture> load(const std::string& path, const std::string& typeName);
+
+   TextureCacheStats getStats() const;
+
+   void resetStats();
+
+private:
+
+   /**
+      Deletes the texture from the GPU, and removes its key from the cache unless a new texture took it over.
+    */
+   void release(const std::string& key, const Texture* texture);
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+// The largest difference between the channels of a pixel for the image to still count as grayscale.
+#define GRAYSCALE_TOLERANCE 8
+
+// The S3TC formats come from an extension every desktop driver has, but that isn't core OpenGL.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/**
+   The block compression formats, which all store 4x4 pixel blocks in a fixed size.
+ */
+enum class BlockFormat {
+   // RGB with two 5:6:5 endpoints and 2 bit indices, 8 bytes a block.
+   BC1,
+   // BC1 for the color and a BC4 block for the alpha, 16 bytes a block.
+   BC3,
+   // A single channel with two 8 bit endpoints and 3 bit indices, 8 bytes a block.
+   BC4,
+   // Two BC4 blocks, for the red and green channels, 16 bytes a block.
+   BC5
+};
+
+/**
+   One level of a block compressed mip chain.
+ */
+struct CompressedLevel {
+   int Width;
+   int Height;
+   std::vector<unsigned char> Data;
+};
+
+/**
+   A block compressed image with its mip chain, largest level first. The rows are stored
+   bottom first, like the decoded images, which is what OpenGL expects.
+ */
+struct CompressedImage {
+   BlockFormat Format;
+   std::vector<CompressedLevel> Levels;
+};
+
+/**
+   Block compression encoder and decoder for BC1, BC3, BC4 and BC5.
+
+   Every block is encoded on its own, so the rows of blocks of each level are spread across
+   the thread pool. The color endpoints are the corners of the block's bounding box, inset a
+   little and flipped along the diagonal the colors follow. The indices of the 16 pixels of a
+   block are picked 4 pixels at a time with SSE, each pixel taking the nearest palette color.
+   The single channel blocks use their minimum and maximum as endpoints with 8 interpolated values.
+ */
+class TextureCompressor {
+public:
+
+   /**
+      Picks the format for the image: BC5 for normal maps, BC4 for grayscale images such as
+      ambient occlusion or specular maps, BC3 for images with transparent pixels and BC1 for the rest.
+    */
+   static BlockFormat chooseFormat(const TextureImage& image, const std::string& typeName);
+
+   /**
+      Gets the format the indicated type of texture is compressed to whatever its pixels, like BC5 for normal maps.
+      @return false if the format of the type depends on the pixels.
+    */
+   static bool getTypeFormat(const std::string& typeName, BlockFormat& outFormat);
+
+   /**
+      Builds the mip chain of the image with a box filter, and encodes every level in the indicated format.
+      @param pool The thread pool the blocks are encoded on, or nullptr to encode them on the calling thread.
+    */
+   static CompressedImage compress(const TextureImage& image, BlockFormat format, ThreadPool* pool = &ThreadPool::getShared());
+
+   /**
+      Decodes a level of the image to 4 component pixels. BC4 images are decoded to gray and BC5 images to red and green.
+    */
+   static inline TextureImage decompress(const CompressedImage& image, unsigned int level = 0) {
+      const CompressedLevel& source = image.Levels[level];
+      return decompress(image.Format, source.Width, source.Height, source.Data.data());
+   }
+
+   /**
+      Decodes the blocks of an image of the format with the indicated dimensions to 4 component pixels.
+    */
+   static TextureImage decompress(BlockFormat format, int width, int height, const unsigned char* blocks);
+
+   /**
+      Gets the size of a 4x4 block of the format, in bytes.
+    */
+   static std::size_t getBlockSize(BlockFormat format);
+
+   /**
+      Gets the size of an image of the format with the indicated dimensions, in bytes.
+    */
+   static std::size_t getLevelSize(BlockFormat format, int width, int height);
+
+   /**
+      Gets the OpenGL internal format of the block format.
+    */
+   static unsigned int getGLFormat(BlockFormat format);
+
+   /**
+      Indicates whether the OpenGL context can sample the format. Must be called on the OpenGL thread.
+    */
+   static bool isSupported(BlockFormat format);
+
+   /**
+      Converts the pixels of the image to 4 components.
+    */
+   static std::vector<unsigned char> toRgba(const TextureImage& image);
+
+private:
+
+   /**
+      Encodes the colors of the 16 pixels, 4 components each, in a BC1 block.
+    */
+   static void encodeColorBlock(const unsigned char* pixels, unsigned char* outBlock);
+
+   /**
+      Encodes a channel of the 16 pixels, 4 components each, in a BC4 block.
+    */
+   static void encodeChannelBlock(const unsigned char* pixels, int channel, unsigned char* outBlock);
+
+   /**
+      Decodes a BC1 block to the colors of 16 pixels, 4 components each.
+    */
+   static void decodeColorBlock(const unsigned char* block, unsigned char* outPixels);
+
+   /**
+      Decodes a BC4 block to a channel of 16 pixels, 4 components each.
+    */
+   static void decodeChannelBlock(const unsigned char* block, int channel, unsigned char* outPixels);
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include "TextureCompressor.h"
+
+/**
+   Reads and writes block compressed images with their mip chain in DDS and KTX files.
+
+   DDS files are written with the FourCC codes every reader understands (DXT1, DXT5, ATI1,
+   ATI2) and read with those or the DX10 header. KTX files are read in version 1.
+ */
+class TextureContainer {
+public:
+
+   /**
+      Writes the image to a DDS file at the indicated path, through a temporary file so a
+      failed write doesn't leave a truncated file behind.
+      @return false if the file couldn't be written.
+    */
+   static bool saveDds(const std::string& path, const CompressedImage& image);
+
+   /**
+      Reads the DDS or KTX file with the indicated path, telling them apart by their content.
+      @return false if the file couldn't be read or doesn't hold an image in one of the block formats.
+    */
+   static bool load(const std::string& path, CompressedImage& outImage);
+
+   /**
+      Indicates whether the path has the extension of a DDS or KTX file.
+    */
+   static bool isContainerPath(const std::string& path);
+
+private:
+
+   static bool readDds(const unsigned char* data, std::size_t size, CompressedImage& outImage);
+
+   static bool readKtx(const unsigned char* data, std::size_t size, CompressedImage& outImage);
+
+   /**
+      Reads the levels, each stored right after the previous one, checking they fit in the file.
+    */
+   static bool readLevels(const unsigned char* data, std::size_t size, int width, int height, unsigned int levelCount, CompressedImage& outImage);
+};
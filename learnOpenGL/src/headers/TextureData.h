@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "TextureCompressor.h"
+
+class PixelUploadRing;
+
+/**
+   One level of the mip chain of a texture, pointing into the storage of its TextureData.
+ */
+struct TextureLevel {
+   int Width;
+   int Height;
+   const unsigned char* Data;
+   std::size_t Size;
+};
+
+/**
+   The pixels of a texture, ready to be uploaded as they are: every level of the mip chain,
+   largest first, with the rows bottom first like OpenGL expects. The levels are either block
+   compressed or uncompressed with 1 or 4 components.
+
+   The levels point into Storage, which is either a buffer the texture was cooked in or the
+   mapped texture cache file, so a cached texture is uploaded straight from the mapping.
+ */
+struct TextureData {
+   // The number of components of the uncompressed levels, or 0 when they are block compressed.
+   int Components = 0;
+   BlockFormat Format = BlockFormat::BC1;
+   std::vector<TextureLevel> Levels;
+   std::shared_ptr<const void> Storage;
+
+   inline bool isCompressed() const {
+      return Components == 0;
+   }
+
+   inline bool isLoaded() const {
+      return !Levels.empty();
+   }
+
+   /**
+      Gets the size of all the levels, in bytes.
+    */
+   std::size_t getSize() const;
+
+   /**
+      Loads the image file with the indicated path. DDS and KTX files are read as they are.
+      Other images are read from their texture cache, or decoded, given their mip chain,
+      block compressed with compress, and written to the cache for the next time. Safe to call from any thread.
+      @param useCache Whether the texture cache is read and written, rather than cooking the image every time.
+      @throws Texture::TextureLoadingFailure if the image couldn't be read.
+    */
+   static TextureData load(const std::string& path, const std::string& typeName, bool compress, bool useCache = true);
+
+   /**
+      Builds the mip chain of the decoded image. Images with 2 or 3 components are expanded to 4,
+      which is what the drivers do on upload anyway.
+    */
+   static TextureData fromImage(const TextureImage& image);
+
+   /**
+      Takes over the levels of the block compressed image.
+    */
+   static TextureData fromCompressed(CompressedImage&& image);
+
+   /**
+      Uploads the levels as a texture. Must be called on the OpenGL thread.
+      @param ring The ring the levels are uploaded through, or nullptr to upload them from client memory.
+    */
+   Texture createTexture(const std::string& path, const std::string& typeName, PixelUploadRing* ring = nullptr) const;
+
+   /**
+      Uploads the indicated level to the texture bound to GL_TEXTURE_2D, through the ring when
+      there is one and the level fits in it. Must be called on the OpenGL thread.
+    */
+   void uploadLevel(unsigned int level, PixelUploadRing* ring = nullptr) const;
+
+   /**
+      Specifies the indicated level of the texture bound to GL_TEXTURE_2D from the pixels, which are
+      an offset in the bound pixel unpack buffer if there is one. Must be called on the OpenGL thread.
+    */
+   void specifyLevel(unsigned int level, const void* pixels) const;
+
+   /**
+      Frees the memory of the indicated level of the texture bound to GL_TEXTURE_2D by leaving
+      the level empty. Must be called on the OpenGL thread.
+    */
+   void releaseLevel(unsigned int level) const;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include "TextureData.h"
+
+#define TEXTURE_DISK_CACHE_EXTENSION ".texcache"
+#define TEXTURE_DISK_CACHE_VERSION   2
+
+// The levels are aligned in the file so the mapped levels can be read with aligned loads.
+#define TEXTURE_DISK_CACHE_ALIGNMENT 16
+
+/**
+   Binary cache of the cooked texture of an image, stored next to the image.
+
+   The cache holds the texture as it's uploaded: flipped, with its whole mip chain, and either
+   uncompressed or block compressed. It is read by mapping the file, so a warm start neither
+   decodes the image nor copies its pixels before uploading them. It is validated against the
+   size and modification time of the image.
+
+   An image is cooked to a different format depending on the type it's loaded as, like BC5 as a
+   normal map, so every format an image is cooked to has a cache of its own.
+ */
+class TextureDiskCache {
+public:
+
+   /**
+      Loads the cooked texture of the image with the indicated path, as the indicated type.
+      @param compressed Whether the texture is expected to be block compressed.
+      @param outData The texture, whose levels point into the mapped cache file.
+      @return false if there is no valid cache for the image and type.
+    */
+   static bool load(const std::string& imagePath, const std::string& typeName, bool compressed, TextureData& outData);
+
+   /**
+      Writes the cooked texture of the image with the indicated path, loaded as the indicated type, to its cache.
+      @return false if the cache couldn't be written.
+    */
+   static bool save(const std::string& imagePath, const std::string& typeName, const TextureData& data);
+
+   /**
+      Gets the path of the cache of the image with the indicated path, cooked for the indicated
+      type: the image path followed by the format, or by "bc" when the format depends on the pixels.
+    */
+   static std::string getCachePath(const std::string& imagePath, const std::string& typeName, bool compressed);
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+#include "TextureData.h"
+
+// The texture units a fragment shader is guaranteed to have in OpenGL 3.3. The arrays past the
+// last unit share it, and the meshes using them bind them themselves.
+#define TEXTURE_ARRAY_UNIT_COUNT 16
+
+// The layers an array is guaranteed to have in OpenGL 3.3.
+#define TEXTURE_ARRAY_MAX_LAYERS 256
+
+/**
+   Packs the textures of a model in GL_TEXTURE_2D_ARRAYs, one per size and format, so the model
+   binds its handful of arrays once per draw instead of a texture per mesh, and every mesh only
+   picks its layers through uniforms.
+
+   The textures are added with their cooked levels, then uploaded all at once. Every array gets
+   its own texture unit, which its layers keep for the life of the model. Packed textures are
+   sampled with a sampler2DArray and the layer index: see modelShaderArray.frag. Unlike the
+   textures of the texture cache, the arrays belong to the model and aren't streamed.
+ */
+class TexturePacker {
+private:
+
+   struct Group {
+      int Width;
+      int Height;
+      int Components;
+      BlockFormat Format;
+      std::size_t LevelCount;
+      std::vector<TextureData> Layers;
+   };
+
+   struct Placement {
+      unsigned int Group;
+      unsigned int Layer;
+   };
+
+   std::vector<Group> Groups;
+   // Keyed by texture cache key, so an image used by several materials is packed once.
+   std::unordered_map<std::string, Placement> Placements;
+   // The OpenGL name of every group's array, once uploaded.
+   std::vector<unsigned int> Arrays;
+   std::size_t Bytes;
+
+public:
+
+   TexturePacker();
+
+   /**
+      Deletes the arrays from the GPU.
+    */
+   ~TexturePacker();
+
+   /**
+      A packer shouldn't be copied since it deletes its arrays when it goes out of scope.
+    */
+   TexturePacker(const TexturePacker& packer) = delete;
+   TexturePacker& operator=(const TexturePacker& packer) = delete;
+
+   inline bool contains(const std::string& key) const {
+      return Placements.count(key) != 0;
+   }
+
+   /**
+      Places the texture in the layer after the others of its size and format. Block compressed
+      textures the context can't sample are decompressed first. Textures already added are ignored.
+    */
+   void add(const std::string& key, TextureData&& data);
+
+   /**
+      Creates the arrays of the added textures and frees their cooked levels. Must be called
+      once, on the OpenGL thread, after all the textures are added.
+    */
+   void upload();
+
+   /**
+      Gets where the added texture was packed, for a mesh to sample it as the indicated type.
+    */
+   TextureLayer getLayer(const std::string& key, const std::string& typeName) const;
+
+   /**
+      Binds every array to its texture unit, for all the meshes of a draw.
+    */
+   void bind() const;
+
+   inline std::size_t getArrayCount() const {
+      return Arrays.size();
+   }
+
+   /**
+      Gets the GPU memory taken by the arrays, with their mip chains, in bytes.
+    */
+   inline std::size_t getBytes() const {
+      return Bytes;
+   }
+
+private:
+
+   /**
+      Gets the texture unit of the indicated group's array.
+    */
+   static unsigned int getUnit(unsigned int group);
+
+   /**
+      Creates the array of the group from its layers.
+    */
+   unsigned int uploadGroup(const Group& group);
+};
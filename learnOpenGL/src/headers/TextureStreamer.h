@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+#include "PixelUploadRing.h"
+#include "TextureData.h"
+
+#define DEFLT_TEXTURE_BUDGET        (256u << 20)
+#define DEFLT_STREAMING_SCREEN_HEIGHT 600
+
+// The levels this size or smaller are uploaded with the texture and never evicted.
+#define TEXTURE_STREAMING_TAIL_SIZE 64
+
+// The most bytes an update uploads, so streaming a large level in doesn't stall a frame for long.
+#define TEXTURE_STREAMING_UPDATE_BYTES (8u << 20)
+
+/**
+   What a texture streamer holds and what it still has to load, as of its last update.
+ */
+struct TextureStreamingStats {
+   std::size_t budget;
+   std::size_t usedBytes;
+   std::size_t textureCount;
+   // The textures with fewer levels resident than their meshes on screen want.
+   std::size_t pendingRequests;
+   // The bytes uploaded and the levels evicted by the last update.
+   std::size_t uploadedBytes;
+   std::size_t evictedLevels;
+};
+
+/**
+   Streams the mip levels of textures in and out of the GPU within a memory budget.
+
+   A streamed texture starts with only its tail, the levels of TEXTURE_STREAMING_TAIL_SIZE or
+   smaller, and keeps its cooked levels, usually mapped from the texture cache, to load the
+   larger ones later. Every frame, the models request the level each of their visible meshes
+   needs, from the height of its bounding sphere on screen, and the update loads the missing
+   levels of the most visible textures first, one level a texture at a time and largest bias
+   first. When the budget is full it evicts the levels no mesh asked for in the last frame,
+   then the levels of the textures that cover less of the screen than the one being loaded.
+
+   The textures are owned by the models through the texture cache; the streamer only keeps weak
+   references and forgets a texture when it's deleted. Must be used on the OpenGL thread.
+ */
+class TextureStreamer {
+private:
+
+   struct StreamedTexture {
+      std::weak_ptr<const Texture> Owner;
+      TextureData Data;
+      std::string Path;
+      // The largest level on the GPU, and the first level of the tail.
+      unsigned int ResidentLevel;
+      unsigned int TailLevel;
+      // The level the meshes asked for, and their largest height on screen, in pixels, in the frame being drawn and the last one.
+      unsigned int RequestedLevel;
+      float RequestedCoverage;
+      unsigned int WantedLevel;
+      float Coverage;
+      std::size_t ResidentBytes;
+      std::size_t TailBytes;
+   };
+
+   // Keyed by OpenGL name, which is what the meshes hold.
+   std::unordered_map<unsigned int, StreamedTexture> Textures;
+   std::size_t Budget;
+   std::size_t UsedBytes;
+   float ScreenHeight;
+   PixelUploadRing* UploadRing;
+
+   std::size_t PendingRequests;
+   std::size_t UploadedBytes;
+   std::size_t EvictedLevels;
+
+public:
+
+   TextureStreamer();
+
+   TextureStreamer(const TextureStreamer& streamer) = delete;
+   TextureStreamer& operator=(const TextureStreamer& streamer) = delete;
+
+   /**
+      Gets the streamer shared by all the models.
+    */
+   static TextureStreamer& getShared();
+
+   /**
+      Indicates whether the texture has levels beyond its tail that the context can upload one at a time.
+    */
+   static bool isStreamable(const TextureData& data);
+
+   /**
+      Uploads the tail of the texture, through the ring if there is one.
+    */
+   static Texture createTexture(const std::string& path, const std::string& typeName, const TextureData& data, PixelUploadRing* ring = nullptr);
+
+   /**
+      Starts streaming the levels of the texture, created by createTexture, from its cooked data.
+      The texture is only tracked once, later calls for it are ignored.
+    */
+   void add(const std::shared_ptr<const Texture>& texture, TextureData&& data);
+
+   /**
+      Requests the level of the texture that fits a mesh of the indicated size on screen, for the
+      frame being drawn. The textures that aren't streamed are ignored.
+      @param screenSize The height of the mesh's bounding sphere over the height of the screen.
+    */
+   void request(unsigned int textureId, float screenSize);
+
+   /**
+      Loads and evicts levels for the requests of the frame that was drawn, and starts collecting the next frame's.
+    */
+   void update();
+
+   inline void setBudget(std::size_t budget) {
+      Budget = budget;
+   }
+
+   /**
+      Sets the height of the screen the requested sizes are relative to, in pixels.
+    */
+   inline void setScreenHeight(int height) {
+      ScreenHeight = (float)height;
+   }
+
+   /**
+      Sets the ring the levels are uploaded through, or nullptr to upload them from client memory.
+      The ring must outlive its use by the streamer.
+    */
+   inline void setUploadRing(PixelUploadRing* ring) {
+      UploadRing = ring;
+   }
+
+   TextureStreamingStats getStats() const;
+
+   /**
+      Prints the budget use and, for every streamed texture, its resident and wanted levels and
+      its mip bias: the number of levels it's blurrier than its meshes want.
+    */
+   void printReport(std::ostream& stream) const;
+
+private:
+
+   /**
+      Gets the level the texture needs to be drawn at the indicated height on screen, in pixels.
+    */
+   static unsigned int getNeededLevel(const StreamedTexture& texture, float coverage);
+
+   /**
+      Loads the level above the resident ones.
+    */
+   void loadLevel(StreamedTexture& texture);
+
+   /**
+      Evicts the largest resident level.
+    */
+   void evictLevel(StreamedTexture& texture);
+
+   /**
+      Evicts levels of other textures until the indicated bytes fit in the budget, the least needed first.
+      @return false if not enough of them were less needed than the requesting texture.
+    */
+   bool makeRoom(std::size_t bytes, const StreamedTexture& requester);
+};
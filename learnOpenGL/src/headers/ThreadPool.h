@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+   A fixed set of worker threads that run the tasks submitted to it in FIFO order.
+ */
+class ThreadPool {
+private:
+
+   std::vector<std::thread> Workers;
+   std::queue<std::function<void()>> Tasks;
+   std::mutex TasksMutex;
+   std::condition_variable TasksCondition;
+   bool Stopping;
+
+public:
+
+   /**
+      Starts the indicated number of worker threads.
+    */
+   explicit ThreadPool(unsigned int threadCount);
+
+   /**
+      Waits for the queued tasks to finish and joins the worker threads.
+    */
+   ~ThreadPool();
+
+   ThreadPool(const ThreadPool& pool) = delete;
+   ThreadPool& operator=(const ThreadPool& pool) = delete;
+
+   /**
+      Gets the pool shared by the whole application, with one worker per hardware thread
+      besides the main thread.
+    */
+   static ThreadPool& getShared();
+
+   /**
+      Gets the number of worker threads of the pool.
+    */
+   inline unsigned int getThreadCount() const {
+      return (unsigned int)Workers.size();
+   }
+
+   /**
+      Queues the indicated task.
+      @return A future that holds the result of the task, or the exception it threw.
+    */
+   template<typename Func>
+   auto submit(Func func) -> std::future<decltype(func())> {
+      using Result = decltype(func());
+      auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+      std::future<Result> result = task->get_future();
+      enqueue([task]() { (*task)(); });
+      return result;
+   }
+
+   /**
+      Calls func(i) for every i in [0, count) on the workers and the calling thread, and waits
+      for all the calls to finish. It's safe to call from inside a task of the pool since the
+      calling thread takes part in the work instead of just blocking on it.
+      @throws The first exception thrown by any of the calls.
+    */
+   template<typename Func>
+   void parallelFor(std::size_t count, const Func& func) {
+      if (count == 0) {
+         return;
+      }
+      if (count == 1 || Workers.empty()) {
+         for (std::size_t i = 0; i < count; i++) {
+            func(i);
+         }
+         return;
+      }
+
+      auto state = std::make_shared<ParallelForState>(count);
+      auto work = [state, &func]() {
+         for (std::size_t i = state->next++; i < state->count; i = state->next++) {
+            try {
+               func(i);
+            }
+            catch (...) {
+               std::lock_guard<std::mutex> lock(state->mutex);
+               if (!state->exception) {
+                  state->exception = std::current_exception();
+               }
+            }
+            state->finishItem();
+         }
+      };
+
+      // Helpers that start after every item was claimed return right away without touching func.
+      std::size_t helperCount = count - 1 < Workers.size() ? count - 1 : Workers.size();
+      for (std::size_t i = 0; i < helperCount; i++) {
+         enqueue(work);
+      }
+      work();
+
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->done.wait(lock, [&state]() { return state->finished == state->count; });
+      if (state->exception) {
+         std::rethrow_exception(state->exception);
+      }
+   }
+
+private:
+
+   struct ParallelForState {
+      std::size_t count;
+      std::atomic<std::size_t> next;
+      std::size_t finished;
+      std::exception_ptr exception;
+      std::mutex mutex;
+      std::condition_variable done;
+
+      explicit ParallelForState(std::size_t count) : count(count), next(0), finished(0) {}
+
+      inline void finishItem() {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (++finished == count) {
+            done.notify_all();
+         }
+      }
+   };
+
+   /**
+      Pushes the task to the queue and wakes up a worker.
+    */
+   void enqueue(std::function<void()> task);
+
+   /**
+      The loop run by every worker thread.
+    */
+   void workerLoop();
+};
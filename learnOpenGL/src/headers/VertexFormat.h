@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "ScratchArena.h"
+
+// The first of the 4 attribute locations the per-instance model matrix takes, one per column.
+#define INSTANCE_MATRIX_LOCATION 3
+
+struct Vertex;
+
+/**
+   The layouts a mesh's vertices can be stored in on the GPU.
+ */
+enum class VertexFormat {
+   // 32 bytes: float positions, float normals and float texture coords, like Vertex.
+   FLOAT32,
+   // 16 bytes: half float positions relative to the mesh's center, octahedral normals in
+   // 2x16 bit snorm and half float texture coords.
+   HALF,
+   // 16 bytes: 16 bit unorm positions over the mesh's bounding box, octahedral normals in
+   // 2x16 bit snorm and half float texture coords.
+   QUANTIZED16
+};
+
+/**
+   The vertices of a mesh packed in a VertexFormat, and the transform that brings the stored
+   positions back to model space: position = stored * positionScale + positionOffset.
+   The data points into a scratch arena, or straight into the source vertices when they don't
+   need any conversion.
+ */
+struct PackedVertices {
+   const unsigned char* data;
+   std::size_t size;
+   glm::vec3 positionScale;
+   glm::vec3 positionOffset;
+};
+
+/**
+   The indices of a mesh packed in the smallest type that can hold them. The data points into a
+   scratch arena, or straight into the source indices when they don't need any conversion.
+ */
+struct PackedIndices {
+   const unsigned char* data;
+   std::size_t size;
+   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+   unsigned int type;
+};
+
+/**
+   Packs vertices into the layouts of VertexFormat, and indices into the smallest index type,
+   and describes those layouts to OpenGL.
+ */
+class VertexPacker {
+public:
+
+   /**
+      Gets the size in bytes of a vertex in the indicated format.
+    */
+   static std::size_t getStride(VertexFormat format);
+
+   /**
+      Indicates whether the normals of the format are octahedral encoded.
+    */
+   static inline bool hasOctahedralNormals(VertexFormat format) {
+      return format != VertexFormat::FLOAT32;
+   }
+
+   /**
+      Packs the vertices in the indicated format.
+      @param scratch The arena the packed vertices are written to, if they need converting.
+    */
+   static PackedVertices pack(const std::vector<Vertex>& vertices, VertexFormat format, ScratchArena& scratch);
+
+   /**
+      Sets up the vertex attribute pointers for the format on the bound VAO and array buffer.
+    */
+   static void setupAttributes(VertexFormat format);
+
+   /**
+      Sets up the per-instance model matrix attributes on the bound VAO, read from the bound
+      array buffer of tightly packed glm::mat4, advancing once per instance.
+    */
+   static void setupInstanceAttributes();
+
+   /**
+      Packs the indices, followed by the indices of the levels of detail, in 16 bits if every
+      index fits, in 32 bits otherwise.
+      @param scratch The arena the packed indices are written to, if they need converting or concatenating.
+    */
+   static PackedIndices packIndices(const std::vector<unsigned int>& indices, const std::vector<std::vector<unsigned int>>& lodIndices, ScratchArena& scratch);
+
+   /**
+      Gets the size in bytes of the indices once packed by packIndices.
+    */
+   static std::size_t getPackedIndicesSize(const std::vector<unsigned int>& indices);
+
+   /**
+      Gets the size in bytes of a single index once packed by packIndices.
+    */
+   static std::size_t getPackedIndexSize(const std::vector<unsigned int>& indices);
+
+   /**
+      Encodes a unit vector with the octahedral mapping into two values in [-1, 1].
+    */
+   static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+};